@@ -1,16 +1,31 @@
 #version 140
 
 in vec2 position;
-// 2D position in rect [origin, texture_size]
+// Corner of the unit square.
 
-uniform ivec2 window_size;
-uniform ivec2 texture_size;
-uniform ivec2 frame_size;
-// Texture and frame sizes. These are in pixels.
+in vec2 origin;
+in float orientation;
+in float frame;
+// Per-instance attributes. The frame is passed as a float; it is always a
+// whole number. If it is negative the frame is worked out from the timing
+// instead.
+
+in vec3 timing;
+// Per-instance start time and period (both in milliseconds) and frame count.
+
+in vec2 frame_size;
+in vec4 frame_uvs;
+in float columns;
+// Per-instance description of the sprite sheet. The frame size is in pixels.
+// frame_uvs.xy is the texcoord of the sheet's min corner and frame_uvs.zw is
+// the texcoord size of a single frame.
 
-uniform int frame;
-uniform vec2 origin;
-uniform float orientation;
+uniform ivec2 window_size;
+uniform bool top_row_first;
+// The size of what is being drawn to, and whether it's a Framebuffer rather
+// than the window.
+uniform float time;
+// The animation clock, in milliseconds.
 
 out vec2 texcoords;
 
@@ -18,17 +33,33 @@ out vec2 texcoords;
 void main() {
 
   // Calculate the texture coordinates.
-  int frames_per_row = texture_size.x / frame_size.x;
+  int frames_per_row = int(columns);
+
+  // The nudge must match Animation::frame_at().
+  int current_frame = int(frame);
+  if (frame < 0.0) {
+    float elapsed = max(time - timing.x, 0.0);
+    current_frame = int(mod(floor(elapsed / timing.y + 0.001), timing.z));
+  }
+
+  int column = current_frame % frames_per_row;
+  int row = current_frame / frames_per_row;
 
-  int column = frame % frames_per_row;
-  int row = frame / frames_per_row;
+  texcoords = frame_uvs.xy + (vec2(column, row) + position) * frame_uvs.zw;
 
-  vec2 offset = vec2(column, row) * frame_size;
-  
-  texcoords = (position + offset) / texture_size;
+  // Rotate about the centre of the frame. This must match OrientedBox,
+  // which is what picking and culling use.
+  vec2 half_size = frame_size * 0.5;
+  vec2 local = position * frame_size - half_size;
+  float c = cos(orientation);
+  float s = sin(orientation);
+  vec2 rotated = vec2(c * local.x - s * local.y, s * local.x + c * local.y);
 
-  vec2 world_pos = position + origin;
-  world_pos[1] = window_size[1] - world_pos[1];
+  vec2 world_pos = origin + half_size + rotated;
+  // OpenGL's y axis points up, and ours down, so the window needs flipping.
+  // Framebuffers aren't flipped, so that their textures come out top row
+  // first like loaded ones.
+  if (!top_row_first) world_pos[1] = window_size[1] - world_pos[1];
   vec2 screen_pos = (world_pos - window_size/2) / (window_size/2);
 
   gl_Position = vec4(screen_pos, 0.0, 1.0);
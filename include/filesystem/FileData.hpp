@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <filesystem/MappedFile.hpp>
+#include <filesystem/PackFile.hpp>
+#include <filesystem/Path.hpp>
+#include <utils/NonCopyable.hpp>
+
+namespace filesystem {
+
+  class FileSystem;
+
+  /**
+   * The whole contents of a file, for as long as the object lives.
+   *
+   * Small files are read into a buffer with a single read; big ones are
+   * mapped, so that nothing is copied and only the pages that are touched
+   * get read. Either way the bytes are just data() and size() - a view that
+   * can go straight to a decoder or to OpenGL.
+   */
+  class FileData : public NonCopyable {
+  public:
+
+    /**
+     * How to get at the file. AUTO maps files of MAP_THRESHOLD bytes or
+     * more and reads anything smaller.
+     */
+    enum class Mode { AUTO, READ, MAP };
+
+    static const size_t MAP_THRESHOLD = 64 * 1024;
+
+    /**
+     * Read or map the given file. Throws a std::runtime_error if it can't
+     * be.
+     */
+    explicit FileData(const Path& path, Mode mode = Mode::AUTO);
+
+    /**
+     * As above, but find the file in a virtual file system. A file in a
+     * pack is a view straight into the pack's mapping, whatever the mode.
+     */
+    FileData(const FileSystem& files, const Path& path, Mode mode = Mode::AUTO);
+
+    /**
+     * Get the contents of the file.
+     */
+    const unsigned char* data() const;
+    size_t size() const;
+
+    /**
+     * The contents as characters, e.g. for text files. They are not null
+     * terminated.
+     */
+    const char* chars() const;
+
+    /**
+     * Copy the contents into a string.
+     */
+    std::string string() const;
+
+  private:
+    void load(const Path& path, Mode mode);
+
+    std::shared_ptr<const PackFile> m_pack;
+    std::unique_ptr<MappedFile> m_mapping;
+    std::vector<unsigned char> m_buffer;
+    const unsigned char* m_data;
+    size_t m_size;
+  };
+
+}
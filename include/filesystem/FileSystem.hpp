@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <filesystem/PackFile.hpp>
+#include <filesystem/Path.hpp>
+#include <utils/NonCopyable.hpp>
+
+namespace filesystem {
+
+  /**
+   * A virtual file system: pack archives mounted over the real one, with an
+   * optional loose directory overlay on top for development.
+   *
+   * A path is looked for in the overlay directories, most recently mounted
+   * first, then in the packs, most recently mounted first, and finally on
+   * disk as it is. With nothing mounted, it's just the real file system.
+   *
+   * Mounting isn't thread safe, so do it up front. Looking files up is, so
+   * loaders on other threads can share one.
+   */
+  class FileSystem : public NonCopyable {
+  public:
+
+    /**
+     * Where a file lives: either a range of a mounted pack, which stays
+     * valid for as long as 'pack' is held, or a path on disk.
+     */
+    struct Location {
+      std::shared_ptr<const PackFile> pack;
+      const unsigned char* data;
+      size_t size;
+      std::string path;
+    };
+
+    FileSystem();
+
+    /**
+     * Mount a pack. Throws a std::runtime_error if it can't be read.
+     */
+    void mount(const Path& pack);
+
+    /**
+     * Mount a directory of loose files over everything else, e.g. the
+     * source assets during development. A file "a/b.png" is looked for at
+     * "<directory>/a/b.png".
+     */
+    void mount_directory(const Path& directory);
+
+    /**
+     * Find a file. Doesn't check that a path on disk exists.
+     */
+    Location locate(const Path& path) const;
+
+    /**
+     * Does the file exist anywhere?
+     */
+    bool exists(const Path& path) const;
+
+  private:
+    std::vector<std::shared_ptr<const PackFile>> m_packs;
+    std::vector<std::string> m_directories;
+  };
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+#include <filesystem/Path.hpp>
+#include <utils/NonCopyable.hpp>
+
+namespace filesystem {
+
+  /**
+   * A read-only view of a whole file, mapped into memory by the OS.
+   *
+   * Pages are only read from disk when they are touched, and can be handed
+   * straight to anything that wants a pointer without copying them into a
+   * buffer first. The mapping goes away with the object.
+   */
+  class MappedFile : public NonCopyable {
+  public:
+
+    /**
+     * Map the given file. Throws a std::runtime_error if it can't be opened
+     * or mapped. An empty file maps to a null pointer of size 0.
+     */
+    explicit MappedFile(Path path);
+
+    /**
+     * Unmap the file.
+     */
+    ~MappedFile();
+
+    /**
+     * Get the contents of the file.
+     */
+    const unsigned char* data() const;
+    size_t size() const;
+
+  private:
+    const unsigned char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+  };
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <filesystem/MappedFile.hpp>
+#include <filesystem/Path.hpp>
+#include <utils/NonCopyable.hpp>
+
+namespace filesystem {
+
+  /**
+   * Hash a file name for a pack index (64 bit FNV-1a). Names should be
+   * normalised first.
+   */
+  uint64_t pack_hash(const std::string& name);
+
+  /**
+   * Normalise a file name for looking up in a pack: backslashes become
+   * slashes, and leading "./" and doubled slashes are dropped. Case is kept.
+   */
+  std::string pack_name(const std::string& name);
+
+  /**
+   * A pack archive: lots of files in one, with a hash index built when the
+   * pack was made.
+   *
+   * The file is a header, the entries, an open addressing hash table of
+   * entry indices, the names, and then the contents of each file starting on
+   * a 64 byte boundary. The whole thing is mapped, so opening a pack is one
+   * open() no matter how many files it holds, and finding a file is a hash
+   * and (nearly always) one probe. Everything is little-endian.
+   */
+  class PackFile : public NonCopyable {
+  public:
+
+    /**
+     * Map a pack and check its index. Throws a std::runtime_error if it
+     * can't be read or is malformed.
+     */
+    explicit PackFile(const Path& path);
+
+    /**
+     * Look up a file by its normalised name. If it's there, point data at
+     * its contents - which stay valid for as long as the pack does - and
+     * return true.
+     */
+    bool find(
+      const std::string& name,
+      const unsigned char*& data,
+      size_t& size
+    ) const;
+
+    /**
+     * Get the names of the files in the pack, e.g. for listing.
+     */
+    size_t file_count() const;
+    std::string file_name(size_t index) const;
+
+  private:
+    MappedFile m_file;
+    uint32_t m_entry_count;
+    uint32_t m_slot_count;
+    const unsigned char* m_entries;
+    const unsigned char* m_slots;
+    const char* m_names;
+  };
+
+  /**
+   * Builds a pack archive in memory and writes it out.
+   */
+  class PackWriter {
+  public:
+
+    /**
+     * Add a file with the given contents. The name is normalised; adding
+     * the same name twice throws a std::runtime_error.
+     */
+    void add(const std::string& name, std::vector<unsigned char> contents);
+
+    /**
+     * Add a file from disk under its own name.
+     */
+    void add_file(const Path& path);
+
+    /**
+     * Write the pack. Throws a std::runtime_error on failure.
+     */
+    void save(const Path& path) const;
+
+  private:
+    struct File {
+      std::string name;
+      std::vector<unsigned char> contents;
+    };
+    std::vector<File> m_files;
+  };
+
+}
@@ -10,7 +10,7 @@ namespace filesystem {
   class Path {
   public:
     explicit Path(std::string path);
-    std::string path() const;
+    const std::string& path() const;
   private:
     std::string m_path;
   };  
@@ -2,7 +2,11 @@
 
 #include "Eigen/Dense"
 
+#include <cstddef>
+#include <mutex>
+#include <string>
 #include <utility>
+#include <vector>
 
 class GLFWwindow;
 class GLFWEventListener;
@@ -22,6 +26,73 @@ private:
   static int s_instance_count;
 };
 
+//*****************************************************************************
+// Something that happened to a window, as received from glfw.
+struct GLFWEvent {
+  enum class Type {
+    KEY_DOWN,
+    KEY_UP,
+    KEY_HELD,
+    CHAR_INPUT,
+    MOUSE_BUTTON_DOWN,
+    MOUSE_BUTTON_UP,
+    MOUSE_MOVED,
+    MOUSE_ENTERED_WINDOW,
+    MOUSE_LEFT_WINDOW,
+    MOUSE_SCROLLED
+  };
+
+  Type type;
+  double time;
+  // What happened, and when in glfwGetTime() seconds.
+
+  int code;
+  int scancode;
+  int mods;
+  // The key, button or character, plus the scancode and modifiers for keys.
+
+  double x;
+  double y;
+  // The mouse position, or scroll offset.
+};
+
+//*****************************************************************************
+// A fixed size ring buffer of window events. The window's callbacks push
+// events into it while glfw polls, and the events are then handed out in
+// one batch, from whichever thread likes.
+//
+// A mouse move straight after another replaces it, and a scroll straight
+// after another adds to it, so a burst of movement costs one event. If the
+// queue fills up the oldest events are dropped and counted in dropped(),
+// which usually means that nothing is draining the queue. push() is called
+// from GLFW callbacks, so it does nothing but queue.
+class GLFWEventQueue {
+public:
+
+  explicit GLFWEventQueue(size_t capacity = 1024);
+  // Ctor. The queue starts off empty.
+
+  void push(const GLFWEvent& event);
+  // Add an event, merging it into the last one where possible.
+
+  void drain(std::vector<GLFWEvent>& events);
+  // Replace the contents of 'events' with everything queued, oldest first,
+  // and empty the queue.
+
+  size_t dropped() const;
+  // Get the number of events dropped because the queue was full.
+
+  static void dispatch(const GLFWEvent& event, GLFWEventListener& listener);
+  // Call the listener method for an event.
+
+private:
+  std::vector<GLFWEvent> m_events;
+  size_t m_first;
+  size_t m_count;
+  size_t m_dropped;
+  mutable std::mutex m_mutex;
+};
+
 //*****************************************************************************
 // Wraps up a glfw window.
 class GLFWWindow {
@@ -39,16 +110,38 @@ public:
 
   void swap_buffers();
   // Swap the framebuffers.
+
+  void set_swap_interval(int interval);
+  // Wait for this many vertical blanks per swap: 1 for vsync, 0 to swap as
+  // soon as possible. Applies to the current context, so make this window's
+  // context current first.
   
   void add_event_listener(GLFWEventListener& listener);
-  // Events will be added to the given queue.
+  // The listener will be told about events by dispatch_events(), which
+  // poll_events() and GraphicsSystem::swap_buffers() both call - so code
+  // that calls glfwPollEvents() itself still hears about everything, at the
+  // latest when the frame is swapped.
+
+  GLFWEventQueue& events();
+  // Get the queue that events go into when glfw is polled. Drain this
+  // yourself to handle events on another thread, instead of adding
+  // listeners.
+
+  void dispatch_events();
+  // Hand everything queued so far to every listener, in order. With no
+  // listeners this does nothing, leaving the queue for whoever drains it.
+
+  void poll_events();
+  // Poll glfw and then dispatch the events.
 
   ~GLFWWindow();
   // Destructor.
 
 private:
   
-  static std::vector<GLFWEventListener*>& get_listeners(GLFWwindow* window);
+  static GLFWEventQueue& get_events(GLFWwindow* window);
+  static void push(GLFWwindow* window, GLFWEvent::Type type, int code = 0,
+                   int scancode = 0, int mods = 0, double x = 0, double y = 0);
   static void key_callback(GLFWwindow* window, int, int, int, int);
   static void mouse_button_callback(GLFWwindow* window, int, int, int);
   static void cursor_pos_callback(GLFWwindow* window, double, double);
@@ -58,6 +151,8 @@ private:
 
   GLFWwindow* m_window;
   std::vector<GLFWEventListener*> m_listeners;
+  GLFWEventQueue m_events;
+  std::vector<GLFWEvent> m_dispatching;
 };
 
 //*****************************************************************************
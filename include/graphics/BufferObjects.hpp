@@ -7,6 +7,8 @@
 
 #include <GL/glew.h>
 
+#include <vector>
+
 #include <graphics/GraphicsObject.hpp>
 
 namespace graphics {
@@ -15,7 +17,9 @@ namespace graphics {
    * A type safe representation of an OpenGL buffer target.
    */
   enum class BufferTarget {
-    ARRAY_BUFFER = GL_ARRAY_BUFFER
+    ARRAY_BUFFER = GL_ARRAY_BUFFER,
+    PIXEL_UNPACK_BUFFER = GL_PIXEL_UNPACK_BUFFER,
+    PIXEL_PACK_BUFFER = GL_PIXEL_PACK_BUFFER
   };
   inline GLenum get_gl_enum(BufferTarget t) { return static_cast<GLenum>(t); }
   
@@ -24,7 +28,9 @@ namespace graphics {
    */
   enum class BufferUsage {
     STATIC_DRAW = GL_STATIC_DRAW,
-    DYNAMIC_DRAW = GL_DYNAMIC_DRAW
+    DYNAMIC_DRAW = GL_DYNAMIC_DRAW,
+    STREAM_DRAW = GL_STREAM_DRAW,
+    STREAM_READ = GL_STREAM_READ
   };
   inline GLenum get_gl_enum(BufferUsage u) { return static_cast<GLenum>(u); }
   
@@ -71,7 +77,12 @@ namespace graphics {
       BufferUsage usage
     );
     void bind();
-    void fill(size_t size, void* data);
+    void unbind();
+    void fill(size_t size, const void* data);
+    void fill_range(size_t offset, size_t size, const void* data);
+    void allocate(size_t size);
+    void* map_range(size_t offset, size_t size, GLbitfield access);
+    bool unmap();
     BufferTarget target() const;
     BufferUsage usage() const;
     ~VertexBufferObject();
@@ -81,6 +92,67 @@ namespace graphics {
     GLuint m_id;
   };
   
+  /**
+   * A buffer for data that is rewritten every frame, such as instance data.
+   * 
+   * The buffer is split into a ring of segments, one per frame in flight.
+   * Each frame writes into its own segment through an unsynchronised
+   * mapping, so writing never stalls on the GPU; everything written during
+   * a frame, by however many draws, goes end to end in the one segment.
+   * GraphicsSystem::swap_buffers() ends the frame, which drops a fence; a
+   * segment is only reused once the GPU has passed the fence from the last
+   * time it was used.
+   */
+  class StreamingBuffer : public GraphicsObject {
+  public:
+    StreamingBuffer(
+      GraphicsSystem& tok,
+      BufferTarget target,
+      size_t segment_size,
+      int segment_count = 3
+    );
+
+    /**
+     * Copy data into the current segment and return its offset in buffer().
+     * If the segment is full, the whole buffer is reallocated with bigger
+     * segments - so any offsets returned earlier in the frame are only good
+     * for draws that have already been issued.
+     */
+    size_t write(const void* data, size_t size, size_t alignment = 16);
+
+    /**
+     * As write(), but rather than copying, map the space for the caller to
+     * fill in and then unmap(). Saves a copy when the data is being put
+     * together anyway. If mapping fails this returns null, and the space is
+     * still reserved: fill it in with buffer().fill_range() instead. The
+     * same goes if unmap() returns false, since what was written is then
+     * undefined.
+     */
+    void* map(size_t size, size_t& offset, size_t alignment = 16);
+    bool unmap();
+
+    /**
+     * Fence off the current segment and move on to the next one, waiting
+     * for the GPU to finish with it if necessary. GraphicsSystem calls this
+     * once a frame, from swap_buffers(); nothing else should.
+     */
+    void end_frame();
+
+    VertexBufferObject& buffer();
+    ~StreamingBuffer();
+
+  private:
+    size_t reserve(size_t size, size_t alignment);
+    void begin_segment();
+    void wait(GLsync fence);
+
+    VertexBufferObject m_buffer;
+    size_t m_segment_size;
+    std::vector<GLsync> m_fences;
+    int m_segment;
+    size_t m_offset;
+  };
+  
   /**
    * An index into a vertex array object.
    */
@@ -107,8 +179,10 @@ namespace graphics {
       ComponentCount size, 
       DataType type, 
       bool normalized, 
-      size_t stride
+      size_t stride,
+      size_t offset = 0
     );
+    void attribute_divisor(AttributeIndex idx, unsigned int divisor);
     ~VertexArrayObject();
   private:
     GLuint m_id;
@@ -0,0 +1,224 @@
+#pragma once
+
+/**
+ * Recording draws on several threads and submitting them on one.
+ *
+ * e.g.
+ *
+ *   CommandQueue queue(graphics);
+ *   queue.begin(chunks);
+ *   jobs.parallel_for(0, chunks, 1, [&](size_t begin, size_t end) {
+ *     for (size_t i = begin; i < end; ++i) {
+ *       for (Sprite& sprite : scene[i]) sprite.draw(queue.list(i));
+ *     }
+ *   });
+ *   queue.submit();
+ */
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <graphics/BufferObjects.hpp>
+#include <graphics/GraphicsObject.hpp>
+#include <graphics/Sprite.hpp>
+#include <utils/NonCopyable.hpp>
+
+namespace graphics {
+
+  /**
+   * One recorded draw: a range of a CommandList's instances, drawn with an
+   * animation. The animation stands for the program, vertex array and
+   * texture; the per-draw data it would otherwise set as uniforms lives in
+   * the instances, and the rest (time, target size) is the same for every
+   * draw in a frame, so it is set once at submission.
+   **/
+  struct DrawCommand {
+    Animation* animation;
+    const Texture* texture;
+    uint32_t first;
+    uint32_t count;
+  };
+
+  /**
+   * Draws recorded by one thread. Recording makes no GL calls and doesn't
+   * touch the GraphicsSystem, so any thread may fill a list, as long as no
+   * other thread is using the same one at the time. Consecutive draws with
+   * the same texture share a command.
+   *
+   * The animations must outlive the next CommandQueue::submit().
+   **/
+  class CommandList : public NonCopyable {
+  public:
+    CommandList();
+
+    /**
+     * Add things to draw, culling anything outside the view, just as with
+     * SpriteBatch::add() and SpriteBatch::add_animated().
+     **/
+    void add(
+      Animation& animation,
+      int frame,
+      Eigen::Vector2f position,
+      float orientation_radians
+    );
+    void add_animated(
+      Animation& animation,
+      float start_time,
+      Eigen::Vector2f position,
+      float orientation_radians
+    );
+
+    /**
+     * Add an instance already worked out with Animation::instance(). This
+     * isn't culled.
+     **/
+    void add(Animation& animation, const AnimationInstance& instance);
+
+    /**
+     * Record that some sprites were culled by the caller.
+     **/
+    void count_culled(int count);
+
+    /**
+     * The visible rectangle. CommandQueue::begin() sets this to the queue's
+     * view.
+     **/
+    void set_view(Eigen::Vector2f min, Eigen::Vector2f max);
+    Eigen::Vector2f view_min() const;
+    Eigen::Vector2f view_max() const;
+
+    void clear();
+
+    /**
+     * Get the number of instances recorded, the number of commands they
+     * make, and the number culled.
+     **/
+    size_t size() const;
+    size_t command_count() const;
+    int culled() const;
+
+  private:
+    friend class CommandQueue;
+
+    bool cull(
+      const Animation& animation,
+      Eigen::Vector2f position,
+      float orientation_radians
+    );
+
+    std::vector<DrawCommand> m_commands;
+    std::vector<AnimationInstance> m_instances;
+    Eigen::Vector2f m_view_min;
+    Eigen::Vector2f m_view_max;
+    int m_culled;
+  };
+
+  /**
+   * A set of command lists, one per recording thread (or per piece of
+   * work), which are merged and drawn on the GL thread.
+   *
+   * Submission goes through every list's commands, in list order, and
+   * groups them by texture. That gives the same ordering guarantees as
+   * SpriteBatch: things with the same texture are drawn in order, lists in
+   * index order, and textures in the order they first turn up. The groups
+   * are then copied into one streamed buffer end to end, and each becomes a
+   * single instanced draw. SpriteBatch is a queue with one list.
+   *
+   * Lists are kept between frames so that their storage is reused.
+   **/
+  class CommandQueue : public GraphicsObject {
+  public:
+    explicit CommandQueue(GraphicsSystem& gtok);
+
+    /**
+     * Clear the queue and make sure there are at least 'list_count' lists,
+     * each with the queue's view. Call this on the GL thread before
+     * recording.
+     **/
+    void begin(size_t list_count);
+
+    /**
+     * Get a list to record into. Getting a list is safe from any thread,
+     * since begin() has already made them all.
+     **/
+    CommandList& list(size_t index);
+    const CommandList& list(size_t index) const;
+    size_t list_count() const;
+
+    /**
+     * The visible rectangle lists are given by begin(). By default this is
+     * the whole of the render target, as with SpriteBatch.
+     **/
+    void set_view(Eigen::Vector2f min, Eigen::Vector2f max);
+    Eigen::Vector2f view_min() const;
+    Eigen::Vector2f view_max() const;
+
+    /**
+     * Draw everything recorded and clear the lists. Must be called on the
+     * GL thread, once every recording thread has finished.
+     **/
+    void submit();
+
+    /**
+     * Empty the lists without drawing anything, and forget every texture
+     * the queue has drawn with.
+     **/
+    void clear();
+
+    /**
+     * Get the number of draw calls and instances from the last submit(),
+     * and the number culled while recording for it.
+     **/
+    int draw_calls() const;
+    size_t drawn() const;
+    int culled() const;
+
+  private:
+    std::vector<std::unique_ptr<CommandList>> m_lists;
+    size_t m_active;
+    // Lists are held by pointer so that growing the vector never moves one
+    // that a thread is recording into.
+
+    struct Run {
+      const AnimationInstance* instances;
+      uint32_t count;
+    };
+    struct Group {
+      const Texture* texture;
+      Animation* animation;
+      std::vector<Run> runs;
+      size_t size;
+    };
+    std::vector<Group> m_groups;
+    std::unordered_map<const Texture*, size_t> m_group_indices;
+    // Each texture's commands, pointing into the lists they came from. All
+    // animations with a texture are drawn the same way, so the first one in
+    // the group draws the lot. Only textures drawn last time are kept.
+
+    std::vector<size_t> m_order;
+    std::vector<Group> m_spare_groups;
+    // The groups used by this submit, in the order their textures first
+    // turned up, which is the order they're drawn in.
+
+    void copy_groups(AnimationInstance* out) const;
+    // Copy every group's instances out end to end.
+
+    std::vector<AnimationInstance> m_staging;
+    StreamingBuffer m_instances;
+    // Instances are copied straight into the mapped buffer; the staging
+    // vector is only for when mapping or unmapping fails.
+
+    Eigen::Vector2f m_view_min;
+    Eigen::Vector2f m_view_max;
+    bool m_view_follows_target;
+
+    int m_draw_calls;
+    size_t m_drawn;
+    int m_culled;
+  };
+
+}
@@ -0,0 +1,96 @@
+//*****************************************************************************
+// Block compressed images, ready to hand to the GPU as they are.
+//
+// e.g.
+//
+//   // At bake time.
+//   CompressedImage bc3 = CompressedImage::encode(
+//     Image(Path("data/textures/lucy.png")), TextureFormat::BC3
+//   );
+//   bc3.save_dds(Path("data/textures/lucy.dds"));
+//
+//   // At run time.
+//   Texture texture(
+//     graphics, TextureTarget::TEXTURE_2D,
+//     CompressedImage(Path("data/textures/lucy.dds"))
+//   );
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <filesystem/Path.hpp>
+
+#include <graphics/Image.hpp>
+#include <graphics/TextureFormat.hpp>
+
+namespace filesystem {
+  class FileData;
+  class FileSystem;
+}
+
+namespace graphics {
+
+  //***************************************************************************
+  // An image in one of the block compressed formats, with zero or more mip
+  // levels after the first.
+  class CompressedImage {
+  public:
+
+    explicit CompressedImage(filesystem::Path filename);
+    // Read a DDS or KTX (version 1) file containing BC1, BC3 or BC7 data.
+    // Which it is is worked out from the contents rather than the name.
+    // Throws a std::runtime_error if the file can't be read or holds
+    // something else.
+
+    CompressedImage(const filesystem::FileSystem& files, filesystem::Path filename);
+    // As above, but finding the file in a virtual file system.
+
+    CompressedImage(
+      TextureFormat format,
+      Eigen::Vector2i size,
+      std::vector<std::vector<unsigned char>> levels
+    );
+    // Wrap data that's already compressed. Level i must be the right size for
+    // a (size / 2^i) image.
+
+    static CompressedImage encode(
+      const Image& image, 
+      TextureFormat format,
+      bool mipmaps = false
+    );
+    // Compress an image to BC1 or BC3, optionally with a full mip chain made
+    // with Image::half_size(). This is a simple, fast encoder - good enough
+    // for sprites, but not as good as a proper offline tool. There is no BC7
+    // encoder; use another tool and load the result.
+
+    Image decode(int level = 0) const;
+    // Decompress a BC1 or BC3 level back to RGBA8, e.g. for a GPU without
+    // support for the format, or to check the result of encode().
+
+    void save_dds(filesystem::Path filename) const;
+    // Write the image to a DDS file. Throws a std::runtime_error on failure.
+
+    TextureFormat format() const;
+    Eigen::Vector2i size() const;
+    // Get the format and the size of the first level, in pixels.
+
+    int level_count() const;
+    Eigen::Vector2i level_size(int level) const;
+    const std::vector<unsigned char>& level(int level) const;
+    // Get the mip levels.
+
+  private:
+    void load(const filesystem::FileData& file, const filesystem::Path& filename);
+    void load_dds(const filesystem::FileData& file);
+    void load_ktx(const filesystem::FileData& file);
+    void check_levels() const;
+
+    TextureFormat m_format;
+    Eigen::Vector2i m_size;
+    std::vector<std::vector<unsigned char>> m_levels;
+  };
+
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * Reading frames back from the GPU without stalling it.
+ *
+ * e.g.
+ *
+ *   // Encode on a worker thread.
+ *   graphics.capture().start();
+ *   std::thread encoder([&]() {
+ *     CapturedFrame frame;
+ *     while (recording) {
+ *       if (!graphics.capture().pop(frame)) { sleep a bit; continue; }
+ *       encode(frame);
+ *       graphics.capture().recycle(std::move(frame.pixels));
+ *     }
+ *   });
+ */
+
+#include <GL/glew.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <graphics/BufferObjects.hpp>
+#include <graphics/GraphicsObject.hpp>
+
+namespace graphics {
+
+  /**
+   * A frame read back by FrameCapture. The pixels are RGBA8, top row first,
+   * whether they came from the window or a Framebuffer.
+   **/
+  struct CapturedFrame {
+    unsigned frame;
+    Eigen::Vector2i size;
+    std::vector<unsigned char> pixels;
+  };
+
+  /**
+   * Copies frames into a ring of pixel pack buffers as they are finished,
+   * and hands them out once the GPU has got round to writing them.
+   *
+   * The copy is queued with glReadPixels into a buffer, so the CPU doesn't
+   * wait for it, and a fence goes in after it. The buffer is only mapped
+   * once its fence has signalled, usually a frame or two later. Nothing
+   * here ever waits for the GPU, apart from stop(); if every buffer is still
+   * in flight when a frame finishes, the frame is dropped instead.
+   *
+   * GraphicsSystem::swap_buffers() does the capturing, reading whatever the
+   * current render target is, so there is nothing to call per frame.
+   **/
+  class FrameCapture : public GraphicsObject {
+  public:
+
+    static const int RING_SIZE = 3;
+    static const size_t MAX_QUEUED = 8;
+
+    explicit FrameCapture(GraphicsSystem& gtok);
+    ~FrameCapture();
+
+    /**
+     * Start capturing, handing each frame to the callback. The callback is
+     * called on the GL thread from swap_buffers(), so it should be quick -
+     * e.g. move the frame onto a job.
+     **/
+    void start(std::function<void(CapturedFrame&)> callback);
+
+    /**
+     * Start capturing into a queue instead, for pop() to take frames off.
+     * If nobody keeps up, frames past MAX_QUEUED are dropped.
+     **/
+    void start();
+
+    /**
+     * Stop capturing. Frames still in flight are waited for and delivered.
+     **/
+    void stop();
+
+    bool capturing() const;
+
+    /**
+     * Take the oldest queued frame. Returns false if there isn't one. Can
+     * be called from any thread.
+     **/
+    bool pop(CapturedFrame& frame);
+
+    /**
+     * Hand back a frame's pixels once they're finished with, so that their
+     * memory is reused rather than allocated afresh every frame. Can be
+     * called from any thread.
+     **/
+    void recycle(std::vector<unsigned char>&& pixels);
+
+    /**
+     * Get how many frames have been captured, and how many were dropped
+     * because the buffers or the queue were full.
+     **/
+    unsigned captured() const;
+    unsigned dropped() const;
+
+    /**
+     * Queue a copy of the frame being drawn, and deliver any earlier ones
+     * that are ready. Called by GraphicsSystem::swap_buffers().
+     **/
+    void end_frame();
+
+    /**
+     * Delete the buffers. Called by GraphicsSystem before the context goes.
+     **/
+    void release();
+
+  private:
+    struct Slot {
+      std::unique_ptr<VertexBufferObject> buffer;
+      size_t capacity;
+      GLsync fence;
+      unsigned frame;
+      Eigen::Vector2i size;
+      bool flip;
+    };
+
+    void begin();
+    // Make the buffers, if they haven't been already.
+
+    void read();
+    // Queue the read into the next slot, if it's free.
+
+    void collect(bool wait);
+    // Deliver finished slots, oldest first, optionally waiting for them.
+
+    void deliver(Slot& slot);
+    // Copy a finished slot out and hand it over.
+
+    std::vector<Slot> m_slots;
+    int m_next;
+    bool m_capturing;
+    std::function<void(CapturedFrame&)> m_callback;
+    unsigned m_frame;
+    unsigned m_captured;
+    unsigned m_dropped;
+
+    mutable std::mutex m_mutex;
+    std::deque<CapturedFrame> m_queue;
+    std::vector<std::vector<unsigned char>> m_spare;
+    // The queue and spare pixel storage are shared with other threads.
+  };
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+ * Offscreen render targets.
+ *
+ * e.g.
+ *
+ *   Framebuffer thumbnail(graphics, Vector2i(128, 128));
+ *   graphics.set_render_target(&thumbnail);
+ *   glClear(GL_COLOR_BUFFER_BIT);
+ *   sprite.draw();
+ *   graphics.set_render_target(nullptr);
+ *   Image pixels = thumbnail.read_pixels();
+ */
+
+#include <memory>
+
+#include <GL/glew.h>
+
+#include <Eigen/Dense>
+
+#include <graphics/GraphicsObject.hpp>
+#include <graphics/Image.hpp>
+#include <graphics/Texture.hpp>
+
+namespace graphics {
+
+  /**
+   * A framebuffer object with a single colour texture, of any size. Make it
+   * the GraphicsSystem's render target and everything draws into it exactly
+   * as it would into the window - window_size(), the viewport and culling
+   * all follow the target.
+   *
+   * Things are drawn into framebuffers top row first, the same as textures
+   * loaded from files, so the colour texture can be drawn as a sprite sheet
+   * the right way up.
+   **/
+  class Framebuffer : public GraphicsObject {
+  public:
+
+    /**
+     * Make a framebuffer of the given size. The format can't be a compressed
+     * one. Throws std::runtime_error if the driver can't render to it.
+     **/
+    Framebuffer(
+      GraphicsSystem& gtok,
+      Eigen::Vector2i size,
+      TextureFormat format = TextureFormat::RGBA8
+    );
+    ~Framebuffer();
+
+    /**
+     * Bind the framebuffer for drawing and set the viewport to cover it.
+     * Use GraphicsSystem::set_render_target() rather than calling this, so
+     * that everything else knows where drawing is going.
+     **/
+    void bind();
+
+    Eigen::Vector2i size() const;
+
+    /**
+     * Get the colour texture. It has a single level; call
+     * Texture::generate_mipmaps() after drawing if it is to be shrunk.
+     **/
+    std::shared_ptr<Texture> texture() const;
+
+    /**
+     * Get a region covering the whole of the colour texture, e.g. to make
+     * an Animation out of it.
+     **/
+    TextureRegion region() const;
+
+    /**
+     * Copy the pixels back to main memory. This waits for everything drawn
+     * so far to finish, so it isn't something to do every frame.
+     **/
+    Image read_pixels();
+
+  private:
+    void restore_target();
+    // Bind whatever the GraphicsSystem is drawing to again, after binding
+    // this to do something else with it.
+
+    GLuint m_id;
+    Eigen::Vector2i m_size;
+    std::shared_ptr<Texture> m_texture;
+  };
+
+}
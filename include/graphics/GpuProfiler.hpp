@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+ * GPU timings for the frame profiler.
+ */
+
+#include <GL/glew.h>
+
+#include <deque>
+#include <vector>
+
+#include <graphics/GraphicsObject.hpp>
+#include <profiling/Profiler.hpp>
+
+namespace graphics {
+
+  /**
+   * Times stretches of GL commands with GL_TIME_ELAPSED queries and hands
+   * the results to a profiling::Profiler, on its GPU track.
+   *
+   * Results are only asked for once they are LATENCY frames old, and only
+   * if the driver says they are ready, so reading them never stalls the
+   * pipeline. This means GPU timings show up a few frames after the work
+   * they measure, and in traces they start when the commands were issued
+   * rather than when they ran.
+   *
+   * Time elapsed queries can't overlap, so scopes inside another scope are
+   * not timed; only the outermost one is.
+   */
+  class GpuProfiler : public GraphicsObject {
+  public:
+
+    static const int LATENCY = 3;
+
+    GpuProfiler(GraphicsSystem& gtok, profiling::Profiler& profiler);
+    ~GpuProfiler();
+
+    /**
+     * Start and stop timing. The name is kept as a pointer, as with
+     * Profiler::record(); give GPU scopes different names to CPU ones or
+     * their times are added together.
+     */
+    void begin(const char* name);
+    void end();
+
+    /**
+     * Collect whatever results are ready and start a new frame. Call before
+     * Profiler::end_frame().
+     */
+    void end_frame();
+
+    /**
+     * Delete the queries. Called by GraphicsSystem before the context goes.
+     */
+    void release();
+
+  private:
+    struct Pending {
+      GLuint query;
+      const char* name;
+      double start;
+      int frame;
+    };
+
+    profiling::Profiler& m_profiler;
+    std::vector<GLuint> m_free;
+    std::deque<Pending> m_pending;
+    Pending m_current;
+    int m_depth;
+    bool m_active;
+    int m_frame;
+  };
+
+  /**
+   * Times GL commands from construction to destruction.
+   */
+  class GpuScope : public NonCopyable {
+  public:
+    GpuScope(GpuProfiler& profiler, const char* name) 
+      : m_profiler(profiler) 
+    { 
+      m_profiler.begin(name); 
+    }
+    ~GpuScope() { m_profiler.end(); }
+  private:
+    GpuProfiler& m_profiler;
+  };
+
+}
@@ -4,13 +4,74 @@
  * Class which initialises the graphics stuff. 
  */
 
+#include <functional>
+#include <ostream>
 #include <string>
+#include <vector>
 
 #include <Eigen/Dense>
 
 #include <glfwutils/glfw_utils.hpp>
 
+#include <filesystem/FileSystem.hpp>
+
+#include <jobs/JobSystem.hpp>
+
+#include <profiling/Histogram.hpp>
+#include <profiling/Profiler.hpp>
+
+#include <graphics/BufferObjects.hpp>
+#include <graphics/FrameCapture.hpp>
+#include <graphics/Framebuffer.hpp>
+#include <graphics/GpuProfiler.hpp>
+#include <graphics/HeadlessContext.hpp>
+#include <graphics/StateCache.hpp>
+#include <graphics/ProgramCache.hpp>
+#include <graphics/TextureResidency.hpp>
+
 namespace graphics {
+
+  /**
+   * How GraphicsSystem::run() paces things.
+   */
+  struct LoopSettings {
+    float step_ms;      // Simulation step. Default 1000/60.
+    float render_hz;    // Render rate cap; 0 (the default) for none, so
+                        // frames come as fast as vsync allows.
+    int max_steps;      // Most simulation steps per frame. If the loop falls
+                        // further behind, the rest are dropped - the game
+                        // slows down rather than spiralling. Default 5.
+    int swap_interval;  // Vertical blanks per swap: 1 (the default) for
+                        // vsync, 0 for none. Ignored when headless.
+
+    LoopSettings()
+      : step_ms(1000.0f / 60.0f),
+        render_hz(0),
+        max_steps(5),
+        swap_interval(1)
+    {
+    }
+  };
+
+  /**
+   * What GraphicsSystem::run() has been up to, since it was last started.
+   */
+  struct LoopStats {
+    profiling::Histogram frame_ms;   // Time between frames.
+    profiling::Histogram update_ms;  // Time spent in steps since the
+                                     // frame before, per frame.
+    profiling::Histogram render_ms;  // Render callback plus swap.
+    unsigned frames;
+    unsigned steps;
+    unsigned dropped_steps;
+
+    LoopStats() : frames(0), steps(0), dropped_steps(0) {}
+
+    /**
+     * Print the histograms and counts, a line each.
+     */
+    void print(std::ostream& out) const;
+  };
   
   /**
    * Initialises the graphics system
@@ -21,18 +82,149 @@ namespace graphics {
     GraphicsSystem(Eigen::Vector2i window_size, std::string window_title);
     // Constructor. Initialise everything and open a window with the given
     // title. You can then get it by calling window().
+
+    explicit GraphicsSystem(
+      Eigen::Vector2i size,
+      HeadlessContext::Platform platform = HeadlessContext::Platform::ANY
+    );
+    // Constructor. Initialise everything without a window, using a
+    // HeadlessContext, and draw into an offscreen Framebuffer of the given
+    // size. Everything else works as it does with a window; swap_buffers()
+    // just finishes the frame, without waiting for vsync. Throws a
+    // std::runtime_error if there's no way to get a context.
     
     Eigen::Vector2i window_size() const;
-    // Get the window size.
+    // Get the size of whatever is being drawn to: the render target if
+    // there is one, otherwise the window.
     
     GLFWWindow& window();
-    // Get the window.
+    // Get the window. Throws a std::runtime_error if headless.
+
+    bool headless() const;
+    // Is there no window?
+
+    void set_render_target(Framebuffer* target);
+    Framebuffer* render_target() const;
+    // Where drawing goes. Null means the window - or, if headless, the
+    // offscreen framebuffer, which is what render_target() then returns. The
+    // viewport, window_size() and sprite culling all follow the target. The
+    // target must outlive its use; a Framebuffer that's destroyed while it
+    // is the target puts things back to the default.
+
+    std::string renderer() const;
+    std::string gl_version() const;
+    // Get the OpenGL renderer and version strings.
+
+    StateCache& state();
+    // Get the OpenGL binding state. Graphics objects bind things through 
+    // this rather than calling OpenGL directly.
+
+    filesystem::FileSystem& file_system();
+    const filesystem::FileSystem& file_system() const;
+    // Get the file system that textures, shaders and so on are loaded
+    // through. Mount packs on it before loading anything; with nothing
+    // mounted, paths are just paths on disk.
+
+    ProgramCache& programs();
+    // Get the shader program cache. Use this rather than building programs
+    // by hand so that identical ones are only compiled once.
+
+    TextureResidency& residency();
+    // Get the texture residency manager. Set a budget on it to keep texture
+    // memory down; by default there isn't one.
+
+    profiling::Profiler& profiler();
+    GpuProfiler& gpu_profiler();
+    // Get the frame profiler, and the GPU timer that feeds it. A "Frame"
+    // scope - the time between swaps - is recorded automatically.
+
+    FrameCapture& capture();
+    // Get the frame capturer. Start it to have every frame read back, a few
+    // frames late, without stalling anything.
+
+    jobs::JobSystem& jobs();
+    // Get the job system. Per-frame work that can be split up - sprite
+    // updates, image decoding and so on - goes through this. Jobs mustn't
+    // touch OpenGL; that stays on this thread.
+
+    float animation_time() const;
+    void set_animation_time(float milliseconds);
+    // The clock that GPU-animated sprites are driven by. Nothing advances
+    // this automatically; set it once per frame, before drawing. It's a
+    // float, so keep it below a few hours' worth of milliseconds to keep
+    // frames exact.
+
+    void run(
+      std::function<void(float)> update,
+      std::function<void(float)> render,
+      const LoopSettings& settings = LoopSettings()
+    );
+    // Run the main loop until stop() is called or the window is closed.
+    //
+    // The simulation moves in fixed steps: update() is called with the step
+    // size in milliseconds, as many times as real time demands, so its cost
+    // doesn't depend on the frame rate. Frames are drawn at their own rate,
+    // by calling render() with how far real time is between the last two
+    // simulation states, from 0 to 1, and then swap_buffers(). Draw sprites
+    // with that, after calling save_state() at the start of every update,
+    // and motion is smooth whatever the two rates are:
+    //
+    //   graphics.run(
+    //     [&](float dt) { world.save_state(); move(world, dt); world.update(dt); },
+    //     [&](float alpha) { world.draw(batch, alpha); batch.draw(); }
+    //   );
+    //
+    // The animation time is set to match before each render. Window events
+    // are polled each time round. Statistics go in loop_stats().
+    //
+    // Throws a std::invalid_argument if step_ms isn't more than 0 or
+    // max_steps is less than 1, since then the simulation would never move.
+
+    void stop();
+    // Make run() return once the current update or render is done.
+
+    const LoopStats& loop_stats() const;
+    // Get the frame time histograms and counts from run().
+
+    void swap_buffers();
+    // Swap the window's framebuffers and start a new frame. Per-frame
+    // statistics and profiler timings are rolled over here, streaming
+    // buffers move on to their next segment, and the frame is captured if
+    // capture() has been started.
+
+    void add_streaming_buffer(StreamingBuffer* buffer);
+    void remove_streaming_buffer(StreamingBuffer* buffer);
+    // Called by StreamingBuffer as buffers come and go, so that
+    // swap_buffers() can end the frame for all of them.
     
     ~GraphicsSystem();
 
   private:
+    void initialise_gl();
+    // Set up GLEW and read the driver strings, once a context is current.
+
     GLFWToken* m_glfw_token;
     GLFWWindow* m_window;
+    HeadlessContext* m_headless;
+    Framebuffer* m_offscreen;
+    Framebuffer* m_target;
+    // When headless there's no window, and drawing goes into the offscreen
+    // framebuffer by default instead.
+    std::string m_renderer;
+    std::string m_gl_version;
+    StateCache m_state;
+    filesystem::FileSystem m_file_system;
+    ProgramCache m_programs;
+    TextureResidency m_residency;
+    std::vector<StreamingBuffer*> m_streaming_buffers;
+    jobs::JobSystem m_jobs;
+    profiling::Profiler m_profiler;
+    GpuProfiler m_gpu_profiler;
+    FrameCapture m_capture;
+    double m_frame_start;
+    float m_animation_time;
+    bool m_running;
+    LoopStats m_loop_stats;
   };
 
 }
@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * An OpenGL context with no window, for rendering on machines without a
+ * display - benchmarks, build servers and so on.
+ */
+
+#include <string>
+
+#include <utils/NonCopyable.hpp>
+
+namespace graphics {
+
+  /**
+   * Creates an OpenGL 3.3 core context through EGL and makes it current on
+   * the calling thread. There's no window, so there's no default framebuffer
+   * worth drawing to; render into a framebuffer object instead.
+   *
+   * Mesa's surfaceless platform needs no display server at all (set
+   * LIBGL_ALWAYS_SOFTWARE=1 to force llvmpipe). Otherwise the default EGL
+   * display is used with a tiny pbuffer surface, which works with drivers
+   * that only do EGL through X or Wayland. Nothing is ever presented, so
+   * there's no vsync to wait for either way.
+   *
+   * Throws std::runtime_error if no context can be made, and always on
+   * platforms without EGL.
+   **/
+  class HeadlessContext : public NonCopyable {
+  public:
+
+    enum class Platform {
+      ANY,         // Surfaceless if possible, otherwise pbuffer.
+      SURFACELESS,
+      PBUFFER
+    };
+
+    explicit HeadlessContext(Platform platform = Platform::ANY);
+    ~HeadlessContext();
+
+    /**
+     * Make the context current on the calling thread.
+     **/
+    void make_current();
+
+    /**
+     * Which EGL platform the context came from: "surfaceless" or "pbuffer".
+     **/
+    std::string platform() const;
+
+  private:
+    void* m_display;
+    void* m_surface;
+    void* m_context;
+    std::string m_platform;
+  };
+
+}
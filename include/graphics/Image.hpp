@@ -0,0 +1,72 @@
+//*****************************************************************************
+// An image in main memory, as opposed to a Texture which lives on the GPU.
+//
+// e.g.
+//
+//   Image image(Path("data/textures/lucy.png"));
+//   Texture texture(graphics, TextureTarget::TEXTURE_2D, image);
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <filesystem/Path.hpp>
+
+namespace filesystem {
+  class FileData;
+  class FileSystem;
+}
+
+namespace graphics {
+
+  //***************************************************************************
+  // An 8 bit per channel RGBA image. Rows are stored top to bottom with no
+  // padding between them.
+  class Image {
+  public:
+
+    explicit Image(filesystem::Path filename);
+    // Read an image from a file. Throws a std::runtime_error if it can't be
+    // read.
+
+    Image(const filesystem::FileSystem& files, filesystem::Path filename);
+    // As above, but finding the file in a virtual file system.
+
+    explicit Image(Eigen::Vector2i size);
+    // Create a transparent black image of the given size.
+
+    Eigen::Vector2i size() const;
+    // Get the size in pixels.
+
+    unsigned char* data();
+    const unsigned char* data() const;
+    // Get the pixels.
+
+    size_t byte_size() const;
+    // Get the size of the pixel data in bytes.
+
+    void blit(
+      const Image& source,
+      Eigen::Vector2i source_min,
+      Eigen::Vector2i size,
+      Eigen::Vector2i destination_min
+    );
+    // Copy a rectangle of the given size from the source image into this
+    // one. Both rectangles must be within their images.
+
+    Image half_size() const;
+    // Get the next mip level down: half the size, rounding down but at least
+    // one pixel, with each pixel the average of up to four. Colours are
+    // weighted by alpha so that transparent pixels don't darken the edges of
+    // sprites.
+
+  private:
+    void load(const filesystem::FileData& file, const filesystem::Path& filename);
+
+    Eigen::Vector2i m_size;
+    std::vector<unsigned char> m_data;
+  };
+
+}
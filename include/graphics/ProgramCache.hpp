@@ -0,0 +1,140 @@
+/**
+ * Sharing shader programs between the things that use them.
+ *
+ * e.g.
+ *
+ *   ProgramSource source(
+ *     Path("data/shaders/animation.glsl.v"),
+ *     Path("data/shaders/animation.glsl.f")
+ *   );
+ *   source.attribute(AttributeIndex(0), "position");
+ *   std::shared_ptr<ShaderProgram> program = graphics.programs().get(source);
+ **/
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <filesystem/Path.hpp>
+
+#include <graphics/GraphicsObject.hpp>
+#include <graphics/ShaderProgram.hpp>
+
+namespace graphics {
+
+  /**
+   * Everything needed to build a shader program: where the source lives,
+   * any preprocessor definitions to add to it, and the attribute locations
+   * to bind before linking. Two sources that compare equal give the same
+   * program.
+   **/
+  class ProgramSource {
+  public:
+    ProgramSource(
+      filesystem::Path vertex_shader,
+      filesystem::Path fragment_shader
+    );
+
+    /**
+     * Add "#define <definition>" to both shaders, just after the #version
+     * line. e.g. define("MAX_LIGHTS 4").
+     **/
+    ProgramSource& define(std::string definition);
+
+    /**
+     * Bind the named vertex attribute to the given index.
+     **/
+    ProgramSource& attribute(AttributeIndex index, std::string name);
+
+    const filesystem::Path& vertex_shader() const;
+    const filesystem::Path& fragment_shader() const;
+    const std::vector<std::string>& definitions() const;
+    const std::vector<std::pair<int, std::string>>& attributes() const;
+
+    /**
+     * A string that uniquely identifies the program.
+     **/
+    std::string key() const;
+
+  private:
+    filesystem::Path m_vertex_shader;
+    filesystem::Path m_fragment_shader;
+    std::vector<std::string> m_definitions;
+    std::vector<std::pair<int, std::string>> m_attributes;
+  };
+
+  /**
+   * Compiles each distinct program once and hands out shared references to
+   * it. The cache doesn't keep programs alive by itself - once the last
+   * reference goes the program is deleted, and asking for it again will
+   * compile it again.
+   *
+   * Linked programs can also be kept on disk between runs - see
+   * set_binary_directory().
+   **/
+  class ProgramCache : public GraphicsObject {
+  public:
+    explicit ProgramCache(GraphicsSystem& system);
+
+    /**
+     * Get the program for the given source, compiling and linking it if it
+     * isn't already around. Throws std::runtime_error if the shaders can't
+     * be read, don't compile or don't link.
+     **/
+    std::shared_ptr<ShaderProgram> get(const ProgramSource& source);
+
+    /**
+     * Keep program binaries in the given directory, which must already
+     * exist. Binaries are named after a hash of the shader source, the
+     * attribute bindings and the OpenGL renderer and version, so a driver
+     * update just means a recompile. Does nothing if the driver doesn't
+     * support program binaries - see caching_binaries().
+     **/
+    void set_binary_directory(filesystem::Path directory);
+
+    /**
+     * Whether binaries are being kept, i.e. a directory has been set and
+     * the driver supports them.
+     **/
+    bool caching_binaries() const;
+
+    /**
+     * Statistics: how many times get() found a program already built, and
+     * how many times it had to build one.
+     **/
+    int hits() const;
+    int misses() const;
+
+    /**
+     * Statistics: how many programs were compiled from source and how many
+     * were loaded from binaries, and the total seconds spent on each. The
+     * cache doesn't log anything itself; this is where to look instead.
+     **/
+    int compiled() const;
+    int loaded() const;
+    double compile_seconds() const;
+    double load_seconds() const;
+
+  private:
+    std::shared_ptr<ShaderProgram> build(
+      const ProgramSource& source,
+      const std::string& vertex_source,
+      const std::string& fragment_source
+    );
+
+    std::map<std::string, std::weak_ptr<ShaderProgram>> m_programs;
+    bool m_use_binaries;
+    std::string m_binary_directory;
+    int m_hits;
+    int m_misses;
+    int m_compiled;
+    int m_loaded;
+    double m_compile_seconds;
+    double m_load_seconds;
+  };
+
+}
@@ -6,9 +6,14 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <cstring>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <graphics/GraphicsObject.hpp>
+#include <graphics/BufferObjects.hpp>
 
 #include <filesystem/Path.hpp>
 
@@ -17,6 +22,83 @@
 namespace graphics {
 
   class Shader;
+  class ShaderProgram;
+
+  /**
+   * Describes how to upload a value of type T to a uniform. Specialised below
+   * for each type that a Uniform can have.
+   **/
+  template <typename T> struct UniformTraits;
+
+  template <> struct UniformTraits<float> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT; }
+    static void upload(GLint loc, const float& v) { glUniform1f(loc, v); }
+  };
+
+  template <> struct UniformTraits<int> {
+    static bool accepts(GLenum type) {
+      return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D;
+    }
+    static void upload(GLint loc, const int& v) { glUniform1i(loc, v); }
+  };
+
+  template <> struct UniformTraits<Eigen::Vector2f> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC2; }
+    static void upload(GLint loc, const Eigen::Vector2f& v) {
+      glUniform2f(loc, v[0], v[1]);
+    }
+  };
+
+  template <> struct UniformTraits<Eigen::Vector2i> {
+    static bool accepts(GLenum type) { return type == GL_INT_VEC2; }
+    static void upload(GLint loc, const Eigen::Vector2i& v) {
+      glUniform2i(loc, v[0], v[1]);
+    }
+  };
+
+  template <> struct UniformTraits<Eigen::Matrix2f> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT2; }
+    static void upload(GLint loc, const Eigen::Matrix2f& v) {
+      glUniformMatrix2fv(loc, 1, GL_FALSE, v.data());
+    }
+  };
+
+  template <> struct UniformTraits<Eigen::Matrix3f> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+    static void upload(GLint loc, const Eigen::Matrix3f& v) {
+      glUniformMatrix3fv(loc, 1, GL_FALSE, v.data());
+    }
+  };
+
+  template <> struct UniformTraits<Eigen::Matrix4f> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+    static void upload(GLint loc, const Eigen::Matrix4f& v) {
+      glUniformMatrix4fv(loc, 1, GL_FALSE, v.data());
+    }
+  };
+
+  /**
+   * A handle to a uniform in a linked shader program. Get one from
+   * ShaderProgram::uniform(). Setting a value is just a write to a cached
+   * location, and is skipped entirely if the value hasn't changed.
+   *
+   * A default constructed handle, or one for a uniform that the program
+   * doesn't use, does nothing when set. Handles are invalidated if the
+   * program is relinked or destroyed.
+   **/
+  template <typename T>
+  class Uniform {
+  public:
+    Uniform() : m_program(nullptr), m_slot(-1) {}
+    void set(const T& value);
+    bool valid() const { return m_program != nullptr; }
+  private:
+    friend class ShaderProgram;
+    Uniform(ShaderProgram* program, int slot) 
+      : m_program(program), m_slot(slot) {}
+    ShaderProgram* m_program;
+    int m_slot;
+  };
 
   /**
    * Class for initialising and managing an OpenGL shader program object.
@@ -25,18 +107,115 @@ namespace graphics {
   public:
     explicit ShaderProgram(GraphicsSystem& tok);
     void attach(const Shader& shader);
+    void bind_attribute(AttributeIndex index, std::string name);
+
+    /**
+     * Link the program and look up all of its active uniforms. Returns
+     * false if linking failed.
+     **/
     bool link();
     void bind();
 
-    void set_uniform(std::string name, float value);
-    void set_uniform(std::string name, Eigen::Vector2f value);
-    void set_uniform(std::string name, int value);
-    void set_uniform(std::string name, Eigen::Vector2i value);
+    /**
+     * Get the log from the last link, e.g. to find out why it failed.
+     **/
+    std::string info_log();
+
+    /**
+     * Is saving and loading program binaries supported by the driver?
+     **/
+    static bool binaries_supported();
+
+    /**
+     * Ask the driver to keep the linked binary around so that save_binary()
+     * can get at it. Must be called before link().
+     **/
+    void allow_binary_retrieval();
+
+    /**
+     * Write the linked program's binary to a file. Returns false if there is
+     * no binary to be had or the file can't be written.
+     **/
+    bool save_binary(const filesystem::Path& path);
+
+    /**
+     * Load a binary written by save_binary() instead of attaching shaders
+     * and linking. Returns false if the file can't be read or the driver
+     * rejects it (e.g. because the driver has been updated since), in which
+     * case the program needs building from source.
+     **/
+    bool load_binary(const filesystem::Path& path);
+
+    /**
+     * Get a handle to the named uniform. Throws std::runtime_error if the
+     * uniform exists but isn't of type T. If the uniform doesn't exist (or
+     * has been optimised out) the handle is valid() == false.
+     **/
+    template <typename T> Uniform<T> uniform(const std::string& name);
+
+    /**
+     * Convenience versions of the above. Prefer holding on to a Uniform.
+     **/
+    void set_uniform(const std::string& name, float value);
+    void set_uniform(const std::string& name, Eigen::Vector2f value);
+    void set_uniform(const std::string& name, int value);
+    void set_uniform(const std::string& name, Eigen::Vector2i value);
 
     ~ShaderProgram();
   private:
+    template <typename T> friend class Uniform;
+
+    struct UniformSlot {
+      GLint location;
+      GLenum type;
+      bool written;
+      unsigned char shadow[sizeof(Eigen::Matrix4f)];
+    };
+    // An active uniform. The shadow holds the last value written to it, so
+    // that writing the same thing again can be skipped.
+
+    int find_uniform(const std::string& name) const;
+    void query_uniforms();
+    template <typename T> void write_uniform(int slot, const T& value);
+
     GLuint m_id;
+    std::vector<UniformSlot> m_uniforms;
+    std::unordered_map<std::string, int> m_uniform_slots;
   };
+
+  //***************************************************************************
+  template <typename T>
+  void Uniform<T>::set(const T& value)
+  {
+    if (m_program) m_program->write_uniform(m_slot, value);
+  }
+
+  //***************************************************************************
+  template <typename T>
+  Uniform<T> ShaderProgram::uniform(const std::string& name)
+  {
+    int slot = find_uniform(name);
+    if (slot < 0) return Uniform<T>();
+    if (!UniformTraits<T>::accepts(m_uniforms[slot].type)) {
+      throw std::runtime_error("Wrong type for uniform " + name);
+    }
+    return Uniform<T>(this, slot);
+  }
+
+  //***************************************************************************
+  template <typename T>
+  void ShaderProgram::write_uniform(int slot, const T& value)
+  {
+    static_assert(sizeof(T) <= sizeof(UniformSlot::shadow), "Uniform too big");
+
+    UniformSlot& u = m_uniforms[slot];
+    if (u.written && std::memcmp(u.shadow, &value, sizeof(T)) == 0) return;
+    std::memcpy(u.shadow, &value, sizeof(T));
+    u.written = true;
+
+    bind();
+    UniformTraits<T>::upload(u.location, value);
+  }
   
   /**
    * Base class for initialising and managing an OpenGL shader object. You don't
@@ -69,7 +248,7 @@ namespace graphics {
     virtual ~Shader();
   
   private:
-    void initialise(GLenum type, std::string source);
+    void initialise(GLenum type, const char* source, size_t length);
     bool invalid();
     std::string info_log();
     friend class ShaderProgram;
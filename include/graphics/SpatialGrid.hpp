@@ -0,0 +1,101 @@
+//*****************************************************************************
+// Finding things by where they are.
+//
+// e.g.
+//
+//   SpatialGrid grid(128);
+//   grid.update(id, box.min(), box.max());
+//
+//   std::vector<uint32_t> candidates;
+//   grid.query(cursor, cursor, candidates);
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace graphics {
+
+  //***************************************************************************
+  // A rectangle with its min corner at 'min', rotated about its centre -
+  // which is how sprites are drawn.
+  class OrientedBox {
+  public:
+
+    OrientedBox(Eigen::Vector2f min, Eigen::Vector2f size, float orientation_radians);
+
+    bool contains(Eigen::Vector2f point) const;
+    // Is the point inside the box? Points on the edge count.
+
+    bool overlaps(Eigen::Vector2f rect_min, Eigen::Vector2f rect_max) const;
+    // Does the box overlap the axis aligned rectangle?
+
+    Eigen::Vector2f min() const;
+    Eigen::Vector2f max() const;
+    // Get the axis aligned bounds of the box.
+
+  private:
+    Eigen::Vector2f m_centre;
+    Eigen::Vector2f m_half_size;
+    float m_cos;
+    float m_sin;
+  };
+
+  //***************************************************************************
+  // A uniform grid of square cells, each listing the ids whose bounds touch
+  // it. Moving something only touches the cells it leaves and enters, and
+  // moving within the same cells costs nothing.
+  //
+  // Ids index an array, so keep them small and dense.
+  class SpatialGrid {
+  public:
+
+    explicit SpatialGrid(float cell_size = 128);
+    // Ctor. The grid is empty and covers the whole plane.
+
+    void update(uint32_t id, Eigen::Vector2f min, Eigen::Vector2f max);
+    // Set the bounds of an id, adding it if it isn't in the grid.
+
+    void remove(uint32_t id);
+    // Take an id out of the grid. Does nothing if it isn't in.
+
+    void query(
+      Eigen::Vector2f min,
+      Eigen::Vector2f max,
+      std::vector<uint32_t>& ids
+    ) const;
+    // Append every id whose bounds might overlap the rectangle, once each.
+    // These are only candidates: test them properly.
+
+  private:
+
+    struct Entry {
+      int cell_min[2];
+      int cell_max[2];
+      bool present;
+    };
+
+    typedef uint64_t CellKey;
+    CellKey key(int x, int y) const;
+    int cell(float coordinate) const;
+
+    void add_to_cells(uint32_t id, const Entry& entry);
+    void remove_from_cells(uint32_t id, const Entry& entry);
+
+    float m_cell_size;
+    std::vector<Entry> m_entries;
+    // The cells each id is in, indexed by id.
+
+    std::unordered_map<CellKey, std::vector<uint32_t>> m_cells;
+    // The ids in each cell that has any.
+
+    mutable std::vector<uint32_t> m_marks;
+    mutable uint32_t m_query;
+    // The last query that returned each id, so that things in several cells
+    // are returned only once.
+  };
+
+}
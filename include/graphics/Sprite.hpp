@@ -14,6 +14,35 @@
 #include <graphics/ShaderProgram.hpp>
 
 namespace graphics {
+
+  class SpriteBatch;
+  class CommandList;
+
+  //***************************************************************************
+  // Per-instance data for drawing an Animation. This is uploaded as is into
+  // an instance buffer, so it must stay a tightly packed bunch of floats. The
+  // frame is a float because it goes through the same attribute path as
+  // everything else; the shader truncates it.
+  //
+  // A negative frame means the shader works out the frame itself, from the
+  // start time, period and frame count, and the GraphicsSystem's animation
+  // time.
+  //
+  // Everything needed to find the frame in the texture is in here rather
+  // than in uniforms, so that animations sharing a texture (e.g. an atlas
+  // page) can be drawn together.
+  struct AnimationInstance {
+    float origin[2];
+    float orientation;
+    float frame;
+    float frame_size[2]; // Pixels
+    float frame_uvs[4];  // Texcoords of the sheet's min corner, then the
+                         // texcoord size of one frame.
+    float columns;       // Frames per row of the sheet.
+    float start_time;    // Milliseconds, on the animation clock.
+    float period;        // Milliseconds per frame.
+    float frame_count;
+  };
   
   //***************************************************************************
   // Wraps up various bits of rendering states under a simple interface - draw
@@ -43,11 +72,66 @@ namespace graphics {
     // Throws a runtime error if the size and frame count don't fit in the
     // texture that gets loaded. Because fuck you.
 
+    Animation(
+      GraphicsSystem& gtok,
+      TextureRegion sheet,
+      Eigen::Vector2i frame_size,
+      int frame_count,
+      float period // Milliseconds per frame
+    );
+    // As above, but the frames are laid out in the given region of a texture
+    // rather than taking up a whole one - e.g. a sheet in a TextureAtlas.
+
     void draw(int frame, Eigen::Vector2f position, float orientation_radians);
     // Draw the animation at the given frame. It is drawn as a rectangle
     // with min point (0, 0) and max point (width, height). The rectangle is
-    // transformed such that it is centred on the given point. It is rotated
-    // about its centre by the given angle.
+    // moved so that its min point is at the given position, and rotated
+    // about its centre by the given angle - see OrientedBox.
+    //
+    // This is a single instanced draw call, or nothing at all if the
+    // rectangle is entirely outside the window. If you are drawing lots of
+    // things, put them in a SpriteBatch instead.
+
+    void draw_animated(
+      float start_time,
+      Eigen::Vector2f position,
+      float orientation_radians
+    );
+    // As draw(), but the frame is whichever one is showing at the current
+    // animation time if the animation started at 'start_time'.
+
+    AnimationInstance instance(
+      int frame, 
+      Eigen::Vector2f position, 
+      float orientation_radians
+    ) const;
+    AnimationInstance animated_instance(
+      float start_time,
+      Eigen::Vector2f position,
+      float orientation_radians
+    ) const;
+    // Get the instance data for drawing the animation at the given frame, or
+    // the frame the GPU works out from a start time, and the given position
+    // and orientation.
+
+    float time() const;
+    // Get the current animation time. See GraphicsSystem::animation_time().
+
+    int frame_at(float start_time) const;
+    // Get the frame showing now if the animation started at 'start_time'.
+    // This is the same sum as the shader does.
+
+    float start_time_for(int frame) const;
+    // Get a start time that makes the given frame show now, just starting.
+
+    void draw_instances(VertexBufferObject& instances, size_t offset, int count);
+    // Draw 'count' instances of the animation in one go. The instance data
+    // is read from the given buffer, starting 'offset' bytes in, as an
+    // array of AnimationInstance. The instances don't have to belong to
+    // this animation as long as they use the same texture.
+
+    const Texture& texture() const;
+    // Get the texture the frames are in.
     
     Eigen::Vector2i size() const;
     // Get the dimensions of a frame.
@@ -59,34 +143,86 @@ namespace graphics {
     int frame_count() const;
 
   private:
+
+    void draw_instance(const AnimationInstance& instance);
+    // Draw a single instance, if it is on screen.
+
+    static TextureRegion load_sheet(GraphicsSystem& gtok, filesystem::Path path);
+    // Load a texture and make a region covering all of it.
     
     void check_validity() const;
     // Check the validity.
+
+    void instance_attribute(
+      AttributeIndex index,
+      VertexBufferObject& instances,
+      ComponentCount count,
+      size_t offset
+    );
+    // Point an instance attribute at a float field of AnimationInstance.
     
     Eigen::Vector2i m_frame_size;
     int m_frame_count;
     float m_period;
     // Animation frame data.
 
+    TextureRegion m_sheet;
+    int m_columns;
+    float m_frame_uvs[4];
+    // Where the frames are. The texture is shared with anything else in the
+    // same atlas page.
+
     Eigen::Vector2f m_positions_arr[4];
     VertexBufferObject m_positions;
     AttributeIndex m_positions_attribute;
-    // Positions of the four vertices of the (untransformed) rectangle.
+    // Positions of the four vertices of the unit square. The shader scales
+    // this up by the frame size.
+
+    VertexBufferObject m_instance;
+    AttributeIndex m_origin_attribute;
+    AttributeIndex m_orientation_attribute;
+    AttributeIndex m_frame_attribute;
+    AttributeIndex m_frame_size_attribute;
+    AttributeIndex m_frame_uvs_attribute;
+    AttributeIndex m_columns_attribute;
+    AttributeIndex m_timing_attribute;
+    // Per-instance attributes. Timing is the start time, period and frame
+    // count all in one. The buffer is only used by draw(); batched
+    // draws point the attributes at the batch's buffer instead.
 
     VertexArrayObject m_vertex_attributes;
     // Vertex array object for wrapping up the above attributes.
     
-    FragmentShader m_fragment_shader;
-    VertexShader m_vertex_shader;
-    ShaderProgram m_shader_program;
-    // A simple shader program for doing the drawing.
+    std::shared_ptr<ShaderProgram> m_shader_program;
+    // A simple shader program for doing the drawing. This comes from the
+    // program cache, so all animations share it.
 
-    Texture m_texture;
-    // The texture containing the frames.
+    Uniform<float> m_time_uniform;
+    Uniform<Eigen::Vector2i> m_window_size_uniform;
+    Uniform<int> m_top_row_first_uniform;
+    // Set to the animation time and the render target on every draw.
+    // Setting them again to the same thing costs nothing.
   };
   
 
   
+  //***************************************************************************
+  void advance_frame(
+    float& time_accumulated, 
+    int& frame, 
+    float period, 
+    int frame_count
+  );
+  // Take whole periods off the accumulated time and move the frame on by
+  // that many, wrapping around at the frame count, for as long as more than
+  // a period is left - so the time left over is in (0, period]. Works in
+  // constant time however much time has accumulated.
+
+  //***************************************************************************
+  float interpolate_angle(float from, float to, float alpha);
+  // Get the angle a fraction 'alpha' of the way from one angle to another,
+  // in radians, going the short way round.
+
   //***************************************************************************
   // A thing with a position and an animation which knows how to update itself
   // and draw itself.
@@ -112,12 +248,40 @@ namespace graphics {
     void update(float dt);
     // Update the sprite, passing in the system time and the delta since the
     // last update.
+
+    void animate_on_gpu();
+    // Have the GPU work out the frame from the animation time instead, so
+    // that update() does nothing. The animation carries on from the current
+    // frame. stop_animating() and set_frame() still work.
     
     void draw();
     // Draw the sprite.
+
+    void draw(SpriteBatch& batch);
+    // Add the sprite to the given batch, to be drawn when the batch is.
+
+    void draw(CommandList& list);
+    // Record the sprite into a command list, which may be done on any
+    // thread - see CommandQueue.
+
+    void save_state();
+    // Remember the current position and orientation as the previous
+    // simulation state. Call this at the start of every fixed simulation
+    // step, before moving the sprite - see GraphicsSystem::run().
+
+    Eigen::Vector2f interpolated_position(float alpha) const;
+    float interpolated_orientation(float alpha) const;
+    // Get the position and orientation a fraction 'alpha' of the way from
+    // the previous simulation state to the current one.
+
+    void draw(float alpha);
+    void draw(SpriteBatch& batch, float alpha);
+    void draw(CommandList& list, float alpha);
+    // As above, but at the interpolated position and orientation.
     
     bool contains(Eigen::Vector2f point) const;
-    // Does the sprite contain the point?
+    // Does the sprite contain the point? This is exact for rotated sprites.
+    // A sprite with no animation contains nothing.
     
     void randomise_frame();
     // Set the frame to a random value.
@@ -127,6 +291,11 @@ namespace graphics {
     
   private:
 
+    void draw_at(Eigen::Vector2f position, float orientation);
+    void draw_at(SpriteBatch& batch, Eigen::Vector2f position, float orientation);
+    void draw_at(CommandList& list, Eigen::Vector2f position, float orientation);
+    // Draw the sprite somewhere other than where it is.
+
     float m_time_accumulated;
     int m_frame;
     std::shared_ptr<Animation> m_animation;
@@ -140,9 +309,18 @@ namespace graphics {
     
     float m_orientation;
     // Sprite orientation.
+
+    Eigen::Vector2f m_previous_position;
+    float m_previous_orientation;
+    // The state as of the last save_state(), for interpolating.
     
     bool m_animating;
 
+    bool m_on_gpu;
+    float m_start_time;
+    // When animating on the GPU, the frame is worked out from the start
+    // time, and m_frame is only used once the sprite stops animating.
+
   };
 
 }
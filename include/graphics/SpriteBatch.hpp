@@ -0,0 +1,100 @@
+//*****************************************************************************
+// Batched sprite drawing.
+//
+// e.g.
+//
+//   SpriteBatch batch(graphics);
+//   for (auto& sprite : sprites) sprite.draw(batch);
+//   batch.draw();
+
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <graphics/GraphicsObject.hpp>
+#include <graphics/CommandList.hpp>
+#include <graphics/Sprite.hpp>
+
+namespace graphics {
+
+  //***************************************************************************
+  // Collects things to draw and then draws them with as few draw calls as
+  // possible. Everything sharing a texture goes out in a single instanced
+  // draw call - so animations packed into the same TextureAtlas page are
+  // drawn together.
+  //
+  // Within a texture things are drawn in the order they were added, and
+  // the textures are drawn in the order they were first added - so
+  // something is drawn over everything added before it with the same
+  // texture, and over everything with a texture first added before its own.
+  //
+  // Anything added that is entirely outside the view rectangle is culled
+  // rather than drawn.
+  //
+  // This is a CommandQueue with a single list, filled and drawn on the GL
+  // thread.
+  class SpriteBatch : public GraphicsObject {
+  public:
+
+    explicit SpriteBatch(GraphicsSystem& gtok);
+    // Constructor. The batch starts off empty.
+
+    void add(
+      Animation& animation,
+      int frame,
+      Eigen::Vector2f position,
+      float orientation_radians
+    );
+    // Add an animation to be drawn, unless it's outside the view. See
+    // Animation::draw() for what the arguments mean. The animation must
+    // outlive the next call to draw() or clear().
+
+    void add_animated(
+      Animation& animation,
+      float start_time,
+      Eigen::Vector2f position,
+      float orientation_radians
+    );
+    // As add(), but the GPU works out the frame. See
+    // Animation::draw_animated().
+
+    void add(Animation& animation, const AnimationInstance& instance);
+    // Add an instance already worked out with Animation::instance(). This
+    // isn't culled; the caller is expected to have done that already.
+
+    void set_view(Eigen::Vector2f min, Eigen::Vector2f max);
+    Eigen::Vector2f view_min() const;
+    Eigen::Vector2f view_max() const;
+    // The visible rectangle. By default this is the whole of the window, or
+    // the render target - see GraphicsSystem::set_render_target() - as it
+    // is when the batch starts being filled.
+
+    void count_culled(int count);
+    // Record that the caller culled some sprites itself rather than adding
+    // them, so that they show up in culled().
+
+    CommandList& list();
+    // Get the list things are added to, for code written to record into a
+    // CommandList. Adding to it is the same as adding to the batch.
+
+    void draw();
+    // Draw everything that has been added and then empty the batch.
+
+    void clear();
+    // Empty the batch without drawing anything.
+
+    int size() const;
+    // Get the number of things waiting to be drawn.
+
+    int draw_calls() const;
+    int culled() const;
+    // Get the number of draw calls made by the last call to draw(), and the
+    // number of sprites culled from it.
+
+  private:
+
+    CommandQueue m_queue;
+    // Everything goes into the queue's first list.
+  };
+
+}
@@ -0,0 +1,151 @@
+//*****************************************************************************
+// Sprite bundles: every texture and animation a game needs, baked into one
+// file that can be mapped and handed to the GPU as it is.
+//
+// e.g.
+//
+//   // At bake time (see tools/bake_sprites.cpp).
+//   SpriteBundleWriter writer;
+//   int page = writer.add_texture(
+//     CompressedImage::encode(builder.pages()[0], TextureFormat::BC3)
+//   );
+//   writer.add_animation("lucy", page, builder.min(lucy), builder.size(lucy),
+//                        Vector2i(64, 64), 8, 100);
+//   writer.save(Path("data/sprites.bundle"));
+//
+//   // At run time.
+//   SpriteBundle bundle(graphics, Path("data/sprites.bundle"));
+//   Sprite sprite;
+//   sprite.set_animation(bundle.animation("lucy"));
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <filesystem/Path.hpp>
+
+#include <graphics/GraphicsObject.hpp>
+#include <graphics/Texture.hpp>
+#include <graphics/TextureFormat.hpp>
+
+namespace graphics {
+
+  class Animation;
+  class CompressedImage;
+  class Image;
+
+  //***************************************************************************
+  // Builds a bundle in main memory and writes it out.
+  //
+  // The file is a header, a table of textures, a table of animations and a
+  // table of names, followed by the pixel data. Each mip level is stored
+  // exactly as the GPU wants it and starts on a 64 byte boundary, so that a
+  // mapping of the file can be passed to OpenGL directly. Everything is
+  // little-endian.
+  class SpriteBundleWriter {
+  public:
+
+    SpriteBundleWriter();
+    // Constructor. The bundle starts off empty.
+
+    int add_texture(
+      TextureFormat format,
+      Eigen::Vector2i size,
+      std::vector<std::vector<unsigned char>> levels
+    );
+    // Add a texture whose levels are already laid out in the given format.
+    // Level i must be the right size for a (size / 2^i) image. Returns the
+    // texture's index in the bundle.
+
+    int add_texture(const CompressedImage& image);
+    // Add a block compressed texture, with all of its levels.
+
+    int add_texture(const Image& image, TextureFormat format, bool mipmaps = false);
+    // Add an image, converting it to the given format first, optionally with
+    // a full mip chain. Compressed formats are encoded here, once, rather
+    // than at load time.
+
+    void add_animation(
+      const std::string& name,
+      int texture,
+      Eigen::Vector2i min,
+      Eigen::Vector2i size,
+      Eigen::Vector2i frame_size,
+      int frame_count,
+      float period // Milliseconds per frame
+    );
+    // Add an animation whose frames are laid out, as described for
+    // Animation, in the given rectangle of one of the textures. Names must
+    // be unique.
+
+    void save(filesystem::Path filename) const;
+    // Write the bundle. Throws a std::runtime_error on failure.
+
+  private:
+
+    struct TextureEntry {
+      TextureFormat format;
+      Eigen::Vector2i size;
+      std::vector<std::vector<unsigned char>> levels;
+    };
+
+    struct AnimationEntry {
+      std::string name;
+      int texture;
+      Eigen::Vector2i min;
+      Eigen::Vector2i size;
+      Eigen::Vector2i frame_size;
+      int frame_count;
+      float period;
+    };
+
+    std::vector<TextureEntry> m_textures;
+    std::vector<AnimationEntry> m_animations;
+  };
+
+  //***************************************************************************
+  // A loaded bundle. Its textures are uploaded and its animations made when
+  // it's constructed; nothing is decoded along the way.
+  class SpriteBundle : public GraphicsObject {
+  public:
+
+    SpriteBundle(GraphicsSystem& gtok, filesystem::Path filename);
+    // Map the bundle and upload its textures straight from the mapping.
+    // Throws a std::runtime_error if the file can't be read or is
+    // malformed, or if a texture is in a format the GPU can't do. BC1 and
+    // BC3 are decompressed instead if the GPU lacks them.
+
+    ~SpriteBundle();
+    // Destructor.
+
+    bool has_animation(const std::string& name) const;
+    // Is there an animation with the given name?
+
+    std::shared_ptr<Animation> animation(const std::string& name) const;
+    TextureRegion region(const std::string& name) const;
+    // Get an animation by name, or the rectangle of texture its frames are
+    // in. Throws a std::runtime_error if there's no such animation.
+
+    int texture_count() const;
+    std::shared_ptr<Texture> texture(int index) const;
+    // Get the textures.
+
+  private:
+
+    struct Entry {
+      std::shared_ptr<Animation> animation;
+      TextureRegion region;
+    };
+
+    const Entry& find(const std::string& name) const;
+
+    std::vector<std::shared_ptr<Texture>> m_textures;
+    std::map<std::string, Entry> m_animations;
+  };
+
+}
@@ -0,0 +1,287 @@
+//*****************************************************************************
+// Lots of sprites, stored for bulk processing.
+//
+// e.g.
+//
+//   SpriteWorld world;
+//   SpriteHandle lucy = world.create();
+//   world.set_animation(lucy, lucy_animation);
+//   world.set_position(lucy, Vector2f(100, 100));
+//
+//   world.update(dt);
+//   world.draw(batch);
+//
+//   std::vector<SpriteHandle> under_cursor = world.pick(cursor);
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <graphics/Sprite.hpp>
+#include <graphics/SpatialGrid.hpp>
+
+namespace jobs { class JobSystem; }
+
+namespace graphics {
+
+  class SpriteBatch;
+  class CommandQueue;
+
+  //***************************************************************************
+  // Refers to a sprite in a SpriteWorld. Handles stay valid while other
+  // sprites come and go, and a handle to a destroyed sprite is never
+  // mistaken for a newer one.
+  struct SpriteHandle {
+    uint32_t index;
+    uint32_t generation;
+    // Generation 0 is never used, so a zeroed handle refers to nothing.
+
+    SpriteHandle() : index(0), generation(0) {}
+    SpriteHandle(uint32_t index, uint32_t generation)
+      : index(index), generation(generation) {}
+  };
+
+  class SpriteView;
+
+  //***************************************************************************
+  // Stores the same state as lots of Sprites, but as a structure of arrays:
+  // each field of every sprite is in its own contiguous array. Bulk
+  // operations like update() then run straight down the arrays, and
+  // update() does four sprites at a time with SSE where available.
+  //
+  // Sprites are also kept in a SpatialGrid, updated as they move, so that
+  // finding the sprites at a point doesn't mean testing every one.
+  //
+  // The per-sprite methods have the same meanings as their namesakes in
+  // Sprite. Passing a handle that isn't alive() is an error.
+  class SpriteWorld {
+  public:
+
+    explicit SpriteWorld(float grid_cell_size = 128);
+    // Ctor. The world is empty. The cell size of the spatial index is best
+    // around the size of a typical sprite.
+
+    SpriteHandle create();
+    // Create a sprite at (0, 0) with no animation.
+
+    void destroy(SpriteHandle sprite);
+    // Destroy a sprite. Its handle (and any copies) stop being alive.
+
+    bool alive(SpriteHandle sprite) const;
+    // Does the handle refer to a sprite?
+
+    int size() const;
+    // Get the number of sprites.
+
+    SpriteView view(SpriteHandle sprite);
+    // Get a Sprite-like view of a sprite.
+
+    void set_animation(SpriteHandle sprite, std::shared_ptr<Animation> animation);
+    Eigen::Vector2f position(SpriteHandle sprite) const;
+    void set_position(SpriteHandle sprite, Eigen::Vector2f position);
+    float orientation(SpriteHandle sprite) const;
+    void set_orientation(SpriteHandle sprite, float orientation);
+    int frame(SpriteHandle sprite) const;
+    void set_frame(SpriteHandle sprite, int frame);
+    void randomise_frame(SpriteHandle sprite);
+    void stop_animating(SpriteHandle sprite);
+    bool contains(SpriteHandle sprite, Eigen::Vector2f point) const;
+    // Per-sprite state. See Sprite.
+
+    void animate_on_gpu(SpriteHandle sprite, bool gpu = true);
+    bool animated_on_gpu(SpriteHandle sprite) const;
+    // Whether the GPU works out the sprite's frame, as with
+    // Sprite::animate_on_gpu(). Sprites animated on the GPU are kept apart
+    // from the rest, so update() doesn't even look at them. Switching moves
+    // the sprite in the draw order.
+
+    std::vector<SpriteHandle> pick(Eigen::Vector2f point) const;
+    std::vector<SpriteHandle> query(Eigen::Vector2f min, Eigen::Vector2f max) const;
+    // Get the sprites containing a point, or overlapping a rectangle, taking
+    // their orientation into account. They come back in the order the last
+    // draw() put them on screen, bottom first, so the one on top is last -
+    // as long as the world was the only thing drawn with the batch or
+    // queue. destroy() and animate_on_gpu() shuffle the draw order.
+
+    void update(float dt);
+    void update(float dt, jobs::JobSystem& jobs);
+    // Advance the animation of every sprite by dt milliseconds, optionally
+    // splitting the sprites between the job system's threads.
+
+    void draw(SpriteBatch& batch) const;
+    void draw(SpriteBatch& batch, jobs::JobSystem& jobs) const;
+    // Add every sprite with an animation to the batch, apart from those
+    // outside the batch's view. Culling is done four sprites at a time with
+    // SSE where available, and the number culled is added to the batch's
+    // count. With a job system the culling and instance data are worked out
+    // in parallel and then added in one go.
+
+    void save_state();
+    // Remember every sprite's position and orientation as the previous
+    // simulation state. Call this at the start of every fixed simulation
+    // step, before moving anything - see GraphicsSystem::run(). New sprites
+    // start with a previous state of (0, 0) and no rotation, so save the
+    // state after placing them, or they slide in from the corner.
+
+    void draw(SpriteBatch& batch, float alpha) const;
+    void draw(SpriteBatch& batch, float alpha, jobs::JobSystem& jobs) const;
+    // As draw(), but with each sprite a fraction 'alpha' of the way from its
+    // previous state to its current one. Culling uses the current rotated
+    // bounds at the interpolated position, which is near enough for the
+    // small turns made in one step.
+
+    void draw(CommandQueue& queue, float alpha, jobs::JobSystem& jobs) const;
+    // As above, but each job records its share straight into its own
+    // command list, so the GL thread only has to merge the lists and copy
+    // the instances once, into the instance buffer. This begin()s the
+    // queue; call CommandQueue::submit() afterwards.
+
+  private:
+
+    uint32_t dense(SpriteHandle sprite) const;
+    // Get the index of a sprite in the arrays below.
+
+    void swap_sprites(uint32_t a, uint32_t b);
+    // Swap two sprites' places in the arrays.
+
+    bool on_gpu(uint32_t index) const;
+    AnimationInstance instance(
+      uint32_t index,
+      float x,
+      float y,
+      float orientation
+    ) const;
+    // Is a sprite animated on the GPU, and how should it be drawn at the
+    // given position and orientation?
+
+    OrientedBox box(uint32_t index) const;
+    void reindex(uint32_t index);
+    // Get the box a sprite is drawn in, and update its place in the grid.
+    // Sprites with no animation aren't drawn and aren't in the grid.
+
+    void set_extents(uint32_t index);
+    // Work out the bounds of a sprite after its animation or orientation
+    // changes.
+
+    void cull(
+      Eigen::Vector2f view_min,
+      Eigen::Vector2f view_max,
+      const float* x,
+      const float* y,
+      size_t begin,
+      size_t end
+    ) const;
+    // Set m_visible for sprites [begin, end), with their positions taken
+    // from the given arrays.
+
+    void interpolate(float alpha, size_t begin, size_t end) const;
+    // Fill in the m_draw arrays for sprites [begin, end).
+
+    std::vector<SpriteHandle> sorted_hits(std::vector<uint32_t>& indices) const;
+    // Turn dense indices into handles, in the order draw() puts them on
+    // screen.
+
+    void update_range(size_t begin, size_t end, float dt);
+    // Update sprites [begin, end).
+
+    int acquire_animation(std::shared_ptr<Animation> animation);
+    void release_animation(int id);
+    // Reference count animations by id. -1 means no animation.
+
+    std::vector<uint32_t> m_slot_dense;
+    std::vector<uint32_t> m_slot_generation;
+    std::vector<uint32_t> m_free_slots;
+    // Handles index slots, and each slot says where the sprite currently is
+    // in the arrays below. Destroying a sprite moves the last one into its
+    // place, so the arrays never have holes.
+
+    std::vector<uint32_t> m_dense_slot;
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_orientation;
+    std::vector<float> m_time_accumulated;
+    std::vector<int32_t> m_frame;
+    std::vector<int32_t> m_animation;
+    std::vector<uint8_t> m_animating;
+    std::vector<float> m_start_time;
+    // The sprites.
+
+    std::vector<float> m_previous_x;
+    std::vector<float> m_previous_y;
+    std::vector<float> m_previous_orientation;
+    // The state as of the last save_state(), for interpolating.
+
+    uint32_t m_cpu_count;
+    // Sprites animated on the CPU come first in the arrays, and the ones
+    // animated on the GPU come after. The GPU ones only use the start time
+    // and, once stopped, the frame.
+
+    std::vector<float> m_half_width;
+    std::vector<float> m_half_height;
+    std::vector<float> m_extent_x;
+    std::vector<float> m_extent_y;
+    // Half the size of each sprite's frame, and the half size of its axis
+    // aligned bounds once rotated, for culling. These are 0 for sprites
+    // with no animation.
+
+    std::vector<float> m_period;
+    std::vector<int32_t> m_frame_count;
+    std::vector<float> m_rate;
+    // Copies of each sprite's animation period and frame count, and 1 or 0
+    // depending on whether the sprite is animating, so that update() never
+    // has to look at the animation or branch. Sprites with no animation have
+    // a rate of 0.
+
+    std::vector<std::shared_ptr<Animation>> m_animations;
+    std::vector<int> m_animation_users;
+    std::vector<int> m_free_animations;
+    std::unordered_map<Animation*, int> m_animation_ids;
+    // The animations in use, by id.
+
+    SpatialGrid m_grid;
+    mutable std::vector<uint32_t> m_candidates;
+    // Sprites by where they are, keyed by slot so that moving sprites around
+    // in the arrays doesn't disturb it.
+
+    mutable std::vector<uint8_t> m_visible;
+    mutable std::vector<AnimationInstance> m_instances;
+    mutable std::vector<float> m_draw_x;
+    mutable std::vector<float> m_draw_y;
+    mutable std::vector<float> m_draw_orientation;
+    // Scratch space for draw().
+  };
+
+  //***************************************************************************
+  // Something that looks like a Sprite, but is really a sprite in a
+  // SpriteWorld. Views are cheap to make and copy. There's no update() or
+  // draw() - do those in bulk on the world.
+  class SpriteView {
+  public:
+
+    SpriteView(SpriteWorld& world, SpriteHandle sprite);
+
+    SpriteHandle handle() const;
+
+    void stop_animating();
+    void set_animation(std::shared_ptr<Animation> animation);
+    Eigen::Vector2f position() const;
+    void set_position(Eigen::Vector2f position);
+    float orientation() const;
+    void set_orientation(float orientation);
+    bool contains(Eigen::Vector2f point) const;
+    void randomise_frame();
+    void set_frame(int frame);
+    void animate_on_gpu();
+    // See Sprite.
+
+  private:
+    SpriteWorld* m_world;
+    SpriteHandle m_sprite;
+  };
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+/**
+ * Shadow copy of the OpenGL binding state, so that binding something which
+ * is already bound never reaches the driver.
+ */
+
+#include <GL/glew.h>
+
+#include <map>
+#include <vector>
+
+#include <utils/NonCopyable.hpp>
+
+namespace graphics {
+
+  /**
+   * Tracks the current program, vertex array, framebuffer, buffer bindings
+   * and per-unit texture bindings. Everything that binds OpenGL objects should go
+   * through here; if something binds behind its back then call invalidate().
+   *
+   * Objects must tell the cache when they are deleted, since OpenGL is free
+   * to hand the same name out again.
+   */
+  class StateCache : public NonCopyable {
+  public:
+    StateCache();
+
+    void use_program(GLuint id);
+    void bind_vertex_array(GLuint id);
+    void bind_buffer(GLenum target, GLuint id);
+    void bind_texture(GLenum target, GLuint id, int unit = 0);
+    void bind_framebuffer(GLuint id);
+
+    void forget_program(GLuint id);
+    void forget_vertex_array(GLuint id);
+    void forget_buffer(GLuint id);
+    void forget_texture(GLuint id);
+    void forget_framebuffer(GLuint id);
+
+    /**
+     * Forget everything. The next bind of each kind will always go to GL.
+     */
+    void invalidate();
+
+    /**
+     * Start counting afresh. The counts so far become the last frame's.
+     */
+    void end_frame();
+
+    int skipped_binds() const;
+    int issued_binds() const;
+    int skipped_binds_last_frame() const;
+    int issued_binds_last_frame() const;
+
+  private:
+    bool skip(bool redundant);
+
+    static const GLuint UNKNOWN = ~GLuint(0);
+
+    GLuint m_program;
+    GLuint m_vertex_array;
+    GLuint m_framebuffer;
+    std::map<GLenum, GLuint> m_buffers;
+    int m_active_unit;
+    std::vector<std::map<GLenum, GLuint>> m_textures;
+
+    int m_skipped;
+    int m_issued;
+    int m_skipped_last_frame;
+    int m_issued_last_frame;
+  };
+
+}
@@ -4,19 +4,30 @@
 // e.g.
 //
 //   Texture texture(TextureTarget::TEXTURE_2D, "data/textures/lucy.png");
+//   Texture mask(TextureTarget::TEXTURE_2D, "data/textures/mask.png",
+//                TextureFormat::R8);
+//   Texture sheet(TextureTarget::TEXTURE_2D, "data/textures/lucy.dds");
 
 #pragma once
 
 #include <GL/glew.h>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <filesystem/Path.hpp>
 
 #include <graphics/GraphicsObject.hpp>
+#include <graphics/TextureFormat.hpp>
+
+#include <jobs/JobSystem.hpp>
 
 #include <Eigen/Dense>
 
 namespace graphics {
+
+  class Image;
+  class CompressedImage;
   
   //***************************************************************************
   // Type safe alternative to GLenum.
@@ -37,6 +48,18 @@ namespace graphics {
   inline GLenum get_gl_enum(TextureTarget t) { return static_cast<GLenum>(t); }
   // Convert a TextureTarget to a GLenum for passing to OpenGL functions.
 
+  //***************************************************************************
+  // Where a texture's mip levels come from. Without them, sprites drawn
+  // smaller than they are sample texels all over the place, which aliases
+  // and is hard on the texture cache.
+  enum class Mipmaps {
+    NONE, // Just the one level.
+    CPU,  // Made with Image::half_size() before uploading. Works for the
+          // compressed formats too.
+    GPU   // Made by glGenerateMipmap after uploading. Compressed formats are
+          // done on the CPU instead.
+  };
+
   //***************************************************************************
   // Class for initialising and managing an OpenGL texture. Knows how to read
   // texture data from files.
@@ -46,28 +69,218 @@ namespace graphics {
     Texture(
       GraphicsSystem& tok, 
       TextureTarget bind_to, 
-      filesystem::Path filename
+      filesystem::Path filename,
+      TextureFormat format = TextureFormat::RGBA8,
+      Mipmaps mipmaps = Mipmaps::NONE
     );
     // Construct an OpenGL texture object and read data from the given file
     // into it. Takes a texture target because OpenGL is mad balls and requires
     // one for loading data into a texture.
+    //
+    // DDS and KTX files are loaded as they are, with their own mip levels,
+    // whatever the format says. Anything else is decoded and then stored in
+    // the given format, with the given mip levels - see below.
+    //
+    // Textures loaded from files are reloadable: the TextureResidency can
+    // drop them from the GPU, and they are read back in when next needed.
     // 
     // If anything bad happens, a std::runtime_error is thrown.
     //
     // There are probably situations where feeding garbage to this function 
     // will just cause OpenGL to do something arbitrary - so don't.
+
+    Texture(
+      GraphicsSystem& tok,
+      TextureTarget bind_to,
+      const Image& image,
+      TextureFormat format = TextureFormat::RGBA8,
+      Mipmaps mipmaps = Mipmaps::NONE
+    );
+    // As above but taking an image that has already been loaded. The pixels
+    // are packed down to the format before uploading. BC1 and BC3 are
+    // compressed on the spot, which is slow - compress at bake time instead.
+    // There's no BC7 encoder.
+
+    Texture(
+      GraphicsSystem& tok,
+      TextureTarget bind_to,
+      const CompressedImage& image
+    );
+    // As above but taking a compressed image, with all of its mip levels. If
+    // the GPU can't do BC1 or BC3, they are decompressed to RGBA8 instead,
+    // and format() says so; BC7 throws.
+
+    Texture(
+      GraphicsSystem& tok,
+      TextureTarget bind_to,
+      TextureFormat format,
+      Eigen::Vector2i size,
+      const std::vector<const void*>& levels
+    );
+    // As above but taking pixels that are already laid out in the given
+    // format, one pointer per mip level - e.g. straight out of a mapped
+    // SpriteBundle. They are handed to OpenGL as they are, without being
+    // copied or converted. Throws a std::runtime_error if the GPU can't do
+    // the format.
+
+    Texture(
+      GraphicsSystem& tok,
+      TextureTarget bind_to,
+      Eigen::Vector2i size,
+      TextureFormat format = TextureFormat::RGBA8
+    );
+    // Construct a texture of the given size without filling it in. Its
+    // contents are undefined until written with sub_image(). The format
+    // can't be a compressed one.
+
+    static bool supported(TextureFormat format);
+    // Can the GPU store textures in the given format?
     
-    void bind(TextureTarget to);
-    // Bind this texture to the given target.
+    void bind(TextureTarget to, int unit = 0);
+    // Bind this texture to the given target of the given texture unit. This
+    // only binds; an evicted texture binds a single transparent texel until
+    // TextureResidency has brought it back.
+
+    void sub_image(
+      Eigen::Vector2i min, 
+      Eigen::Vector2i size, 
+      const void* pixels
+    );
+    // Write RGBA8 pixels into a rectangle of the texture. If a pixel unpack
+    // buffer is bound then 'pixels' is an offset into it. OpenGL converts
+    // them to the texture's format, which mustn't be a compressed one.
+    // Don't use this on a reloadable texture; a reload would lose it.
+
+    void generate_mipmaps();
+    // Have OpenGL fill in a full set of mip levels from the first, e.g.
+    // after writing to it with sub_image(). Not for compressed formats.
     
     Eigen::Vector2i size() const;
-    // Get the size of the texture.
+    // Get the size of the texture. This doesn't change when levels are
+    // dropped, since it's what texture coordinates are worked out from.
+
+    TextureFormat format() const;
+    size_t byte_size() const;
+    // Get the format, and roughly how much GPU memory the texture takes up.
+
+    int level_count() const;
+    // Get the number of mip levels on the GPU.
+
+    //----- Residency. See TextureResidency.
+
+    bool reloadable() const;
+    // Was the texture loaded from a file, so that it can be reloaded?
+
+    bool resident() const;
+    // Is the texture on the GPU at all?
+
+    bool loading() const;
+    int loading_levels() const;
+    // Is a reload under way, and how many levels will it have dropped?
+
+    std::string load_error() const;
+    // Why the last reload failed, if one did. A texture whose reload fails
+    // stops being reloadable and keeps what it had, which for an evicted
+    // texture is the transparent texel.
+
+    int dropped_levels() const;
+    // Get how many of the top mip levels have been dropped. 0 is full
+    // detail; each one halves the width and height on the GPU.
+
+    unsigned last_used() const;
+    // Get the TextureResidency frame the texture was last bound in.
+
+    void evict();
+    // Free the texture's GPU memory, leaving a single transparent texel in
+    // its place, and abandon any reload under way. Must be reloadable.
+
+    void reload();
+    void drop_level();
+    void restore();
+    // Start reloading the texture: as it was, without its current top level
+    // (it must then have more than one), or at full detail if it isn't
+    // already. The file is read and decoded on the job system, and the
+    // texture carries on as it is until finish_load() uploads the result.
+    // Nothing happens if a reload is already under way.
+
+    bool finish_load();
+    // Upload a reload that has finished decoding, if there is one, and
+    // return whether there was. Call this between frames; TextureResidency
+    // does so at the end of every frame.
     
     ~Texture();
     // Dtor. Frees the underlying OpenGL texture.
 
   private:
+    friend class Framebuffer;
+    // Attaches the texture by its ID.
+
+    Texture(GraphicsSystem& tok, TextureTarget bind_to, TextureFormat format);
+    // Set up the members; the other constructors then fill it in.
+
+    void load(int dropped_levels);
+    // Load from m_source, there and then.
+
+    void start_load(int dropped_levels);
+    // Start decoding m_source on the job system.
+
+    void make_placeholder();
+    // Replace the texture with a single transparent texel.
+
+    void initialise(
+      TextureTarget bind_to, 
+      Eigen::Vector2i size, 
+      TextureFormat format,
+      const unsigned char* data
+    );
+    void initialise(
+      TextureTarget bind_to,
+      const Image& image,
+      TextureFormat format,
+      Mipmaps mipmaps,
+      int dropped_levels
+    );
+    void initialise(
+      TextureTarget bind_to, 
+      const CompressedImage& image, 
+      int dropped_levels
+    );
+    void create(TextureTarget bind_to, TextureFormat format);
+    void release();
+    void set_parameters(int level_count);
+    static void require_support(TextureFormat format);
+    // Throw a std::runtime_error if the GPU can't do the format.
+    void upload_image(int level, const Image& image);
+    void upload_level(int level, Eigen::Vector2i size, const void* data);
+    // Upload a level of pixels already laid out in m_format.
+
     GLuint m_id;
+    TextureTarget m_target;
     Eigen::Vector2i m_size;
+    TextureFormat m_format;
+    size_t m_byte_size;
+    int m_level_count;
+
+    std::string m_source;
+    TextureFormat m_source_format;
+    Mipmaps m_mipmaps;
+    int m_dropped_levels;
+    unsigned m_last_used;
+    bool m_resident;
+
+    struct PendingLoad;
+    std::shared_ptr<PendingLoad> m_pending;
+    jobs::JobCounter m_load_job;
+    std::string m_load_error;
+    // A reload being decoded on the job system. The job shares the pending
+    // load, so it has somewhere to put the result whatever happens here.
+  };
+
+  //***************************************************************************
+  // A rectangle of pixels within a texture, e.g. one image in an atlas.
+  struct TextureRegion {
+    std::shared_ptr<Texture> texture;
+    Eigen::Vector2i min;
+    Eigen::Vector2i size;
   };
 }
@@ -0,0 +1,132 @@
+//*****************************************************************************
+// Packing lots of sprite sheets into a few big textures.
+//
+// e.g.
+//
+//   AtlasBuilder builder(Vector2i(2048, 2048));
+//   int lucy = builder.add(Image(Path("data/textures/lucy.png")),
+//                          Vector2i(64, 64), 8);
+//   builder.pack();
+//
+//   TextureAtlas atlas(graphics, builder);
+//   Animation animation(graphics, atlas.region(lucy), Vector2i(64, 64), 8, 100);
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <graphics/GraphicsObject.hpp>
+#include <graphics/Image.hpp>
+#include <graphics/Texture.hpp>
+
+namespace graphics {
+
+  //***************************************************************************
+  // Packs rectangles into a fixed size area using the skyline bottom-left
+  // heuristic. Each rectangle is placed as low (nearest y = 0) as it can go,
+  // then as far left as it can go.
+  class SkylinePacker {
+  public:
+
+    explicit SkylinePacker(Eigen::Vector2i size);
+    // Constructor. The area starts off empty.
+
+    bool insert(Eigen::Vector2i size, Eigen::Vector2i& position);
+    // Find a place for a rectangle of the given size. Returns false if
+    // there isn't room, otherwise sets position to its min corner.
+
+    Eigen::Vector2i used() const;
+    // Get the size of the smallest rectangle at (0, 0) that contains
+    // everything inserted so far.
+
+  private:
+
+    struct Segment {
+      int x;
+      int y;
+      int width;
+    };
+    // A horizontal piece of the skyline. Everything below y is taken.
+
+    bool fits(size_t index, Eigen::Vector2i size, int& y) const;
+    // Can a rectangle go with its left edge at the start of the given
+    // segment? If so, y is set to the height it would sit at.
+
+    Eigen::Vector2i m_size;
+    Eigen::Vector2i m_used;
+    std::vector<Segment> m_skyline;
+  };
+
+  //***************************************************************************
+  // Collects sprite sheets and packs them into pages. This all happens in
+  // main memory; make a TextureAtlas from it to get textures.
+  class AtlasBuilder {
+  public:
+
+    explicit AtlasBuilder(Eigen::Vector2i page_size, int padding = 1);
+    // Constructor. Pages are at most page_size. The padding is the number of
+    // empty pixels left between sheets so that filtering doesn't bleed.
+
+    int add(const Image& sheet, Eigen::Vector2i frame_size, int frame_count);
+    // Add a sprite sheet, laid out as described for Animation. Only the part
+    // of the sheet actually covered by frames is kept. Returns an id for
+    // looking up where the sheet ended up.
+    //
+    // Throws a std::runtime_error if the frames don't fit in the sheet.
+
+    void pack();
+    // Pack everything added so far into pages. Larger sheets are placed
+    // first. Throws a std::runtime_error if a sheet is bigger than a page.
+
+    const std::vector<Image>& pages() const;
+    // Get the packed pages. Only valid after pack().
+
+    int count() const;
+    // Get the number of sheets added. Ids run from 0 to count() - 1.
+
+    int page(int id) const;
+    Eigen::Vector2i min(int id) const;
+    Eigen::Vector2i size(int id) const;
+    // Get the page and the rectangle within it where a sheet ended up. Only
+    // valid after pack().
+
+  private:
+
+    struct Entry {
+      Image pixels;
+      int page;
+      Eigen::Vector2i min;
+    };
+
+    Eigen::Vector2i m_page_size;
+    int m_padding;
+    std::vector<Entry> m_entries;
+    std::vector<Image> m_pages;
+  };
+
+  //***************************************************************************
+  // The textures for a packed atlas.
+  class TextureAtlas : public GraphicsObject {
+  public:
+
+    TextureAtlas(GraphicsSystem& gtok, const AtlasBuilder& builder);
+    // Upload the builder's pages. It must have been packed. Throws a
+    // std::runtime_error if the pages are too big for OpenGL.
+
+    TextureRegion region(int id) const;
+    // Get where a sheet ended up, by the id that AtlasBuilder::add gave it.
+
+    int page_count() const;
+    std::shared_ptr<Texture> page(int index) const;
+    // Get the page textures.
+
+  private:
+
+    std::vector<std::shared_ptr<Texture>> m_pages;
+    std::vector<TextureRegion> m_regions;
+  };
+
+}
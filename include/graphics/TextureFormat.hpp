@@ -0,0 +1,50 @@
+//*****************************************************************************
+// The ways texture pixels can be stored on the GPU.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace graphics {
+
+  //***************************************************************************
+  // Sized texture formats. The uncompressed ones are uploaded from RGBA8
+  // pixels, which are packed down on the way. The block compressed ones
+  // store 4x4 blocks of pixels in a fixed number of bytes.
+  enum class TextureFormat {
+    RGBA8,   // 32 bits per pixel.
+    RGBA4,   // 16 bits per pixel, 4 per channel.
+    RGB5_A1, // 16 bits per pixel, 1 bit alpha.
+    R8,      // 8 bits per pixel, just the red channel - for masks.
+    BC1,     // 4 bits per pixel, 1 bit alpha. AKA DXT1.
+    BC3,     // 8 bits per pixel, smooth alpha. AKA DXT5.
+    BC7      // 8 bits per pixel, high quality. AKA BPTC.
+  };
+
+  //***************************************************************************
+  bool is_compressed(TextureFormat format);
+  // Is the format block compressed?
+
+  //***************************************************************************
+  size_t texture_byte_size(TextureFormat format, Eigen::Vector2i size);
+  // Get the number of bytes an image of the given size takes up in the given
+  // format. Compressed formats are rounded up to whole blocks.
+
+  //***************************************************************************
+  std::vector<unsigned char> pack_pixels(
+    TextureFormat format,
+    Eigen::Vector2i size,
+    const unsigned char* rgba
+  );
+  // Pack RGBA8 pixels down to an uncompressed format, rounding to nearest.
+  // RGBA4 and RGB5_A1 are native-endian 16 bit values with red in the top
+  // bits; R8 keeps just the red channel.
+
+  //***************************************************************************
+  const char* texture_format_name(TextureFormat format);
+  // Get the name of a format, for messages.
+
+}
@@ -0,0 +1,158 @@
+//*****************************************************************************
+// Loading textures in the background.
+//
+// e.g.
+//
+//   TextureLoader loader(graphics);
+//   TextureHandle lucy = loader.load(Path("data/textures/lucy.png"));
+//
+//   while (!window.should_close()) {
+//     loader.update();
+//     lucy.texture()->bind(TextureTarget::TEXTURE_2D); // Placeholder for now
+//     ...
+//   }
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <filesystem/Path.hpp>
+
+#include <graphics/GraphicsObject.hpp>
+#include <graphics/BufferObjects.hpp>
+#include <graphics/Image.hpp>
+#include <graphics/Texture.hpp>
+
+#include <jobs/JobSystem.hpp>
+
+namespace graphics {
+
+  class TextureLoader;
+
+  //***************************************************************************
+  // A texture that may not have finished loading yet. Handles are cheap to
+  // copy; copies refer to the same texture.
+  class TextureHandle {
+  public:
+
+    TextureHandle();
+    // Ctor. A handle that refers to nothing and never becomes ready.
+
+    bool ready() const;
+    // Has the texture been completely uploaded?
+
+    bool failed() const;
+    std::string error() const;
+    // Did loading fail, and if so why? A handle that failed never becomes
+    // ready.
+
+    std::shared_ptr<Texture> texture() const;
+    // Get the texture if it is ready, or the loader's placeholder otherwise.
+
+    Eigen::Vector2i size() const;
+    // Get the size of the real texture. This is known once the image has
+    // been decoded, before it is ready; until then it is (0, 0).
+
+  private:
+    friend class TextureLoader;
+
+    enum class State { DECODING, DECODED, UPLOADING, READY, FAILED };
+
+    struct Request {
+      filesystem::Path path;
+      State state;
+      std::string error;
+      std::unique_ptr<Image> image;
+      std::shared_ptr<Texture> texture;
+      std::shared_ptr<Texture> placeholder;
+      int rows_uploaded;
+      int upload_failures;
+      mutable std::mutex mutex;
+
+      explicit Request(filesystem::Path path)
+        : path(path), state(State::DECODING), rows_uploaded(0),
+          upload_failures(0) {}
+    };
+    // Everything about one load. The state, error, image and size are
+    // written by the decoding threads, so look at them with the mutex held.
+
+    explicit TextureHandle(std::shared_ptr<Request> request);
+    std::shared_ptr<Request> m_request;
+  };
+
+  //***************************************************************************
+  // Decodes images on worker threads and uploads them on the GL
+  // thread through a pixel buffer object. No more than a fixed number of
+  // bytes are uploaded per update(), so a big texture is spread over
+  // several frames rather than stalling one.
+  class TextureLoader : public GraphicsObject {
+  public:
+
+    static const int UPLOAD_ATTEMPTS = 3;
+    // How many times in a row the pixel buffer may fail to map before a
+    // texture is given up on as failed.
+
+    TextureLoader(
+      GraphicsSystem& gtok,
+      int thread_count = 2,
+      size_t upload_bytes_per_update = 4 * 1024 * 1024
+    );
+    // Constructor. Starts the decoding threads, or with a thread count of 0
+    // decodes on the GraphicsSystem's job system instead. The placeholder
+    // texture handed out while textures load is a single transparent pixel.
+
+    TextureHandle load(filesystem::Path path);
+    // Start loading a texture. Returns straight away.
+
+    void update();
+    // Upload some decoded image data. Call this once per frame on the thread
+    // that owns the GL context.
+
+    bool idle() const;
+    // Is there nothing left to decode or upload?
+
+    ~TextureLoader();
+    // Dtor. Abandons anything not yet decoded and waits for the threads.
+
+  private:
+
+    typedef std::shared_ptr<TextureHandle::Request> RequestPtr;
+
+    void decode_loop();
+    // What each of our own worker threads runs.
+
+    void decode(const RequestPtr& request);
+    // Decode one image and queue it for upload. m_decoding must already
+    // count it.
+
+    bool upload_some(const RequestPtr& request, size_t& budget);
+    // Upload as many rows of the request as the budget allows. Returns true
+    // once the request is finished with, uploaded or failed.
+
+    size_t m_upload_bytes_per_update;
+
+    std::shared_ptr<Texture> m_placeholder;
+    VertexBufferObject m_pixel_buffer;
+    // Used on the GL thread only.
+
+    std::deque<RequestPtr> m_to_decode;
+    std::deque<RequestPtr> m_to_upload;
+    int m_decoding;
+    bool m_stopping;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<std::thread> m_threads;
+    // Shared with the worker threads; guarded by m_mutex.
+
+    jobs::JobSystem* m_jobs;
+    jobs::JobCounter m_decode_jobs;
+    // The job system decoding is done on, if not our own threads.
+  };
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * Keeps texture memory within a budget by dropping textures that haven't
+ * been used for a while, and bringing them back when they are.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include <utils/NonCopyable.hpp>
+
+namespace graphics {
+
+  class Texture;
+
+  /**
+   * Tracks every Texture and how many bytes it holds. At the end of each
+   * frame, if the total is over budget, the least recently bound reloadable
+   * textures are shrunk: first by dropping their top mip level, which saves
+   * three quarters of their memory, and then, if that isn't enough, by
+   * evicting them altogether. Textures bound during the frame are left
+   * alone. An evicted texture binds as a single transparent texel; if it's
+   * bound anyway, it's reloaded.
+   *
+   * When there's room again, textures that were shrunk but are still being
+   * used are restored to full detail, one per frame to spread the cost.
+   *
+   * Dropping a level and reloading both read and decode the file on the job
+   * system; the result is uploaded at the end of a later frame, and until
+   * then the texture carries on as it was. The budget counts a texture
+   * that's being reloaded at the size it's going to be.
+   *
+   * Only textures loaded from files can be reloaded; the rest still count
+   * towards the total but are never touched.
+   */
+  class TextureResidency : public NonCopyable {
+  public:
+    TextureResidency();
+
+    /**
+     * The budget in bytes. 0, the default, means no limit.
+     */
+    void set_budget(size_t bytes);
+    size_t budget() const;
+
+    /**
+     * Get the bytes currently on the GPU, over all textures.
+     */
+    size_t resident_bytes() const;
+
+    /**
+     * Upload finished reloads, enforce the budget and start a new frame.
+     * Call this on the GL thread, between frames.
+     */
+    void end_frame();
+
+    /**
+     * The current frame, for Texture to stamp itself with when bound.
+     */
+    unsigned frame() const;
+
+    /**
+     * Statistics: how many times a level was dropped, a texture evicted or
+     * a texture restored to full detail.
+     */
+    int drops() const;
+    int evictions() const;
+    int restores() const;
+
+    /**
+     * Called by Texture as textures come and go.
+     */
+    void add(Texture* texture);
+    void remove(Texture* texture);
+
+  private:
+    static size_t expected_bytes(const Texture& texture);
+    void shrink(size_t& total);
+    void grow(size_t total);
+
+    std::vector<Texture*> m_textures;
+    std::vector<Texture*> m_candidates;
+    size_t m_budget;
+    unsigned m_frame;
+    int m_drops;
+    int m_evictions;
+    int m_restores;
+  };
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+/**
+ * A work-stealing job scheduler.
+ *
+ * e.g.
+ *
+ *   jobs::JobSystem jobs;
+ *   jobs.parallel_for(0, positions.size(), 1024, [&](size_t b, size_t e) {
+ *     for (size_t i = b; i < e; ++i) positions[i] += velocities[i] * dt;
+ *   });
+ *
+ * Nothing here knows about OpenGL, and jobs must not make GL calls - those
+ * stay on the thread that owns the context.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <utils/NonCopyable.hpp>
+
+namespace jobs {
+
+  /**
+   * Counts jobs that haven't finished yet. Pass one to JobSystem::submit()
+   * and then JobSystem::wait() on it. If any of the jobs throws, the first
+   * exception is kept here for wait() to rethrow.
+   */
+  class JobCounter : public NonCopyable {
+  public:
+    JobCounter() : m_count(0) {}
+    bool done() const { return m_count.load() == 0; }
+  private:
+    friend class JobSystem;
+    std::atomic<int> m_count;
+    std::mutex m_mutex;
+    std::exception_ptr m_exception;
+  };
+
+  /**
+   * Runs jobs on a pool of worker threads. Each worker has its own deque of
+   * jobs: it pushes and pops at the back, so it works on the most recently
+   * submitted (and most likely cached) job, while idle workers steal from
+   * the front of other workers' deques. Jobs submitted from outside the
+   * pool go on a shared deque that everyone steals from.
+   *
+   * Waiting for a counter runs jobs rather than blocking, so jobs may
+   * submit more jobs and wait for them.
+   */
+  class JobSystem : public NonCopyable {
+  public:
+
+    /**
+     * Start the given number of worker threads. By default one fewer than
+     * the number of hardware threads, leaving one for the thread that owns
+     * the GL context (which also runs jobs while it waits).
+     */
+    explicit JobSystem(int thread_count = -1);
+
+    /**
+     * Get the number of worker threads.
+     */
+    int thread_count() const;
+
+    /**
+     * Queue a job to run. The counter is incremented now and decremented
+     * when the job has finished; it must outlive the job.
+     */
+    void submit(std::function<void()> job, JobCounter& counter);
+
+    /**
+     * Run jobs until the counter reaches zero. If any of its jobs threw,
+     * the first exception is then rethrown (and cleared, so the counter
+     * can be used again). The other jobs still run to the end.
+     */
+    void wait(JobCounter& counter);
+
+    /**
+     * Split [begin, end) into pieces of at most 'grain' items, run body on
+     * each piece (possibly in parallel) and wait for them all to finish.
+     * Rethrows the first exception thrown by the body, as wait() does.
+     */
+    void parallel_for(
+      size_t begin,
+      size_t end,
+      size_t grain,
+      const std::function<void(size_t, size_t)>& body
+    );
+
+    /**
+     * Stop the workers. Jobs that haven't started are dropped.
+     */
+    ~JobSystem();
+
+  private:
+
+    struct Job {
+      std::function<void()> run;
+      JobCounter* counter;
+    };
+
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Job> jobs;
+    };
+
+    void worker_loop(int index);
+    int current_queue() const;
+    bool pop(int index, Job& job);
+    bool steal(int thief, Job& job);
+    bool find_job(Job& job);
+    void run(Job& job);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    // Queue 0 is shared by threads outside the pool; queue i + 1 belongs to
+    // worker i.
+
+    std::vector<std::thread> m_threads;
+    std::atomic<int> m_pending;
+    std::atomic<bool> m_stopping;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake;
+  };
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/**
+ * Distributions of timings, for percentiles rather than averages.
+ *
+ * e.g.
+ *
+ *   profiling::Histogram frame_times;
+ *   frame_times.add(16.9);
+ *   ...
+ *   std::cout << "p99 " << frame_times.percentile(0.99) << "ms" << std::endl;
+ */
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace profiling {
+
+  /**
+   * Counts millisecond timings into fixed width buckets. Adding is constant
+   * time and nothing is allocated after construction, so it can be fed every
+   * frame forever. Percentiles are accurate to a bucket; anything past the
+   * last bucket is lumped into it, though max() is always exact.
+   */
+  class Histogram {
+  public:
+
+    explicit Histogram(double bucket_ms = 0.1, size_t bucket_count = 1000);
+
+    void add(double ms);
+
+    /**
+     * Forget everything added so far.
+     */
+    void clear();
+
+    size_t count() const;
+    double mean() const;
+    double max() const;
+
+    /**
+     * Get the time that the given fraction of timings were no longer than,
+     * e.g. 0.5 for the median or 0.99 for the 99th percentile. This is the
+     * top of the bucket it falls in, or max() if that's less. 0 if empty.
+     */
+    double percentile(double fraction) const;
+
+    /**
+     * Print the count, mean, p50, p99 and max on one line.
+     */
+    void print(std::ostream& out) const;
+
+  private:
+    double m_bucket_ms;
+    std::vector<size_t> m_buckets;
+    size_t m_count;
+    double m_total;
+    double m_max;
+  };
+
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+/**
+ * A frame profiler: named scopes timed on the CPU (and, via
+ * graphics::GpuProfiler, on the GPU), summed up per frame and kept over a
+ * rolling window, and optionally captured to a Chrome trace.
+ *
+ * e.g.
+ *
+ *   void Thing::update()
+ *   {
+ *     profiling::Scope scope(profiler, "Thing::update");
+ *     ...
+ *   }
+ *
+ *   // Once a frame.
+ *   profiler.end_frame();
+ *
+ *   profiling::ScopeSummary summary;
+ *   if (profiler.summary("Thing::update", summary)) {
+ *     std::cout << summary.average_ms << "ms" << std::endl;
+ *   }
+ *
+ * Load chrome://tracing (or https://ui.perfetto.dev) and open the file
+ * written by write_trace() to see a capture.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <filesystem/Path.hpp>
+#include <utils/NonCopyable.hpp>
+
+namespace profiling {
+
+  /**
+   * How long a scope took per frame, over the last Profiler::WINDOW frames.
+   */
+  struct ScopeSummary {
+    std::string name;
+    double average_ms;   // Mean time per frame.
+    double max_ms;       // Worst frame.
+    double last_ms;      // The most recent frame.
+    double calls;        // Mean calls per frame.
+  };
+
+  /**
+   * Collects timings. Scopes can be recorded from any thread - e.g. from
+   * jobs - but end_frame() and the trace functions belong to one thread.
+   */
+  class Profiler : public NonCopyable {
+  public:
+
+    static const int WINDOW = 120;
+
+    /**
+     * The track GPU timings go on in traces.
+     */
+    static const int GPU_TRACK = -1;
+
+    Profiler();
+
+    /**
+     * Turn recording on or off. It's on by default; when off, scopes don't
+     * even read the clock.
+     */
+    void set_enabled(bool enabled);
+    bool enabled() const;
+
+    /**
+     * Microseconds since the profiler was made.
+     */
+    double now() const;
+
+    /**
+     * Record a timing, in microseconds. The track is GPU_TRACK for GPU
+     * timings and -2 (the default) for the calling thread. Only the name
+     * pointer is kept, so it must live as long as the profiler; string
+     * literals are ideal.
+     */
+    void record(
+      const char* name, 
+      double start_us, 
+      double duration_us, 
+      int track = -2
+    );
+
+    /**
+     * Fold this frame's timings into the summaries, and into the trace if
+     * one is being captured, and start a new frame.
+     */
+    void end_frame();
+
+    /**
+     * Get the summary for one scope, or for everything seen in the window,
+     * most expensive first. 
+     */
+    bool summary(const std::string& name, ScopeSummary& summary) const;
+    std::vector<ScopeSummary> summary() const;
+
+    /**
+     * Print the summaries as a table.
+     */
+    void print_summary(std::ostream& out) const;
+
+    /**
+     * Capture every timing from now on, up to a limit on the number of
+     * events, for writing out as a Chrome trace. Starting again throws away
+     * the previous capture.
+     */
+    void start_trace(size_t max_events = 1000000);
+    void stop_trace();
+    bool tracing() const;
+
+    /**
+     * Write the capture as Chrome trace event JSON. Throws a
+     * std::runtime_error if it can't be written.
+     */
+    void write_trace(const filesystem::Path& path) const;
+
+  private:
+
+    struct Event {
+      const char* name;
+      double start;
+      double duration;
+      int track;
+    };
+
+    struct Scope {
+      std::vector<double> frame_ms;
+      std::vector<int> frame_calls;
+      double current_ms;
+      int current_calls;
+    };
+
+    int track();
+    ScopeSummary summarise(const std::string& name, const Scope& scope) const;
+
+    std::atomic<bool> m_enabled;
+    std::chrono::steady_clock::time_point m_epoch;
+
+    std::mutex m_mutex;
+    std::vector<Event> m_events;
+    std::map<std::thread::id, int> m_tracks;
+
+    std::map<std::string, Scope> m_scopes;
+    int m_frame;
+
+    bool m_tracing;
+    size_t m_max_events;
+    std::vector<Event> m_trace;
+  };
+
+  /**
+   * Times itself from construction to destruction.
+   */
+  class Scope : public NonCopyable {
+  public:
+    Scope(Profiler& profiler, const char* name)
+      : m_profiler(profiler.enabled() ? &profiler : nullptr),
+        m_name(name),
+        m_start(m_profiler ? profiler.now() : 0)
+    {
+    }
+
+    ~Scope()
+    {
+      if (m_profiler) {
+        m_profiler->record(m_name, m_start, m_profiler->now() - m_start);
+      }
+    }
+
+  private:
+    Profiler* m_profiler;
+    const char* m_name;
+    double m_start;
+  };
+
+  /**
+   * Write a string as a quoted JSON string, escaping quotes, backslashes
+   * and control characters - as used for traces.
+   */
+  void write_json_string(std::ostream& out, const char* s);
+  void write_json_string(std::ostream& out, const std::string& s);
+
+}
@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include "filesystem/FileData.hpp"
+#include "filesystem/FileSystem.hpp"
+
+using namespace filesystem;
+
+const size_t FileData::MAP_THRESHOLD;
+
+FileData::FileData(const Path& path, Mode mode)
+  : m_data(nullptr),
+    m_size(0)
+{
+  load(path, mode);
+}
+
+FileData::FileData(const FileSystem& files, const Path& path, Mode mode)
+  : m_data(nullptr),
+    m_size(0)
+{
+  FileSystem::Location location = files.locate(path);
+  if (location.pack) {
+    m_pack = location.pack;
+    m_data = location.data;
+    m_size = location.size;
+    return;
+  }
+  load(Path(location.path), mode);
+}
+
+void FileData::load(const Path& path, Mode mode)
+{
+  const std::string& name = path.path();
+
+  if (mode == Mode::AUTO) {
+    struct stat info;
+    if (stat(name.c_str(), &info) != 0) {
+      throw std::runtime_error("Can't read " + name);
+    }
+    mode = size_t(info.st_size) >= MAP_THRESHOLD ? Mode::MAP : Mode::READ;
+  }
+
+  if (mode == Mode::MAP) {
+    m_mapping.reset(new MappedFile(path));
+    m_data = m_mapping->data();
+    m_size = m_mapping->size();
+    return;
+  }
+
+  // Size the buffer up front so the whole file comes in with one read.
+  std::FILE* file = std::fopen(name.c_str(), "rb");
+  if (!file) throw std::runtime_error("Can't read " + name);
+
+  long size = -1;
+  if (std::fseek(file, 0, SEEK_END) == 0) size = std::ftell(file);
+  if (size < 0 || std::fseek(file, 0, SEEK_SET) != 0) {
+    std::fclose(file);
+    throw std::runtime_error("Can't get the size of " + name);
+  }
+
+  m_buffer.resize(size_t(size));
+  size_t read = size > 0 ? std::fread(&m_buffer[0], 1, m_buffer.size(), file) : 0;
+  std::fclose(file);
+  if (read != m_buffer.size()) {
+    throw std::runtime_error("Failed to read " + name);
+  }
+
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+}
+
+const unsigned char* FileData::data() const
+{
+  return m_data;
+}
+
+size_t FileData::size() const
+{
+  return m_size;
+}
+
+const char* FileData::chars() const
+{
+  return reinterpret_cast<const char*>(m_data);
+}
+
+std::string FileData::string() const
+{
+  return std::string(chars(), m_size);
+}
@@ -0,0 +1,59 @@
+#include <sys/stat.h>
+
+#include "filesystem/FileSystem.hpp"
+
+using namespace filesystem;
+
+static bool is_file(const std::string& path)
+{
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFREG;
+}
+
+FileSystem::FileSystem()
+{
+}
+
+void FileSystem::mount(const Path& pack)
+{
+  m_packs.push_back(std::make_shared<PackFile>(pack));
+}
+
+void FileSystem::mount_directory(const Path& directory)
+{
+  std::string name = pack_name(directory.path());
+  if (!name.empty() && name.back() != '/') name += '/';
+  m_directories.push_back(name);
+}
+
+FileSystem::Location FileSystem::locate(const Path& path) const
+{
+  Location ret;
+  ret.data = nullptr;
+  ret.size = 0;
+
+  std::string name = pack_name(path.path());
+  for (auto it = m_directories.rbegin(); it != m_directories.rend(); ++it) {
+    std::string loose = *it + name;
+    if (is_file(loose)) {
+      ret.path = loose;
+      return ret;
+    }
+  }
+
+  for (auto it = m_packs.rbegin(); it != m_packs.rend(); ++it) {
+    if ((*it)->find(name, ret.data, ret.size)) {
+      ret.pack = *it;
+      return ret;
+    }
+  }
+
+  ret.path = path.path();
+  return ret;
+}
+
+bool FileSystem::exists(const Path& path) const
+{
+  Location location = locate(path);
+  return location.pack || is_file(location.path);
+}
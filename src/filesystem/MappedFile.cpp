@@ -0,0 +1,104 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "filesystem/MappedFile.hpp"
+
+using namespace filesystem;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(Path path)
+  : m_data(nullptr),
+    m_size(0),
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr)
+{
+  m_file = CreateFileA(
+    path.path().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+  );
+  if (m_file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Failed to open " + path.path());
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size)) {
+    CloseHandle(m_file);
+    throw std::runtime_error("Failed to get the size of " + path.path());
+  }
+  m_size = static_cast<size_t>(size.QuadPart);
+  if (m_size == 0) return;
+
+  m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  void* view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (!view) {
+    if (m_mapping) CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    throw std::runtime_error("Failed to map " + path.path());
+  }
+  m_data = static_cast<const unsigned char*>(view);
+}
+
+MappedFile::~MappedFile()
+{
+  if (m_data) UnmapViewOfFile(m_data);
+  if (m_mapping) CloseHandle(m_mapping);
+  CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(Path path)
+  : m_data(nullptr),
+    m_size(0)
+{
+  int fd = open(path.path().c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + path.path());
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("Failed to get the size of " + path.path());
+  }
+  m_size = static_cast<size_t>(info.st_size);
+
+  if (m_size > 0) {
+    void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Failed to map " + path.path());
+    }
+    m_data = static_cast<const unsigned char*>(view);
+  }
+
+  // The mapping keeps the file alive by itself.
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (m_data) munmap(const_cast<unsigned char*>(m_data), m_size);
+}
+
+#endif
+
+const unsigned char* MappedFile::data() const
+{
+  return m_data;
+}
+
+size_t MappedFile::size() const
+{
+  return m_size;
+}
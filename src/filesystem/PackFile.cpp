@@ -0,0 +1,256 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "filesystem/FileData.hpp"
+#include "filesystem/PackFile.hpp"
+
+using namespace filesystem;
+
+namespace {
+
+  const char MAGIC[4] = { 'P', 'A', 'C', 'K' };
+  const uint32_t VERSION = 1;
+  const size_t ALIGNMENT = 64;
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t slot_count;
+    uint64_t entries_offset;
+    uint64_t slots_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t file_size;
+  };
+
+  struct Entry {
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t name_offset;
+    uint32_t name_length;
+  };
+
+  static_assert(sizeof(Header) == 56, "Header must be tightly packed");
+  static_assert(sizeof(Entry) == 32, "Entry must be tightly packed");
+
+  size_t align(size_t offset, size_t alignment)
+  {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  const Entry* entry(const unsigned char* entries, size_t index)
+  {
+    return reinterpret_cast<const Entry*>(entries) + index;
+  }
+
+}
+
+//----- Names
+
+uint64_t filesystem::pack_hash(const std::string& name)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : name) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::string filesystem::pack_name(const std::string& name)
+{
+  std::string ret;
+  ret.reserve(name.size());
+  for (char c : name) {
+    if (c == '\\') c = '/';
+    if (c == '/' && !ret.empty() && ret.back() == '/') continue;
+    ret.push_back(c);
+    if (ret == "./") ret.clear();
+  }
+  return ret;
+}
+
+//----- PackFile
+
+PackFile::PackFile(const Path& path)
+  : m_file(path)
+{
+  // Check everything once here, so that find() can trust the index.
+  std::string error = path.path() + " is not a valid pack";
+  const unsigned char* base = m_file.data();
+  size_t size = m_file.size();
+
+  Header header;
+  if (size < sizeof(header)) throw std::runtime_error(error);
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION ||
+      header.file_size != size ||
+      header.slot_count == 0 ||
+      (header.slot_count & (header.slot_count - 1)) != 0 ||
+      header.slot_count <= header.entry_count ||
+      header.entries_offset % 8 != 0 ||
+      header.slots_offset % 4 != 0) {
+    throw std::runtime_error(error);
+  }
+
+  auto in_file = [&](uint64_t offset, uint64_t length) {
+    return offset <= size && length <= size - offset;
+  };
+  if (!in_file(header.entries_offset, uint64_t(header.entry_count) * sizeof(Entry)) ||
+      !in_file(header.slots_offset, uint64_t(header.slot_count) * sizeof(uint32_t)) ||
+      !in_file(header.names_offset, header.names_size)) {
+    throw std::runtime_error(error);
+  }
+
+  m_entry_count = header.entry_count;
+  m_slot_count = header.slot_count;
+  m_entries = base + header.entries_offset;
+  m_slots = base + header.slots_offset;
+  m_names = reinterpret_cast<const char*>(base + header.names_offset);
+
+  for (uint32_t i = 0; i < m_entry_count; ++i) {
+    const Entry* e = entry(m_entries, i);
+    if (!in_file(e->offset, e->size) ||
+        e->name_offset > header.names_size ||
+        e->name_length > header.names_size - e->name_offset) {
+      throw std::runtime_error(error);
+    }
+  }
+  // Every entry must be in the table exactly once, and there must be an
+  // empty slot for failed lookups to stop at.
+  const uint32_t* slots = reinterpret_cast<const uint32_t*>(m_slots);
+  std::vector<bool> seen(m_entry_count + 1, false);
+  bool empty_slot = false;
+  for (uint32_t i = 0; i < m_slot_count; ++i) {
+    uint32_t index = slots[i];
+    if (index > m_entry_count) throw std::runtime_error(error);
+    if (index == 0) {
+      empty_slot = true;
+      continue;
+    }
+    if (seen[index]) throw std::runtime_error(error);
+    seen[index] = true;
+  }
+  if (!empty_slot) throw std::runtime_error(error);
+  for (uint32_t i = 1; i <= m_entry_count; ++i) {
+    if (!seen[i]) throw std::runtime_error(error);
+  }
+}
+
+bool PackFile::find(
+  const std::string& name,
+  const unsigned char*& data,
+  size_t& size
+) const
+{
+  // Slots hold entry index + 1, with 0 meaning empty. The constructor made
+  // sure there's an empty slot, but the probe is bounded all the same.
+  const uint32_t* slots = reinterpret_cast<const uint32_t*>(m_slots);
+  uint64_t hash = pack_hash(name);
+  uint32_t mask = m_slot_count - 1;
+  uint32_t slot = uint32_t(hash) & mask;
+  for (uint32_t probes = 0; probes < m_slot_count && slots[slot];
+       ++probes, slot = (slot + 1) & mask) {
+    const Entry* e = entry(m_entries, slots[slot] - 1);
+    if (e->hash != hash || e->name_length != name.size()) continue;
+    if (std::memcmp(m_names + e->name_offset, name.data(), name.size()) != 0) continue;
+    data = m_file.data() + e->offset;
+    size = size_t(e->size);
+    return true;
+  }
+  return false;
+}
+
+size_t PackFile::file_count() const
+{
+  return m_entry_count;
+}
+
+std::string PackFile::file_name(size_t index) const
+{
+  const Entry* e = entry(m_entries, index);
+  return std::string(m_names + e->name_offset, e->name_length);
+}
+
+//----- PackWriter
+
+void PackWriter::add(const std::string& name, std::vector<unsigned char> contents)
+{
+  File file = { pack_name(name), std::move(contents) };
+  for (const File& existing : m_files) {
+    if (existing.name == file.name) {
+      throw std::runtime_error(file.name + " is already in the pack");
+    }
+  }
+  m_files.push_back(std::move(file));
+}
+
+void PackWriter::add_file(const Path& path)
+{
+  FileData data(path, FileData::Mode::READ);
+  add(path.path(), std::vector<unsigned char>(data.data(), data.data() + data.size()));
+}
+
+void PackWriter::save(const Path& path) const
+{
+  // At most half full, so probes stay short.
+  uint32_t slot_count = 1;
+  while (slot_count < 2 * m_files.size() + 1) slot_count *= 2;
+
+  std::string names;
+  for (const File& file : m_files) names += file.name;
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.entry_count = uint32_t(m_files.size());
+  header.slot_count = slot_count;
+  header.entries_offset = sizeof(Header);
+  header.slots_offset = header.entries_offset + m_files.size() * sizeof(Entry);
+  header.names_offset = header.slots_offset + slot_count * sizeof(uint32_t);
+  header.names_size = names.size();
+
+  std::vector<Entry> entries(m_files.size());
+  std::vector<uint32_t> slots(slot_count, 0);
+  size_t offset = align(header.names_offset + names.size(), ALIGNMENT);
+  uint32_t name_offset = 0;
+  for (size_t i = 0; i < m_files.size(); ++i) {
+    Entry& e = entries[i];
+    e.hash = pack_hash(m_files[i].name);
+    e.offset = offset;
+    e.size = m_files[i].contents.size();
+    e.name_offset = name_offset;
+    e.name_length = uint32_t(m_files[i].name.size());
+    offset = align(offset + e.size, ALIGNMENT);
+    name_offset += e.name_length;
+
+    uint32_t slot = uint32_t(e.hash) & (slot_count - 1);
+    while (slots[slot]) slot = (slot + 1) & (slot_count - 1);
+    slots[slot] = uint32_t(i + 1);
+  }
+  header.file_size = offset;
+
+  std::vector<unsigned char> out(offset, 0);
+  std::memcpy(&out[0], &header, sizeof(header));
+  if (!entries.empty()) {
+    std::memcpy(&out[header.entries_offset], entries.data(),
+                entries.size() * sizeof(Entry));
+  }
+  std::memcpy(&out[header.slots_offset], slots.data(), slots.size() * sizeof(uint32_t));
+  if (!names.empty()) {
+    std::memcpy(&out[header.names_offset], names.data(), names.size());
+  }
+  for (size_t i = 0; i < m_files.size(); ++i) {
+    if (m_files[i].contents.empty()) continue;
+    std::memcpy(&out[entries[i].offset], m_files[i].contents.data(),
+                m_files[i].contents.size());
+  }
+
+  std::ofstream ofs(path.path().c_str(), std::ios::out | std::ios::binary);
+  ofs.write(reinterpret_cast<const char*>(out.data()), out.size());
+  if (!ofs) throw std::runtime_error("Failed to write " + path.path());
+}
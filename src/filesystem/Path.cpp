@@ -7,7 +7,7 @@ Path::Path(std::string path)
 {
 }
 
-std::string Path::path() const
+const std::string& Path::path() const
 {
   return m_path;
 }
@@ -1,4 +1,5 @@
 
+#include <assert.h>
 #include <stdexcept>
 #include <GLFW/glfw3.h>
 #include <glfwutils/glfw_utils.hpp>
@@ -18,8 +19,9 @@ GLFWToken::GLFWToken()
     if (!glfwInit()) { 
       throw std::runtime_error("Failed to initialise glfw.");
     } else {
+      // 3.3 for instanced vertex attributes (glVertexAttribDivisor).
       glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
       glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
       //glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     }
@@ -34,15 +36,133 @@ GLFWToken::~GLFWToken()
 }
 
 
+//----- GLFWEventQueue
+
+//*****************************************************************************
+GLFWEventQueue::GLFWEventQueue(size_t capacity)
+  : m_events(capacity > 0 ? capacity : 1),
+    m_first(0),
+    m_count(0),
+    m_dropped(0)
+{
+}
+
+//*****************************************************************************
+void GLFWEventQueue::push(const GLFWEvent& event)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (m_count > 0) {
+    GLFWEvent& last = m_events[(m_first + m_count - 1) % m_events.size()];
+    if (last.type == event.type) {
+      switch (event.type) {
+        case GLFWEvent::Type::MOUSE_MOVED:
+          last = event;
+          return;
+        case GLFWEvent::Type::MOUSE_SCROLLED:
+          last.time = event.time;
+          last.x += event.x;
+          last.y += event.y;
+          return;
+        default:
+          break;
+      }
+    }
+  }
+
+  if (m_count == m_events.size()) {
+    m_first = (m_first + 1) % m_events.size();
+    --m_count;
+    ++m_dropped;
+  }
+  m_events[(m_first + m_count) % m_events.size()] = event;
+  ++m_count;
+}
+
+//*****************************************************************************
+void GLFWEventQueue::drain(std::vector<GLFWEvent>& events)
+{
+  events.clear();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  events.reserve(m_count);
+  for (size_t i = 0; i < m_count; ++i) {
+    events.push_back(m_events[(m_first + i) % m_events.size()]);
+  }
+  m_first = 0;
+  m_count = 0;
+}
+
+//*****************************************************************************
+size_t GLFWEventQueue::dropped() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_dropped;
+}
+
+//*****************************************************************************
+void GLFWEventQueue::dispatch(
+  const GLFWEvent& event,
+  GLFWEventListener& listener
+)
+{
+  typedef GLFWEvent::Type Type;
+  switch (event.type) {
+    case Type::KEY_DOWN: 
+      return listener.on_key_down(event.code, event.scancode, event.mods);
+    case Type::KEY_UP: 
+      return listener.on_key_up(event.code, event.scancode, event.mods);
+    case Type::KEY_HELD: 
+      return listener.on_key_held(event.code, event.scancode, event.mods);
+    case Type::CHAR_INPUT: 
+      return listener.on_char_input(static_cast<unsigned int>(event.code));
+    case Type::MOUSE_BUTTON_DOWN: 
+      return listener.on_mouse_button_down(event.code, event.mods);
+    case Type::MOUSE_BUTTON_UP: 
+      return listener.on_mouse_button_up(event.code, event.mods);
+    case Type::MOUSE_MOVED: 
+      return listener.on_mouse_moved(Vector2d(event.x, event.y));
+    case Type::MOUSE_ENTERED_WINDOW: 
+      return listener.on_mouse_entered_window();
+    case Type::MOUSE_LEFT_WINDOW: 
+      return listener.on_mouse_left_window();
+    case Type::MOUSE_SCROLLED: 
+      return listener.on_mouse_scrolled(Vector2d(event.x, event.y));
+  }
+}
+
+
 //----- GLFWWindow
 
 //*****************************************************************************
-std::vector<GLFWEventListener*>& GLFWWindow::get_listeners(GLFWwindow* ptr)
+GLFWEventQueue& GLFWWindow::get_events(GLFWwindow* ptr)
 {
   auto ret = reinterpret_cast<GLFWWindow*>(glfwGetWindowUserPointer(ptr));
   assert(ret);
 
-  return ret->m_listeners;
+  return ret->m_events;
+}
+
+//*****************************************************************************
+void GLFWWindow::push(
+  GLFWwindow* window,
+  GLFWEvent::Type type,
+  int code,
+  int scancode,
+  int mods,
+  double x,
+  double y
+)
+{
+  GLFWEvent event;
+  event.type = type;
+  event.time = glfwGetTime();
+  event.code = code;
+  event.scancode = scancode;
+  event.mods = mods;
+  event.x = x;
+  event.y = y;
+  get_events(window).push(event);
 }
 
 //*****************************************************************************
@@ -54,21 +174,20 @@ void GLFWWindow::key_callback(
   int mods
 )
 {
-  for (auto listener : get_listeners(window)) {
-    switch (action) {
-      case GLFW_PRESS:   return listener->on_key_down(key, scancode, mods);
-      case GLFW_RELEASE: return listener->on_key_up(key, scancode, mods);
-      case GLFW_REPEAT:  return listener->on_key_held(key, scancode, mods);
-    }
+  switch (action) {
+    case GLFW_PRESS:   
+      return push(window, GLFWEvent::Type::KEY_DOWN, key, scancode, mods);
+    case GLFW_RELEASE: 
+      return push(window, GLFWEvent::Type::KEY_UP, key, scancode, mods);
+    case GLFW_REPEAT:  
+      return push(window, GLFWEvent::Type::KEY_HELD, key, scancode, mods);
   }
 }
 
 //*****************************************************************************
 void GLFWWindow::char_callback(GLFWwindow* window, unsigned int utf_32_char)
 {
-  for (auto listener : get_listeners(window)) {
-    listener->on_char_input(utf_32_char);
-  }
+  push(window, GLFWEvent::Type::CHAR_INPUT, static_cast<int>(utf_32_char));
 }
 
 //*****************************************************************************
@@ -79,37 +198,31 @@ void GLFWWindow::mouse_button_callback(
   int mods
 )
 {
-  for (auto listener : get_listeners(window)) {
-    switch (action) {
-      case GLFW_PRESS: return listener->on_mouse_button_down(button, mods);
-      case GLFW_RELEASE: return listener->on_mouse_button_up(button, mods);
-    }
+  switch (action) {
+    case GLFW_PRESS: 
+      return push(window, GLFWEvent::Type::MOUSE_BUTTON_DOWN, button, 0, mods);
+    case GLFW_RELEASE: 
+      return push(window, GLFWEvent::Type::MOUSE_BUTTON_UP, button, 0, mods);
   }
 }
 
 //*****************************************************************************
 void GLFWWindow::cursor_pos_callback(GLFWwindow* window, double x, double y)
 {
-  for (auto listener : get_listeners(window)) {
-    listener->on_mouse_moved(Vector2d(x, y));
-  }
+  push(window, GLFWEvent::Type::MOUSE_MOVED, 0, 0, 0, x, y);
 }
 
 //*****************************************************************************
 void GLFWWindow::cursor_enter_callback(GLFWwindow* window, int entered)
 {
-  for (auto listener : get_listeners(window)) {
-    if (entered) listener->on_mouse_entered_window();
-    else         listener->on_mouse_left_window();
-  }
+  push(window, entered ? GLFWEvent::Type::MOUSE_ENTERED_WINDOW
+                       : GLFWEvent::Type::MOUSE_LEFT_WINDOW);
 }
 
 //*****************************************************************************
 void GLFWWindow::cursor_scroll_callback(GLFWwindow* window, double x, double y)
 {
-  for (auto listener : get_listeners(window)) {
-    listener->on_mouse_scrolled(Vector2d(x, y));
-  }
+  push(window, GLFWEvent::Type::MOUSE_SCROLLED, 0, 0, 0, x, y);
 }
 
 //*****************************************************************************
@@ -164,12 +277,43 @@ void GLFWWindow::swap_buffers()
   glfwSwapBuffers(m_window); 
 }
 
+//*****************************************************************************
+void GLFWWindow::set_swap_interval(int interval)
+{
+  glfwSwapInterval(interval);
+}
+
 //*****************************************************************************
 void GLFWWindow::add_event_listener(GLFWEventListener& listener)
 {
   m_listeners.push_back(&listener);
 }
 
+//*****************************************************************************
+GLFWEventQueue& GLFWWindow::events()
+{
+  return m_events;
+}
+
+//*****************************************************************************
+void GLFWWindow::dispatch_events()
+{
+  if (m_listeners.empty()) return;
+  m_events.drain(m_dispatching);
+  for (const GLFWEvent& event : m_dispatching) {
+    for (auto listener : m_listeners) {
+      GLFWEventQueue::dispatch(event, *listener);
+    }
+  }
+}
+
+//*****************************************************************************
+void GLFWWindow::poll_events()
+{
+  glfwPollEvents();
+  dispatch_events();
+}
+
 //*****************************************************************************
 GLFWWindow::~GLFWWindow() 
 { 
@@ -1,6 +1,8 @@
 #include <assert.h>
+#include <cstring>
 
 #include <graphics/BufferObjects.hpp>
+#include <graphics/GraphicsSystem.hpp>
 
 using namespace graphics;
 
@@ -18,15 +20,56 @@ VertexBufferObject::VertexBufferObject(
 
 void VertexBufferObject::bind()
 {
-  glBindBuffer(get_gl_enum(m_target), m_id);
+  graphics_system().state().bind_buffer(get_gl_enum(m_target), m_id);
 }
 
-void VertexBufferObject::fill(size_t size, void* data)
+void VertexBufferObject::unbind()
 {
+  // Matters for pixel buffers: while one is bound, pointers passed to the
+  // texture functions are treated as offsets into it.
+  graphics_system().state().bind_buffer(get_gl_enum(m_target), 0);
+}
+
+void VertexBufferObject::fill(size_t size, const void* data)
+{
+  profiling::Scope scope(graphics_system().profiler(), "Buffer::fill");
   bind();
   glBufferData(get_gl_enum(m_target), size, data, get_gl_enum(m_usage));
 }
 
+void VertexBufferObject::fill_range(
+  size_t offset, 
+  size_t size, 
+  const void* data
+)
+{
+  profiling::Scope scope(graphics_system().profiler(), "Buffer::fill");
+  bind();
+  glBufferSubData(get_gl_enum(m_target), offset, size, data);
+}
+
+void VertexBufferObject::allocate(size_t size)
+{
+  // Also orphans any previous storage, so this never waits on the GPU.
+  fill(size, nullptr);
+}
+
+void* VertexBufferObject::map_range(
+  size_t offset, 
+  size_t size, 
+  GLbitfield access
+)
+{
+  bind();
+  return glMapBufferRange(get_gl_enum(m_target), offset, size, access);
+}
+
+bool VertexBufferObject::unmap()
+{
+  bind();
+  return glUnmapBuffer(get_gl_enum(m_target)) == GL_TRUE;
+}
+
 BufferTarget VertexBufferObject::target() const
 {
   return m_target;
@@ -39,9 +82,118 @@ BufferUsage VertexBufferObject::usage() const
 
 VertexBufferObject::~VertexBufferObject()
 {
+  graphics_system().state().forget_buffer(m_id);
   glDeleteBuffers(1, &m_id);
 }
 
+StreamingBuffer::StreamingBuffer(
+  GraphicsSystem& tok,
+  BufferTarget target,
+  size_t segment_size,
+  int segment_count
+)
+  : GraphicsObject(tok),
+    m_buffer(tok, target, BufferUsage::STREAM_DRAW),
+    m_segment_size(segment_size),
+    m_fences(segment_count > 0 ? segment_count : 1, nullptr),
+    m_segment(0),
+    m_offset(0)
+{
+  m_buffer.allocate(m_segment_size * m_fences.size());
+  tok.add_streaming_buffer(this);
+}
+
+size_t StreamingBuffer::write(const void* data, size_t size, size_t alignment)
+{
+  size_t offset;
+  void* mapped = map(size, offset, alignment);
+  if (mapped) std::memcpy(mapped, data, size);
+  if (!mapped || !unmap()) m_buffer.fill_range(offset, size, data);
+  return offset;
+}
+
+void* StreamingBuffer::map(size_t size, size_t& offset, size_t alignment)
+{
+  offset = reserve(size, alignment);
+  return m_buffer.map_range(
+    offset, 
+    size, 
+    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+  );
+}
+
+bool StreamingBuffer::unmap()
+{
+  return m_buffer.unmap();
+}
+
+size_t StreamingBuffer::reserve(size_t size, size_t alignment)
+{
+  size_t start = (m_offset + alignment - 1) / alignment * alignment;
+  if (start + size > m_segment_size) {
+    // Out of room. Orphaning the old storage means nothing needs waiting
+    // for; the driver keeps it alive until the GPU is done with it.
+    while (m_segment_size < size) m_segment_size *= 2;
+    m_segment_size *= 2;
+    m_buffer.allocate(m_segment_size * m_fences.size());
+    for (GLsync& fence : m_fences) {
+      if (fence) glDeleteSync(fence);
+      fence = nullptr;
+    }
+    m_segment = 0;
+    start = 0;
+  }
+
+  m_offset = start + size;
+  return m_segment * m_segment_size + start;
+}
+
+void StreamingBuffer::end_frame()
+{
+  // A segment nothing was written to this frame can simply carry on.
+  if (m_offset == 0) return;
+  if (m_fences[m_segment]) glDeleteSync(m_fences[m_segment]);
+  m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  m_segment = (m_segment + 1) % m_fences.size();
+  begin_segment();
+}
+
+void StreamingBuffer::begin_segment()
+{
+  GLsync& fence = m_fences[m_segment];
+  if (fence) {
+    wait(fence);
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  m_offset = 0;
+}
+
+void StreamingBuffer::wait(GLsync fence)
+{
+  // Only flush on the first go; after that the fence is on its way.
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  for (;;) {
+    GLenum result = glClientWaitSync(fence, flags, 1000000000);
+    if (result != GL_TIMEOUT_EXPIRED) return;
+    flags = 0;
+  }
+}
+
+VertexBufferObject& StreamingBuffer::buffer()
+{
+  return m_buffer;
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+  graphics_system().remove_streaming_buffer(this);
+  for (GLsync fence : m_fences) {
+    if (fence) glDeleteSync(fence);
+  }
+}
+
 VertexArrayObject::VertexArrayObject(GraphicsSystem& tok)
   : GraphicsObject(tok)
 {
@@ -50,7 +202,7 @@ VertexArrayObject::VertexArrayObject(GraphicsSystem& tok)
 
 void VertexArrayObject::bind()
 {
-  glBindVertexArray(m_id);
+  graphics_system().state().bind_vertex_array(m_id);
 }
 
 void VertexArrayObject::enable_attribute(AttributeIndex index)
@@ -71,7 +223,8 @@ void VertexArrayObject::attribute_pointer(
   ComponentCount component_count,
   DataType data_type,
   bool normalise,
-  size_t stride
+  size_t stride,
+  size_t offset
 )
 {
   assert(vbo.target() == BufferTarget::ARRAY_BUFFER);
@@ -85,11 +238,21 @@ void VertexArrayObject::attribute_pointer(
     get_gl_enum(data_type), 
     normalise,
     stride, 
-    nullptr
+    reinterpret_cast<const GLvoid*>(offset)
   );
 }
 
+void VertexArrayObject::attribute_divisor(
+  AttributeIndex index, 
+  unsigned int divisor
+)
+{
+  bind();
+  glVertexAttribDivisor(index.idx(), divisor);
+}
+
 VertexArrayObject::~VertexArrayObject()
 {
+  graphics_system().state().forget_vertex_array(m_id);
   glDeleteVertexArrays(1, &m_id);
 }
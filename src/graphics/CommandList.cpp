@@ -0,0 +1,340 @@
+#include <algorithm>
+
+#include <graphics/CommandList.hpp>
+#include <graphics/GraphicsSystem.hpp>
+#include <graphics/SpatialGrid.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+//----- CommandList
+
+//*****************************************************************************
+CommandList::CommandList()
+  : m_view_min(0, 0),
+    m_view_max(0, 0),
+    m_culled(0)
+{
+}
+
+//*****************************************************************************
+void CommandList::add(
+  Animation& animation,
+  int frame,
+  Vector2f position,
+  float orientation_radians
+)
+{
+  if (cull(animation, position, orientation_radians)) return;
+  add(animation, animation.instance(frame, position, orientation_radians));
+}
+
+//*****************************************************************************
+void CommandList::add_animated(
+  Animation& animation,
+  float start_time,
+  Vector2f position,
+  float orientation_radians
+)
+{
+  if (cull(animation, position, orientation_radians)) return;
+  add(
+    animation,
+    animation.animated_instance(start_time, position, orientation_radians)
+  );
+}
+
+//*****************************************************************************
+bool CommandList::cull(
+  const Animation& animation,
+  Vector2f position,
+  float orientation_radians
+)
+{
+  OrientedBox box(position, animation.size().cast<float>(), orientation_radians);
+  Vector2f min = box.min();
+  Vector2f max = box.max();
+  if (max[0] < m_view_min[0] || min[0] > m_view_max[0] ||
+      max[1] < m_view_min[1] || min[1] > m_view_max[1]) {
+    ++m_culled;
+    return true;
+  }
+  return false;
+}
+
+//*****************************************************************************
+void CommandList::add(Animation& animation, const AnimationInstance& instance)
+{
+  const Texture* texture = &animation.texture();
+  if (m_commands.empty() || m_commands.back().texture != texture) {
+    DrawCommand command;
+    command.animation = &animation;
+    command.texture = texture;
+    command.first = static_cast<uint32_t>(m_instances.size());
+    command.count = 0;
+    m_commands.push_back(command);
+  }
+  m_instances.push_back(instance);
+  ++m_commands.back().count;
+}
+
+//*****************************************************************************
+void CommandList::count_culled(int count)
+{
+  m_culled += count;
+}
+
+//*****************************************************************************
+void CommandList::set_view(Vector2f min, Vector2f max)
+{
+  m_view_min = min;
+  m_view_max = max;
+}
+
+//*****************************************************************************
+Vector2f CommandList::view_min() const
+{
+  return m_view_min;
+}
+
+//*****************************************************************************
+Vector2f CommandList::view_max() const
+{
+  return m_view_max;
+}
+
+//*****************************************************************************
+void CommandList::clear()
+{
+  m_commands.clear();
+  m_instances.clear();
+  m_culled = 0;
+}
+
+//*****************************************************************************
+size_t CommandList::size() const
+{
+  return m_instances.size();
+}
+
+//*****************************************************************************
+size_t CommandList::command_count() const
+{
+  return m_commands.size();
+}
+
+//*****************************************************************************
+int CommandList::culled() const
+{
+  return m_culled;
+}
+
+//----- CommandQueue
+
+//*****************************************************************************
+CommandQueue::CommandQueue(GraphicsSystem& gtok)
+  : GraphicsObject(gtok),
+    m_active(0),
+    m_instances(gtok, BufferTarget::ARRAY_BUFFER, 64 * 1024),
+    m_view_min(0, 0),
+    m_view_max(gtok.window_size().cast<float>()),
+    m_view_follows_target(true),
+    m_draw_calls(0),
+    m_drawn(0),
+    m_culled(0)
+{
+}
+
+//*****************************************************************************
+void CommandQueue::begin(size_t list_count)
+{
+  while (m_lists.size() < list_count) {
+    m_lists.push_back(std::unique_ptr<CommandList>(new CommandList()));
+  }
+  m_active = list_count;
+
+  // The target's size is looked up here, on the GL thread, so that the
+  // recording threads never need to ask the GraphicsSystem anything.
+  Vector2f view_max = this->view_max();
+  for (auto& list : m_lists) {
+    list->clear();
+    list->set_view(m_view_min, view_max);
+  }
+}
+
+//*****************************************************************************
+CommandList& CommandQueue::list(size_t index)
+{
+  return *m_lists.at(index);
+}
+
+//*****************************************************************************
+const CommandList& CommandQueue::list(size_t index) const
+{
+  return *m_lists.at(index);
+}
+
+//*****************************************************************************
+size_t CommandQueue::list_count() const
+{
+  return m_active;
+}
+
+//*****************************************************************************
+void CommandQueue::set_view(Vector2f min, Vector2f max)
+{
+  m_view_min = min;
+  m_view_max = max;
+  m_view_follows_target = false;
+}
+
+//*****************************************************************************
+Vector2f CommandQueue::view_min() const
+{
+  return m_view_min;
+}
+
+//*****************************************************************************
+Vector2f CommandQueue::view_max() const
+{
+  if (m_view_follows_target) return graphics_system().window_size().cast<float>();
+  return m_view_max;
+}
+
+//*****************************************************************************
+void CommandQueue::submit()
+//
+// Merging is a pass over the commands rather than the instances, so it costs
+// next to nothing; the instances themselves are only touched by the one copy
+// out of the lists, straight into the mapped instance buffer.
+//*****************************************************************************
+{
+  profiling::Scope scope(graphics_system().profiler(), "CommandQueue::submit");
+
+  m_draw_calls = 0;
+  m_drawn = 0;
+  m_culled = 0;
+  m_order.clear();
+
+  for (size_t i = 0; i < m_active; ++i) {
+    const CommandList& list = *m_lists[i];
+    m_culled += list.m_culled;
+    for (const DrawCommand& command : list.m_commands) {
+      auto it = m_group_indices.find(command.texture);
+      if (it == m_group_indices.end()) {
+        it = m_group_indices.insert(
+          std::make_pair(command.texture, m_groups.size())
+        ).first;
+        m_groups.push_back(Group());
+        m_groups.back().texture = command.texture;
+        m_groups.back().animation = nullptr;
+        m_groups.back().size = 0;
+      }
+
+      Group& group = m_groups[it->second];
+      if (group.runs.empty()) {
+        group.animation = command.animation;
+        m_order.push_back(it->second);
+      }
+      Run run;
+      run.instances = &list.m_instances[command.first];
+      run.count = command.count;
+      group.runs.push_back(run);
+      group.size += command.count;
+      m_drawn += command.count;
+    }
+  }
+
+  if (m_drawn > 0) {
+    // If the buffer can't be mapped, or the mapping was lost by the time it
+    // was unmapped, go through the staging vector instead.
+    size_t bytes = m_drawn * sizeof(AnimationInstance);
+    size_t offset;
+    void* mapped = m_instances.map(bytes, offset);
+    if (mapped) {
+      copy_groups(static_cast<AnimationInstance*>(mapped));
+    }
+    if (!mapped || !m_instances.unmap()) {
+      m_staging.resize(m_drawn);
+      copy_groups(m_staging.data());
+      m_instances.buffer().fill_range(offset, bytes, m_staging.data());
+    }
+
+    size_t first = 0;
+    for (size_t index : m_order) {
+      const Group& group = m_groups[index];
+      group.animation->draw_instances(
+        m_instances.buffer(),
+        offset + first * sizeof(AnimationInstance),
+        static_cast<int>(group.size)
+      );
+      first += group.size;
+      ++m_draw_calls;
+    }
+  }
+
+  // Groups are kept for the textures drawn this time, so their storage is
+  // reused next time; the rest are dropped so that they don't pile up as
+  // textures come and go. They're kept in the order they were drawn, which
+  // is usually the order they'll be seen in next time, so that the indices
+  // rarely need rebuilding.
+  bool reordered = m_order.size() != m_groups.size();
+  for (size_t i = 0; i < m_order.size() && !reordered; ++i) {
+    reordered = m_order[i] != i;
+  }
+  if (reordered) {
+    m_spare_groups.clear();
+    for (size_t index : m_order) {
+      m_spare_groups.push_back(std::move(m_groups[index]));
+    }
+    m_groups.swap(m_spare_groups);
+    m_spare_groups.clear();
+    m_group_indices.clear();
+    for (size_t i = 0; i < m_groups.size(); ++i) {
+      m_group_indices[m_groups[i].texture] = i;
+    }
+  }
+  for (Group& group : m_groups) {
+    group.runs.clear();
+    group.size = 0;
+  }
+
+  for (size_t i = 0; i < m_active; ++i) m_lists[i]->clear();
+}
+
+//*****************************************************************************
+void CommandQueue::copy_groups(AnimationInstance* out) const
+{
+  for (size_t index : m_order) {
+    for (const Run& run : m_groups[index].runs) {
+      out = std::copy(run.instances, run.instances + run.count, out);
+    }
+  }
+}
+
+//*****************************************************************************
+void CommandQueue::clear()
+{
+  for (auto& list : m_lists) list->clear();
+  m_groups.clear();
+  m_group_indices.clear();
+  m_order.clear();
+}
+
+//*****************************************************************************
+int CommandQueue::draw_calls() const
+{
+  return m_draw_calls;
+}
+
+//*****************************************************************************
+size_t CommandQueue::drawn() const
+{
+  return m_drawn;
+}
+
+//*****************************************************************************
+int CommandQueue::culled() const
+{
+  return m_culled;
+}
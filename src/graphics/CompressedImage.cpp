@@ -0,0 +1,676 @@
+/*****************************************************************************
+ * Implementation of CompressedImage, including a simple BC1/BC3 codec.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <filesystem/FileData.hpp>
+#include <filesystem/FileSystem.hpp>
+
+#include <graphics/CompressedImage.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+using namespace Eigen;
+
+//----- File format constants
+
+namespace {
+
+  // DDS
+  const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+  const uint32_t DDS_HEADER_SIZE = 124;
+  const uint32_t DDSD_CAPS = 0x1;
+  const uint32_t DDSD_HEIGHT = 0x2;
+  const uint32_t DDSD_WIDTH = 0x4;
+  const uint32_t DDSD_PIXELFORMAT = 0x1000;
+  const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+  const uint32_t DDSD_LINEARSIZE = 0x80000;
+  const uint32_t DDPF_FOURCC = 0x4;
+  const uint32_t DDSCAPS_COMPLEX = 0x8;
+  const uint32_t DDSCAPS_TEXTURE = 0x1000;
+  const uint32_t DDSCAPS_MIPMAP = 0x400000;
+  const uint32_t FOURCC_DXT1 = 0x31545844;
+  const uint32_t FOURCC_DXT5 = 0x35545844;
+  const uint32_t FOURCC_DX10 = 0x30315844;
+  const uint32_t DXGI_FORMAT_BC1_UNORM = 71;
+  const uint32_t DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+  const uint32_t DXGI_FORMAT_BC3_UNORM = 77;
+  const uint32_t DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+  const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+  const uint32_t DXGI_FORMAT_BC7_UNORM_SRGB = 99;
+  const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+  // KTX 1. The internal formats are OpenGL's, but spelled out so that this
+  // file doesn't need OpenGL.
+  const unsigned char KTX_IDENTIFIER[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+  };
+  const uint32_t KTX_ENDIANNESS = 0x04030201;
+  const uint32_t GL_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+  const uint32_t GL_COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1;
+  const uint32_t GL_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+  const uint32_t GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+  const uint32_t GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D;
+
+}
+
+//----- Helpers
+
+//*****************************************************************************
+template <typename Bytes>
+static uint32_t read_u32(const Bytes& bytes, size_t offset)
+{
+  if (offset + 4 > bytes.size()) throw std::runtime_error("Truncated file");
+  const unsigned char* data = bytes.data();
+  return uint32_t(data[offset]) |
+         uint32_t(data[offset + 1]) << 8 |
+         uint32_t(data[offset + 2]) << 16 |
+         uint32_t(data[offset + 3]) << 24;
+}
+
+//*****************************************************************************
+static void write_u32(std::vector<unsigned char>& data, size_t offset, uint32_t value)
+{
+  data[offset] = value & 0xff;
+  data[offset + 1] = (value >> 8) & 0xff;
+  data[offset + 2] = (value >> 16) & 0xff;
+  data[offset + 3] = (value >> 24) & 0xff;
+}
+
+//*****************************************************************************
+static int max_level_count(Vector2i size)
+{
+  // floor(log2(max(w, h))) + 1: the levels down to 1 x 1.
+  int largest = std::max(size[0], size[1]);
+  int count = 1;
+  while (largest > 1) {
+    largest >>= 1;
+    ++count;
+  }
+  return count;
+}
+
+//*****************************************************************************
+static Vector2i header_size(uint32_t width, uint32_t height)
+{
+  // Bigger than any GPU will take, and small enough to do sums on in an int.
+  const uint32_t limit = 1 << 16;
+  if (width == 0 || height == 0 || width > limit || height > limit) {
+    throw std::runtime_error("Bad image size");
+  }
+  return Vector2i(int(width), int(height));
+}
+
+//*****************************************************************************
+static int header_level_count(uint32_t count, Vector2i size)
+{
+  // Files without mipmaps may say 0 levels rather than 1.
+  if (count == 0) return 1;
+  if (count > uint32_t(max_level_count(size))) {
+    throw std::runtime_error("More mip levels than the image size allows");
+  }
+  return int(count);
+}
+
+//*****************************************************************************
+static int block_bytes(TextureFormat format)
+{
+  return format == TextureFormat::BC1 ? 8 : 16;
+}
+
+//*****************************************************************************
+static uint16_t pack_565(const int* rgb)
+{
+  return uint16_t(((rgb[0] * 31 + 127) / 255) << 11 |
+                  ((rgb[1] * 63 + 127) / 255) << 5 |
+                  ((rgb[2] * 31 + 127) / 255));
+}
+
+//*****************************************************************************
+static void unpack_565(uint16_t c, int* rgb)
+{
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+//*****************************************************************************
+static void colour_palette(uint16_t c0, uint16_t c1, bool four_colour, int palette[4][4])
+{
+  unpack_565(c0, palette[0]);
+  unpack_565(c1, palette[1]);
+  for (int i = 0; i < 3; ++i) {
+    if (four_colour) {
+      palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+      palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+    } else {
+      palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+      palette[3][i] = 0;
+    }
+  }
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  palette[3][3] = four_colour ? 255 : 0;
+}
+
+//*****************************************************************************
+static void encode_colour_block(
+  const unsigned char pixels[16][4],
+  bool allow_transparency,
+  unsigned char* out
+)
+//
+// Range fit: the endpoints are opposite corners of the block's colour
+// bounding box, pulled in a little, and each pixel takes the nearest palette
+// entry. Of the box's four diagonals, the one taken runs the way the colours
+// do, so that a channel which falls as another rises still fits. With
+// transparency allowed (BC1 only), any pixel under half alpha makes the
+// block use the three colour mode where index 3 is transparent.
+//*****************************************************************************
+{
+  bool transparent = false;
+  int lo[3] = { 255, 255, 255 };
+  int hi[3] = { 0, 0, 0 };
+  for (int p = 0; p < 16; ++p) {
+    if (allow_transparency && pixels[p][3] < 128) {
+      transparent = true;
+      continue;
+    }
+    for (int i = 0; i < 3; ++i) {
+      lo[i] = std::min<int>(lo[i], pixels[p][i]);
+      hi[i] = std::max<int>(hi[i], pixels[p][i]);
+    }
+  }
+  if (lo[0] > hi[0]) {
+    // Every pixel is transparent.
+    for (int i = 0; i < 3; ++i) lo[i] = hi[i] = 0;
+  }
+
+  // Measure the other channels against the one that varies most, and swap
+  // the ends of any that go against it.
+  int axis = 0;
+  for (int i = 1; i < 3; ++i) {
+    if (hi[i] - lo[i] > hi[axis] - lo[axis]) axis = i;
+  }
+  int covariance[3] = { 0, 0, 0 };
+  for (int p = 0; p < 16; ++p) {
+    if (allow_transparency && pixels[p][3] < 128) continue;
+    int a = 2 * pixels[p][axis] - lo[axis] - hi[axis];
+    for (int i = 0; i < 3; ++i) {
+      covariance[i] += a * (2 * pixels[p][i] - lo[i] - hi[i]);
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (covariance[i] < 0) std::swap(lo[i], hi[i]);
+  }
+  for (int i = 0; i < 3; ++i) {
+    int inset = (hi[i] - lo[i]) / 16;
+    lo[i] += inset;
+    hi[i] -= inset;
+  }
+
+  uint16_t c0 = pack_565(hi);
+  uint16_t c1 = pack_565(lo);
+  bool four_colour;
+  if (transparent) {
+    // The three colour mode is chosen by c0 <= c1.
+    if (c0 > c1) std::swap(c0, c1);
+    four_colour = false;
+  } else {
+    if (c0 < c1) std::swap(c0, c1);
+    // c0 == c1 would mean three colour mode, but then every pixel is just c0
+    // anyway.
+    four_colour = true;
+  }
+
+  int palette[4][4];
+  colour_palette(c0, c1, four_colour, palette);
+
+  uint32_t indices = 0;
+  for (int p = 0; p < 16; ++p) {
+    int best = 0;
+    if (transparent && pixels[p][3] < 128) {
+      best = 3;
+    } else {
+      int best_distance = 1 << 30;
+      int candidates = four_colour ? 4 : 3;
+      for (int c = 0; c < candidates; ++c) {
+        int distance = 0;
+        for (int i = 0; i < 3; ++i) {
+          int d = palette[c][i] - pixels[p][i];
+          distance += d * d;
+        }
+        if (distance < best_distance) {
+          best_distance = distance;
+          best = c;
+        }
+      }
+    }
+    indices |= uint32_t(best) << (2 * p);
+  }
+
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  for (int i = 0; i < 4; ++i) out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+//*****************************************************************************
+static void alpha_palette(int a0, int a1, int palette[8])
+{
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1) {
+    for (int i = 1; i < 7; ++i) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+  } else {
+    for (int i = 1; i < 5; ++i) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+//*****************************************************************************
+static void encode_alpha_block(const unsigned char pixels[16][4], unsigned char* out)
+{
+  int a0 = 0, a1 = 255;
+  for (int p = 0; p < 16; ++p) {
+    a0 = std::max<int>(a0, pixels[p][3]);
+    a1 = std::min<int>(a1, pixels[p][3]);
+  }
+
+  int palette[8];
+  alpha_palette(a0, a1, palette);
+
+  uint64_t indices = 0;
+  if (a0 != a1) {
+    for (int p = 0; p < 16; ++p) {
+      int best = 0;
+      int best_distance = 1 << 30;
+      for (int c = 0; c < 8; ++c) {
+        int distance = std::abs(palette[c] - pixels[p][3]);
+        if (distance < best_distance) {
+          best_distance = distance;
+          best = c;
+        }
+      }
+      indices |= uint64_t(best) << (3 * p);
+    }
+  }
+
+  out[0] = static_cast<unsigned char>(a0);
+  out[1] = static_cast<unsigned char>(a1);
+  for (int i = 0; i < 6; ++i) out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+//*****************************************************************************
+static void decode_colour_block(
+  const unsigned char* in,
+  bool force_four_colour,
+  unsigned char pixels[16][4]
+)
+{
+  uint16_t c0 = uint16_t(in[0] | in[1] << 8);
+  uint16_t c1 = uint16_t(in[2] | in[3] << 8);
+  int palette[4][4];
+  colour_palette(c0, c1, force_four_colour || c0 > c1, palette);
+
+  uint32_t indices = 0;
+  for (int i = 0; i < 4; ++i) indices |= uint32_t(in[4 + i]) << (8 * i);
+  for (int p = 0; p < 16; ++p) {
+    int index = (indices >> (2 * p)) & 3;
+    for (int i = 0; i < 4; ++i) pixels[p][i] = palette[index][i];
+  }
+}
+
+//*****************************************************************************
+static void decode_alpha_block(const unsigned char* in, unsigned char pixels[16][4])
+{
+  int palette[8];
+  alpha_palette(in[0], in[1], palette);
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; ++i) indices |= uint64_t(in[2 + i]) << (8 * i);
+  for (int p = 0; p < 16; ++p) {
+    pixels[p][3] = palette[(indices >> (3 * p)) & 7];
+  }
+}
+
+
+//----- CompressedImage
+
+//*****************************************************************************
+CompressedImage::CompressedImage(Path filename)
+{
+  FileData file(filename);
+  load(file, filename);
+}
+
+//*****************************************************************************
+CompressedImage::CompressedImage(const FileSystem& files, Path filename)
+{
+  FileData file(files, filename);
+  load(file, filename);
+}
+
+//*****************************************************************************
+void CompressedImage::load(const FileData& file, const Path& filename)
+{
+  try {
+    if (file.size() >= 4 && read_u32(file, 0) == DDS_MAGIC) {
+      load_dds(file);
+    } else if (file.size() >= sizeof(KTX_IDENTIFIER) &&
+               std::memcmp(file.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0) {
+      load_ktx(file);
+    } else {
+      throw std::runtime_error("Not a DDS or KTX file");
+    }
+    check_levels();
+  } catch (std::runtime_error& e) {
+    throw std::runtime_error(filename.path() + ": " + e.what());
+  }
+}
+
+//*****************************************************************************
+CompressedImage::CompressedImage(
+  TextureFormat format,
+  Vector2i size,
+  std::vector<std::vector<unsigned char>> levels
+)
+  : m_format(format),
+    m_size(size),
+    m_levels(std::move(levels))
+{
+  check_levels();
+}
+
+//*****************************************************************************
+void CompressedImage::load_dds(const FileData& file)
+{
+  if (read_u32(file, 4) != DDS_HEADER_SIZE) {
+    throw std::runtime_error("Bad DDS header");
+  }
+  m_size = header_size(read_u32(file, 16), read_u32(file, 12));
+  int level_count = header_level_count(read_u32(file, 28), m_size);
+
+  if (!(read_u32(file, 80) & DDPF_FOURCC)) {
+    throw std::runtime_error("Uncompressed DDS files aren't supported");
+  }
+
+  size_t offset = 4 + DDS_HEADER_SIZE;
+  uint32_t four_cc = read_u32(file, 84);
+  if (four_cc == FOURCC_DXT1) {
+    m_format = TextureFormat::BC1;
+  } else if (four_cc == FOURCC_DXT5) {
+    m_format = TextureFormat::BC3;
+  } else if (four_cc == FOURCC_DX10) {
+    switch (read_u32(file, offset)) {
+      case DXGI_FORMAT_BC1_UNORM:
+      case DXGI_FORMAT_BC1_UNORM_SRGB:
+        m_format = TextureFormat::BC1;
+        break;
+      case DXGI_FORMAT_BC3_UNORM:
+      case DXGI_FORMAT_BC3_UNORM_SRGB:
+        m_format = TextureFormat::BC3;
+        break;
+      case DXGI_FORMAT_BC7_UNORM:
+      case DXGI_FORMAT_BC7_UNORM_SRGB:
+        m_format = TextureFormat::BC7;
+        break;
+      default:
+        throw std::runtime_error("Unsupported DXGI format");
+    }
+    offset += 20;
+  } else {
+    throw std::runtime_error("Unsupported DDS format");
+  }
+
+  // The levels are stored one after the other with no padding.
+  m_levels.clear();
+  for (int i = 0; i < level_count; ++i) {
+    size_t bytes = texture_byte_size(m_format, level_size(i));
+    if (offset + bytes > file.size()) throw std::runtime_error("Truncated file");
+    m_levels.push_back(std::vector<unsigned char>(
+      file.data() + offset, file.data() + offset + bytes
+    ));
+    offset += bytes;
+  }
+}
+
+//*****************************************************************************
+void CompressedImage::load_ktx(const FileData& file)
+{
+  size_t offset = sizeof(KTX_IDENTIFIER);
+  if (read_u32(file, offset) != KTX_ENDIANNESS) {
+    throw std::runtime_error("Big endian KTX files aren't supported");
+  }
+
+  uint32_t internal_format = read_u32(file, offset + 16);
+  switch (internal_format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1:
+      m_format = TextureFormat::BC1;
+      break;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5:
+      m_format = TextureFormat::BC3;
+      break;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+      m_format = TextureFormat::BC7;
+      break;
+    default:
+      throw std::runtime_error("Unsupported KTX internal format");
+  }
+
+  m_size = header_size(read_u32(file, offset + 24), read_u32(file, offset + 28));
+  if (read_u32(file, offset + 32) > 1 || read_u32(file, offset + 36) > 1 ||
+      read_u32(file, offset + 40) > 1) {
+    throw std::runtime_error("Only plain 2D KTX textures are supported");
+  }
+  int level_count = header_level_count(read_u32(file, offset + 44), m_size);
+  uint32_t key_value_bytes = read_u32(file, offset + 48);
+
+  // Each level is its size followed by its data, padded to 4 bytes.
+  offset += 52 + key_value_bytes;
+  m_levels.clear();
+  for (int i = 0; i < level_count; ++i) {
+    uint32_t bytes = read_u32(file, offset);
+    offset += 4;
+    if (offset + bytes > file.size()) throw std::runtime_error("Truncated file");
+    m_levels.push_back(std::vector<unsigned char>(
+      file.data() + offset, file.data() + offset + bytes
+    ));
+    offset += (bytes + 3) & ~3u;
+  }
+}
+
+//*****************************************************************************
+void CompressedImage::check_levels() const
+{
+  if (!is_compressed(m_format)) {
+    throw std::runtime_error("CompressedImage needs a compressed format");
+  }
+  if (m_levels.empty() || m_size[0] <= 0 || m_size[1] <= 0) {
+    throw std::runtime_error("Empty compressed image");
+  }
+  if (level_count() > max_level_count(m_size)) {
+    throw std::runtime_error("More mip levels than the image size allows");
+  }
+  for (int i = 0; i < level_count(); ++i) {
+    if (m_levels[i].size() != texture_byte_size(m_format, level_size(i))) {
+      throw std::runtime_error("Compressed image level is the wrong size");
+    }
+  }
+}
+
+//*****************************************************************************
+static std::vector<unsigned char> encode_level(
+  const Image& image, 
+  TextureFormat format
+)
+{
+  Vector2i size = image.size();
+  std::vector<unsigned char> data(texture_byte_size(format, size));
+  unsigned char* out = data.data();
+
+  for (int by = 0; by < size[1]; by += 4) {
+    for (int bx = 0; bx < size[0]; bx += 4) {
+      // Blocks hanging off the edge repeat the edge pixels.
+      unsigned char pixels[16][4];
+      for (int p = 0; p < 16; ++p) {
+        int x = std::min(bx + p % 4, size[0] - 1);
+        int y = std::min(by + p / 4, size[1] - 1);
+        std::memcpy(pixels[p], image.data() + (y * size[0] + x) * 4, 4);
+      }
+
+      if (format == TextureFormat::BC3) {
+        encode_alpha_block(pixels, out);
+        encode_colour_block(pixels, false, out + 8);
+      } else {
+        encode_colour_block(pixels, true, out);
+      }
+      out += block_bytes(format);
+    }
+  }
+
+  return data;
+}
+
+//*****************************************************************************
+CompressedImage CompressedImage::encode(
+  const Image& image, 
+  TextureFormat format,
+  bool mipmaps
+)
+{
+  if (format != TextureFormat::BC1 && format != TextureFormat::BC3) {
+    throw std::runtime_error(
+      std::string("Can't encode to ") + texture_format_name(format)
+    );
+  }
+
+  std::vector<std::vector<unsigned char>> levels;
+  levels.push_back(encode_level(image, format));
+  if (mipmaps && image.size() != Vector2i(1, 1)) {
+    Image level = image.half_size();
+    while (true) {
+      levels.push_back(encode_level(level, format));
+      if (level.size() == Vector2i(1, 1)) break;
+      level = level.half_size();
+    }
+  }
+  return CompressedImage(format, image.size(), std::move(levels));
+}
+
+//*****************************************************************************
+Image CompressedImage::decode(int level_index) const
+{
+  if (m_format != TextureFormat::BC1 && m_format != TextureFormat::BC3) {
+    throw std::runtime_error(
+      std::string("Can't decode ") + texture_format_name(m_format)
+    );
+  }
+
+  Vector2i size = level_size(level_index);
+  Image ret(size);
+  const unsigned char* in = m_levels[level_index].data();
+
+  for (int by = 0; by < size[1]; by += 4) {
+    for (int bx = 0; bx < size[0]; bx += 4) {
+      unsigned char pixels[16][4];
+      if (m_format == TextureFormat::BC3) {
+        decode_colour_block(in + 8, true, pixels);
+        decode_alpha_block(in, pixels);
+      } else {
+        decode_colour_block(in, false, pixels);
+      }
+      in += block_bytes(m_format);
+
+      for (int p = 0; p < 16; ++p) {
+        int x = bx + p % 4;
+        int y = by + p / 4;
+        if (x >= size[0] || y >= size[1]) continue;
+        std::memcpy(ret.data() + (y * size[0] + x) * 4, pixels[p], 4);
+      }
+    }
+  }
+  return ret;
+}
+
+//*****************************************************************************
+void CompressedImage::save_dds(Path filename) const
+{
+  bool dx10 = m_format == TextureFormat::BC7;
+  std::vector<unsigned char> header(4 + DDS_HEADER_SIZE + (dx10 ? 20 : 0), 0);
+
+  uint32_t flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                   DDSD_LINEARSIZE;
+  uint32_t caps = DDSCAPS_TEXTURE;
+  if (level_count() > 1) {
+    flags |= DDSD_MIPMAPCOUNT;
+    caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+  }
+
+  write_u32(header, 0, DDS_MAGIC);
+  write_u32(header, 4, DDS_HEADER_SIZE);
+  write_u32(header, 8, flags);
+  write_u32(header, 12, m_size[1]);
+  write_u32(header, 16, m_size[0]);
+  write_u32(header, 20, m_levels[0].size());
+  write_u32(header, 28, level_count());
+  write_u32(header, 76, 32); // Pixel format size
+  write_u32(header, 80, DDPF_FOURCC);
+  switch (m_format) {
+    case TextureFormat::BC1: write_u32(header, 84, FOURCC_DXT1); break;
+    case TextureFormat::BC3: write_u32(header, 84, FOURCC_DXT5); break;
+    default:                 write_u32(header, 84, FOURCC_DX10); break;
+  }
+  write_u32(header, 108, caps);
+  if (dx10) {
+    write_u32(header, 128, DXGI_FORMAT_BC7_UNORM);
+    write_u32(header, 132, D3D10_RESOURCE_DIMENSION_TEXTURE2D);
+    write_u32(header, 140, 1); // Array size
+  }
+
+  std::ofstream ofs(filename.path().c_str(), std::ios::out | std::ios::binary);
+  ofs.write(reinterpret_cast<const char*>(header.data()), header.size());
+  for (const auto& level : m_levels) {
+    ofs.write(reinterpret_cast<const char*>(level.data()), level.size());
+  }
+  if (!ofs) throw std::runtime_error("Can't write " + filename.path());
+}
+
+//*****************************************************************************
+TextureFormat CompressedImage::format() const
+{
+  return m_format;
+}
+
+//*****************************************************************************
+Vector2i CompressedImage::size() const
+{
+  return m_size;
+}
+
+//*****************************************************************************
+int CompressedImage::level_count() const
+{
+  return m_levels.size();
+}
+
+//*****************************************************************************
+Vector2i CompressedImage::level_size(int level) const
+{
+  return Vector2i(std::max(m_size[0] >> level, 1), std::max(m_size[1] >> level, 1));
+}
+
+//*****************************************************************************
+const std::vector<unsigned char>& CompressedImage::level(int level) const
+{
+  return m_levels[level];
+}
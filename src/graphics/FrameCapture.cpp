@@ -0,0 +1,237 @@
+#include <cstring>
+#include <utility>
+
+#include <graphics/FrameCapture.hpp>
+#include <graphics/GraphicsSystem.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+const int FrameCapture::RING_SIZE;
+const size_t FrameCapture::MAX_QUEUED;
+
+//*****************************************************************************
+FrameCapture::FrameCapture(GraphicsSystem& gtok)
+  : GraphicsObject(gtok),
+    m_next(0),
+    m_capturing(false),
+    m_frame(0),
+    m_captured(0),
+    m_dropped(0)
+{
+  // Buffers are made by start(), since there's no context yet.
+}
+
+//*****************************************************************************
+FrameCapture::~FrameCapture()
+{
+  release();
+}
+
+//*****************************************************************************
+void FrameCapture::start(std::function<void(CapturedFrame&)> callback)
+{
+  begin();
+  m_callback = callback;
+  m_capturing = true;
+}
+
+//*****************************************************************************
+void FrameCapture::start()
+{
+  begin();
+  m_callback = nullptr;
+  m_capturing = true;
+}
+
+//*****************************************************************************
+void FrameCapture::begin()
+{
+  if (!m_slots.empty()) return;
+  m_slots.resize(RING_SIZE);
+  for (Slot& slot : m_slots) {
+    slot.buffer.reset(new VertexBufferObject(
+      graphics_system(), BufferTarget::PIXEL_PACK_BUFFER, BufferUsage::STREAM_READ
+    ));
+    slot.capacity = 0;
+    slot.fence = nullptr;
+    slot.frame = 0;
+    slot.size = Vector2i(0, 0);
+    slot.flip = false;
+  }
+}
+
+//*****************************************************************************
+void FrameCapture::stop()
+{
+  if (!m_capturing) return;
+  collect(true);
+  m_capturing = false;
+}
+
+//*****************************************************************************
+bool FrameCapture::capturing() const
+{
+  return m_capturing;
+}
+
+//*****************************************************************************
+bool FrameCapture::pop(CapturedFrame& frame)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_queue.empty()) return false;
+  frame = std::move(m_queue.front());
+  m_queue.pop_front();
+  return true;
+}
+
+//*****************************************************************************
+void FrameCapture::recycle(std::vector<unsigned char>&& pixels)
+{
+  if (pixels.capacity() == 0) return;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_spare.size() < MAX_QUEUED) m_spare.push_back(std::move(pixels));
+}
+
+//*****************************************************************************
+unsigned FrameCapture::captured() const
+{
+  return m_captured;
+}
+
+//*****************************************************************************
+unsigned FrameCapture::dropped() const
+{
+  return m_dropped;
+}
+
+//*****************************************************************************
+void FrameCapture::end_frame()
+{
+  if (!m_capturing) return;
+  profiling::Scope scope(graphics_system().profiler(), "FrameCapture::end_frame");
+  collect(false);
+  read();
+  ++m_frame;
+}
+
+//*****************************************************************************
+void FrameCapture::read()
+//
+// Reads from whatever the render target is, so this must happen before the
+// window's buffers are swapped. The window's rows come out bottom first; the
+// copy out of the buffer turns them round, which costs nothing extra. RGBA
+// rows are always a multiple of 4 bytes long, so the default pack alignment
+// leaves no padding and there's no pixel store state to change.
+//*****************************************************************************
+{
+  Slot& slot = m_slots[m_next];
+  if (slot.fence) {
+    ++m_dropped;
+    return;
+  }
+
+  Vector2i size = graphics_system().window_size();
+  size_t bytes = size_t(size[0]) * size[1] * 4;
+  if (bytes > slot.capacity) {
+    slot.buffer->allocate(bytes);
+    slot.capacity = bytes;
+  }
+
+  slot.buffer->bind();
+  glReadPixels(0, 0, size[0], size[1], GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  slot.buffer->unbind();
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.frame = m_frame;
+  slot.size = size;
+  slot.flip = graphics_system().render_target() == nullptr;
+  m_next = (m_next + 1) % RING_SIZE;
+}
+
+//*****************************************************************************
+void FrameCapture::collect(bool wait)
+{
+  // The oldest slot is the next one to be written.
+  for (int i = 0; i < RING_SIZE; ++i) {
+    Slot& slot = m_slots[(m_next + i) % RING_SIZE];
+    if (!slot.fence) continue;
+
+    GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+    GLuint64 timeout = wait ? 1000000000 : 0;
+    GLenum result = glClientWaitSync(slot.fence, flags, timeout);
+    while (wait && result == GL_TIMEOUT_EXPIRED) {
+      result = glClientWaitSync(slot.fence, 0, timeout);
+    }
+    // Keep frames in order: nothing after an unfinished one is delivered.
+    if (result == GL_TIMEOUT_EXPIRED) return;
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    if (result != GL_WAIT_FAILED) deliver(slot);
+  }
+}
+
+//*****************************************************************************
+void FrameCapture::deliver(Slot& slot)
+{
+  CapturedFrame frame;
+  frame.frame = slot.frame;
+  frame.size = slot.size;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_spare.empty()) {
+      frame.pixels = std::move(m_spare.back());
+      m_spare.pop_back();
+    }
+  }
+
+  size_t row = size_t(slot.size[0]) * 4;
+  size_t bytes = row * slot.size[1];
+  frame.pixels.resize(bytes);
+  const unsigned char* mapped = static_cast<const unsigned char*>(
+    slot.buffer->map_range(0, bytes, GL_MAP_READ_BIT)
+  );
+  if (!mapped) {
+    slot.buffer->unbind();
+    ++m_dropped;
+    recycle(std::move(frame.pixels));
+    return;
+  }
+  if (slot.flip) {
+    for (int y = 0; y < slot.size[1]; ++y) {
+      std::memcpy(
+        &frame.pixels[y * row], mapped + (slot.size[1] - 1 - y) * row, row
+      );
+    }
+  } else {
+    std::memcpy(frame.pixels.data(), mapped, bytes);
+  }
+  slot.buffer->unmap();
+  slot.buffer->unbind();
+  ++m_captured;
+
+  if (m_callback) {
+    m_callback(frame);
+    recycle(std::move(frame.pixels));
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_queue.size() >= MAX_QUEUED) {
+    ++m_dropped;
+    if (m_spare.size() < MAX_QUEUED) m_spare.push_back(std::move(frame.pixels));
+    return;
+  }
+  m_queue.push_back(std::move(frame));
+}
+
+//*****************************************************************************
+void FrameCapture::release()
+{
+  for (Slot& slot : m_slots) {
+    if (slot.fence) glDeleteSync(slot.fence);
+  }
+  m_slots.clear();
+  m_capturing = false;
+}
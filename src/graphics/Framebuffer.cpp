@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <stdexcept>
+
+#include <graphics/Framebuffer.hpp>
+#include <graphics/GraphicsSystem.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+//*****************************************************************************
+Framebuffer::Framebuffer(GraphicsSystem& gtok, Vector2i size, TextureFormat format)
+  : GraphicsObject(gtok),
+    m_id(0),
+    m_size(size),
+    m_texture(std::make_shared<Texture>(gtok, TextureTarget::TEXTURE_2D, size, format))
+{
+  glGenFramebuffers(1, &m_id);
+  graphics_system().state().bind_framebuffer(m_id);
+  glFramebufferTexture2D(
+    GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture->m_id, 0
+  );
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+  restore_target();
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    graphics_system().state().forget_framebuffer(m_id);
+    glDeleteFramebuffers(1, &m_id);
+    throw std::runtime_error(
+      std::string("Can't render to ") + texture_format_name(format) + " textures"
+    );
+  }
+}
+
+//*****************************************************************************
+Framebuffer::~Framebuffer()
+{
+  if (graphics_system().render_target() == this) {
+    graphics_system().set_render_target(nullptr);
+  }
+  graphics_system().state().forget_framebuffer(m_id);
+  glDeleteFramebuffers(1, &m_id);
+}
+
+//*****************************************************************************
+void Framebuffer::bind()
+{
+  graphics_system().state().bind_framebuffer(m_id);
+  glViewport(0, 0, m_size[0], m_size[1]);
+}
+
+//*****************************************************************************
+Vector2i Framebuffer::size() const
+{
+  return m_size;
+}
+
+//*****************************************************************************
+std::shared_ptr<Texture> Framebuffer::texture() const
+{
+  return m_texture;
+}
+
+//*****************************************************************************
+TextureRegion Framebuffer::region() const
+{
+  TextureRegion ret;
+  ret.texture = m_texture;
+  ret.min = Vector2i(0, 0);
+  ret.size = m_size;
+  return ret;
+}
+
+//*****************************************************************************
+Image Framebuffer::read_pixels()
+{
+  Image ret(m_size);
+  graphics_system().state().bind_framebuffer(m_id);
+  graphics_system().state().bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  // RGBA rows are a multiple of 4 bytes, so the default alignment is tight.
+  glReadPixels(0, 0, m_size[0], m_size[1], GL_RGBA, GL_UNSIGNED_BYTE, ret.data());
+  restore_target();
+  return ret;
+}
+
+//*****************************************************************************
+void Framebuffer::restore_target()
+{
+  Framebuffer* target = graphics_system().render_target();
+  if (target) target->bind();
+  else graphics_system().state().bind_framebuffer(0);
+}
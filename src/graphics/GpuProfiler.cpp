@@ -0,0 +1,94 @@
+#include <graphics/GpuProfiler.hpp>
+
+using namespace graphics;
+
+const int GpuProfiler::LATENCY;
+
+//*****************************************************************************
+GpuProfiler::GpuProfiler(GraphicsSystem& gtok, profiling::Profiler& profiler)
+  : GraphicsObject(gtok),
+    m_profiler(profiler),
+    m_depth(0),
+    m_active(false),
+    m_frame(0)
+{
+  // Queries are made as they're needed, since there's no context yet.
+}
+
+//*****************************************************************************
+GpuProfiler::~GpuProfiler()
+{
+  release();
+}
+
+//*****************************************************************************
+void GpuProfiler::begin(const char* name)
+{
+  if (m_depth++ > 0 || !m_profiler.enabled()) return;
+
+  if (m_free.empty()) {
+    GLuint query;
+    glGenQueries(1, &query);
+    m_free.push_back(query);
+  }
+
+  m_current.query = m_free.back();
+  m_current.name = name;
+  m_current.start = m_profiler.now();
+  m_current.frame = m_frame;
+  m_free.pop_back();
+  m_active = true;
+
+  glBeginQuery(GL_TIME_ELAPSED, m_current.query);
+}
+
+//*****************************************************************************
+void GpuProfiler::end()
+{
+  if (--m_depth > 0 || !m_active) return;
+  glEndQuery(GL_TIME_ELAPSED);
+  m_pending.push_back(m_current);
+  m_active = false;
+}
+
+//*****************************************************************************
+void GpuProfiler::end_frame()
+{
+  // Results come back in order, so stop at the first one that isn't ready.
+  while (!m_pending.empty() && m_frame - m_pending.front().frame >= LATENCY) {
+    Pending& pending = m_pending.front();
+
+    GLint available = 0;
+    glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) break;
+
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &nanoseconds);
+    m_profiler.record(
+      pending.name, 
+      pending.start, 
+      nanoseconds / 1000.0, 
+      profiling::Profiler::GPU_TRACK
+    );
+
+    m_free.push_back(pending.query);
+    m_pending.pop_front();
+  }
+  ++m_frame;
+}
+
+//*****************************************************************************
+void GpuProfiler::release()
+{
+  if (m_active) {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_free.push_back(m_current.query);
+    m_active = false;
+  }
+  for (const Pending& pending : m_pending) m_free.push_back(pending.query);
+  m_pending.clear();
+  if (!m_free.empty()) {
+    glDeleteQueries(GLsizei(m_free.size()), m_free.data());
+    m_free.clear();
+  }
+}
@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 
 #include <GL/glew.h>
 
@@ -17,6 +22,17 @@ static void glfw_error_callback(int error, const char* description)
 
 //*****************************************************************************
 GraphicsSystem::GraphicsSystem(Vector2i window_size, std::string window_name)
+  : m_glfw_token(nullptr),
+    m_window(nullptr),
+    m_headless(nullptr),
+    m_offscreen(nullptr),
+    m_target(nullptr),
+    m_programs(*this),
+    m_gpu_profiler(*this, m_profiler),
+    m_capture(*this),
+    m_frame_start(0),
+    m_animation_time(0),
+    m_running(false)
 {
   glfwSetErrorCallback(glfw_error_callback);
   
@@ -26,31 +42,340 @@ GraphicsSystem::GraphicsSystem(Vector2i window_size, std::string window_name)
   m_window = new GLFWWindow(window_size, window_name);
   m_window->make_context_current();
 
-  //glewExperimental = GL_TRUE;
-  glewInit();
+  initialise_gl();
+  set_render_target(nullptr);
+}
 
-  std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
-  std::cout << "Version: " << glGetString(GL_VERSION) << std::endl;
+//*****************************************************************************
+GraphicsSystem::GraphicsSystem(Vector2i size, HeadlessContext::Platform platform)
+  : m_glfw_token(nullptr),
+    m_window(nullptr),
+    m_headless(new HeadlessContext(platform)),
+    m_offscreen(nullptr),
+    m_target(nullptr),
+    m_programs(*this),
+    m_gpu_profiler(*this, m_profiler),
+    m_capture(*this),
+    m_frame_start(0),
+    m_animation_time(0),
+    m_running(false)
+{
+  initialise_gl();
 
-  Vector2i size = m_window->framebuffer_size();
-  glViewport(0, 0, size[0], size[1]);
+  try {
+    m_offscreen = new Framebuffer(*this, size);
+  } catch (...) {
+    delete m_headless;
+    throw;
+  }
+  set_render_target(nullptr);
+}
+
+//*****************************************************************************
+void GraphicsSystem::initialise_gl()
+{
+  //glewExperimental = GL_TRUE;
+  // Without a window GLEW can't find a GLX display, but the function
+  // pointers it loads are still good.
+  GLenum glew = glewInit();
+  if (glew != GLEW_OK && !(m_headless && glew == GLEW_ERROR_NO_GLX_DISPLAY)) {
+    std::cout << "GLEW Error " << glew << std::endl;
+  }
+
+  m_renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+  m_gl_version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  std::cout << "Renderer: " << m_renderer << std::endl;
+  std::cout << "Version: " << m_gl_version << std::endl;
 }
 
 //*****************************************************************************
 Vector2i GraphicsSystem::window_size() const
 {
+  if (m_target) return m_target->size();
   return m_window->framebuffer_size();
 }
 
 //*****************************************************************************
 GLFWWindow& GraphicsSystem::window()
 {
+  if (!m_window) throw std::runtime_error("There is no window when headless");
   return *m_window;
 }
 
+//*****************************************************************************
+bool GraphicsSystem::headless() const
+{
+  return m_window == nullptr;
+}
+
+//*****************************************************************************
+void GraphicsSystem::set_render_target(Framebuffer* target)
+{
+  m_target = target ? target : m_offscreen;
+  if (m_target) {
+    m_target->bind();
+  } else {
+    m_state.bind_framebuffer(0);
+    Vector2i size = m_window->framebuffer_size();
+    glViewport(0, 0, size[0], size[1]);
+  }
+}
+
+//*****************************************************************************
+Framebuffer* GraphicsSystem::render_target() const
+{
+  return m_target;
+}
+
+//*****************************************************************************
+std::string GraphicsSystem::renderer() const
+{
+  return m_renderer;
+}
+
+//*****************************************************************************
+std::string GraphicsSystem::gl_version() const
+{
+  return m_gl_version;
+}
+
+//*****************************************************************************
+StateCache& GraphicsSystem::state()
+{
+  return m_state;
+}
+
+//*****************************************************************************
+ProgramCache& GraphicsSystem::programs()
+{
+  return m_programs;
+}
+
+//*****************************************************************************
+filesystem::FileSystem& GraphicsSystem::file_system()
+{
+  return m_file_system;
+}
+
+//*****************************************************************************
+const filesystem::FileSystem& GraphicsSystem::file_system() const
+{
+  return m_file_system;
+}
+
+//*****************************************************************************
+TextureResidency& GraphicsSystem::residency()
+{
+  return m_residency;
+}
+
+//*****************************************************************************
+profiling::Profiler& GraphicsSystem::profiler()
+{
+  return m_profiler;
+}
+
+//*****************************************************************************
+GpuProfiler& GraphicsSystem::gpu_profiler()
+{
+  return m_gpu_profiler;
+}
+
+//*****************************************************************************
+FrameCapture& GraphicsSystem::capture()
+{
+  return m_capture;
+}
+
+//*****************************************************************************
+jobs::JobSystem& GraphicsSystem::jobs()
+{
+  return m_jobs;
+}
+
+//*****************************************************************************
+float GraphicsSystem::animation_time() const
+{
+  return m_animation_time;
+}
+
+//*****************************************************************************
+void GraphicsSystem::set_animation_time(float milliseconds)
+{
+  m_animation_time = milliseconds;
+}
+
+//*****************************************************************************
+void GraphicsSystem::swap_buffers()
+{
+  m_capture.end_frame();
+  {
+    profiling::Scope scope(m_profiler, "GraphicsSystem::swap_buffers");
+    // Headless, nothing is shown, so the frame is done as soon as it's
+    // been submitted.
+    if (m_window) m_window->swap_buffers();
+    else glFlush();
+  }
+  // Deliver events to listeners even if whoever polled glfw didn't.
+  if (m_window) m_window->dispatch_events();
+  m_state.end_frame();
+  m_residency.end_frame();
+  for (StreamingBuffer* buffer : m_streaming_buffers) buffer->end_frame();
+
+  double now = m_profiler.now();
+  if (m_profiler.enabled()) {
+    m_profiler.record("Frame", m_frame_start, now - m_frame_start);
+  }
+  m_frame_start = now;
+  m_gpu_profiler.end_frame();
+  m_profiler.end_frame();
+}
+
+//*****************************************************************************
+void GraphicsSystem::add_streaming_buffer(StreamingBuffer* buffer)
+{
+  m_streaming_buffers.push_back(buffer);
+}
+
+//*****************************************************************************
+void GraphicsSystem::remove_streaming_buffer(StreamingBuffer* buffer)
+{
+  auto it = std::find(m_streaming_buffers.begin(), m_streaming_buffers.end(), buffer);
+  if (it == m_streaming_buffers.end()) return;
+  *it = m_streaming_buffers.back();
+  m_streaming_buffers.pop_back();
+}
+
+//*****************************************************************************
+void GraphicsSystem::run(
+  std::function<void(float)> update,
+  std::function<void(float)> render,
+  const LoopSettings& settings
+)
+//
+// The usual fixed timestep loop: real time is added to an accumulator and
+// taken off a step at a time, and whatever is left over says how far to
+// interpolate. Times are in milliseconds.
+//*****************************************************************************
+{
+  if (!(settings.step_ms > 0)) {
+    throw std::invalid_argument("LoopSettings::step_ms must be more than 0");
+  }
+  if (settings.max_steps < 1) {
+    throw std::invalid_argument("LoopSettings::max_steps must be at least 1");
+  }
+
+  m_running = true;
+  m_loop_stats = LoopStats();
+  if (m_window) m_window->set_swap_interval(settings.swap_interval);
+
+  const double step = settings.step_ms;
+  const double render_interval = settings.render_hz > 0 ? 1000 / settings.render_hz : 0;
+  const double start_time = m_animation_time;
+
+  double previous = m_profiler.now() / 1000;
+  double accumulated = 0;
+  double simulated = start_time;
+  double next_render = previous;
+  double last_frame = previous;
+  double update_time = 0;
+  // Time spent stepping since the last render; there may have been several
+  // goes round the loop in between.
+
+  while (m_running) {
+    if (m_window) {
+      m_window->poll_events();
+      if (m_window->should_close()) break;
+    }
+
+    double now = m_profiler.now() / 1000;
+    accumulated += now - previous;
+    previous = now;
+
+    int steps = 0;
+    while (accumulated >= step && m_running) {
+      if (steps == settings.max_steps) {
+        // Too far behind to catch up; let the time go.
+        unsigned dropped = static_cast<unsigned>(accumulated / step);
+        m_loop_stats.dropped_steps += dropped;
+        accumulated -= dropped * step;
+        break;
+      }
+      update(float(step));
+      accumulated -= step;
+      simulated += step;
+      ++steps;
+    }
+    m_loop_stats.steps += steps;
+    double updated = m_profiler.now() / 1000;
+    update_time += updated - now;
+    if (!m_running) break;
+
+    if (updated < next_render) {
+      // Nothing to do until the next render or step, whichever is sooner.
+      double wake = std::min(next_render, updated + step - accumulated);
+      if (wake > updated) {
+        std::this_thread::sleep_for(
+          std::chrono::microseconds(static_cast<long long>((wake - updated) * 1000))
+        );
+      }
+      continue;
+    }
+
+    // The interpolated state is this far between the last two steps, so
+    // GPU animations should be at the matching time.
+    float alpha = static_cast<float>(accumulated / step);
+    set_animation_time(float(std::max(start_time, simulated - step + alpha * step)));
+    render(alpha);
+    swap_buffers();
+
+    double rendered = m_profiler.now() / 1000;
+    m_loop_stats.update_ms.add(update_time);
+    m_loop_stats.render_ms.add(rendered - updated);
+    update_time = 0;
+    if (m_loop_stats.frames > 0) m_loop_stats.frame_ms.add(rendered - last_frame);
+    last_frame = rendered;
+    ++m_loop_stats.frames;
+
+    if (render_interval > 0) {
+      next_render = std::max(next_render + render_interval, rendered - render_interval);
+    }
+  }
+  m_running = false;
+}
+
+//*****************************************************************************
+void GraphicsSystem::stop()
+{
+  m_running = false;
+}
+
+//*****************************************************************************
+const LoopStats& GraphicsSystem::loop_stats() const
+{
+  return m_loop_stats;
+}
+
+//*****************************************************************************
+void LoopStats::print(std::ostream& out) const
+{
+  out << "frame   "; frame_ms.print(out); out << '\n';
+  out << "update  "; update_ms.print(out); out << '\n';
+  out << "render  "; render_ms.print(out); out << '\n';
+  out << frames << " frames, " << steps << " steps, "
+      << dropped_steps << " steps dropped" << '\n';
+}
+
 //*****************************************************************************
 GraphicsSystem::~GraphicsSystem()
 {
+  m_gpu_profiler.release();
+  m_capture.release();
+  // Unset the offscreen framebuffer first, or it would put itself back.
+  Framebuffer* offscreen = m_offscreen;
+  m_target = m_offscreen = nullptr;
+  delete offscreen;
   delete m_window;
+  delete m_headless;
   delete m_glfw_token;
 }
@@ -0,0 +1,172 @@
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <graphics/HeadlessContext.hpp>
+
+using namespace graphics;
+
+#ifdef _WIN32
+
+//*****************************************************************************
+HeadlessContext::HeadlessContext(Platform)
+  : m_display(nullptr),
+    m_surface(nullptr),
+    m_context(nullptr)
+{
+  throw std::runtime_error("Headless contexts need EGL");
+}
+
+//*****************************************************************************
+HeadlessContext::~HeadlessContext()
+{
+}
+
+//*****************************************************************************
+void HeadlessContext::make_current()
+{
+}
+
+#else
+
+//*****************************************************************************
+static bool has_extension(const char* extensions, const char* name)
+{
+  if (!extensions) return false;
+  size_t length = std::strlen(name);
+  for (const char* p = extensions; (p = std::strstr(p, name)); p += length) {
+    bool starts = p == extensions || p[-1] == ' ';
+    bool ends = p[length] == ' ' || p[length] == '\0';
+    if (starts && ends) return true;
+  }
+  return false;
+}
+
+//*****************************************************************************
+static EGLDisplay surfaceless_display()
+{
+  // Client extensions are queried without a display. Old EGLs don't have any
+  // and report an error, which is fine.
+  const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (!has_extension(client, "EGL_MESA_platform_surfaceless") ||
+      !has_extension(client, "EGL_EXT_platform_base")) {
+    return EGL_NO_DISPLAY;
+  }
+
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+    reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+      eglGetProcAddress("eglGetPlatformDisplayEXT")
+    );
+  if (!get_platform_display) return EGL_NO_DISPLAY;
+  return get_platform_display(
+    EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr
+  );
+}
+
+//*****************************************************************************
+HeadlessContext::HeadlessContext(Platform platform)
+//
+// A 3.3 core context, the same as the window gets. Surfaceless contexts are
+// made current with no surface at all; otherwise a 1x1 pbuffer stands in.
+//*****************************************************************************
+  : m_display(EGL_NO_DISPLAY),
+    m_surface(EGL_NO_SURFACE),
+    m_context(EGL_NO_CONTEXT),
+    m_platform("surfaceless")
+{
+  EGLDisplay display = EGL_NO_DISPLAY;
+  EGLint major, minor;
+  if (platform != Platform::PBUFFER) {
+    display = surfaceless_display();
+    if (display != EGL_NO_DISPLAY && !eglInitialize(display, &major, &minor)) {
+      display = EGL_NO_DISPLAY;
+    }
+    if (display == EGL_NO_DISPLAY && platform == Platform::SURFACELESS) {
+      throw std::runtime_error("EGL has no surfaceless platform");
+    }
+  }
+  if (display == EGL_NO_DISPLAY) {
+    m_platform = "pbuffer";
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+      throw std::runtime_error("Failed to initialise EGL");
+    }
+  }
+  m_display = display;
+
+  bool surfaceless = m_platform == "surfaceless";
+  const EGLint config_attributes[] = {
+    EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint config_count = 0;
+  if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) ||
+      config_count == 0) {
+    eglTerminate(display);
+    throw std::runtime_error("No EGL config for desktop OpenGL");
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    eglTerminate(display);
+    throw std::runtime_error("EGL doesn't support desktop OpenGL");
+  }
+
+  const EGLint context_attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+    EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+    EGL_NONE
+  };
+  m_context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+  if (m_context == EGL_NO_CONTEXT) {
+    eglTerminate(display);
+    throw std::runtime_error("Failed to create an OpenGL 3.3 context");
+  }
+
+  if (!surfaceless) {
+    const EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    m_surface = eglCreatePbufferSurface(display, config, pbuffer_attributes);
+    if (m_surface == EGL_NO_SURFACE) {
+      eglDestroyContext(display, m_context);
+      eglTerminate(display);
+      throw std::runtime_error("Failed to create a pbuffer surface");
+    }
+  }
+
+  make_current();
+}
+
+//*****************************************************************************
+HeadlessContext::~HeadlessContext()
+{
+  eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (m_surface != EGL_NO_SURFACE) eglDestroySurface(m_display, m_surface);
+  eglDestroyContext(m_display, m_context);
+  eglTerminate(m_display);
+}
+
+//*****************************************************************************
+void HeadlessContext::make_current()
+{
+  if (!eglMakeCurrent(m_display, m_surface, m_surface, m_context)) {
+    throw std::runtime_error("Failed to make the EGL context current");
+  }
+}
+
+#endif
+
+//*****************************************************************************
+std::string HeadlessContext::platform() const
+{
+  return m_platform;
+}
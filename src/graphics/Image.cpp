@@ -0,0 +1,130 @@
+/*****************************************************************************
+ * Implementation of Image class.
+ */
+
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <stbimage/stb_image.h>
+
+#include <filesystem/FileData.hpp>
+#include <filesystem/FileSystem.hpp>
+
+#include <graphics/Image.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+using namespace Eigen;
+
+/*****************************************************************************/
+Image::Image(Path filename)
+{
+  FileData file(filename);
+  load(file, filename);
+}
+
+/*****************************************************************************/
+Image::Image(const FileSystem& files, Path filename)
+{
+  FileData file(files, filename);
+  load(file, filename);
+}
+
+/*****************************************************************************/
+void Image::load(const FileData& file, const Path& filename)
+{
+  int n;
+  stbi_uc* data = stbi_load_from_memory(
+    file.data(), int(file.size()), &m_size[0], &m_size[1], &n, 4
+  );
+  if (data == 0) {
+    throw std::runtime_error(filename.path() + ": " + stbi_failure_reason());
+  }
+  m_data.assign(data, data + m_size[0] * m_size[1] * 4);
+  stbi_image_free(data);
+}
+
+/*****************************************************************************/
+Image::Image(Vector2i size)
+  : m_size(size),
+    m_data(size[0] * size[1] * 4, 0)
+{
+}
+
+/*****************************************************************************/
+Vector2i Image::size() const
+{
+  return m_size;
+}
+
+/*****************************************************************************/
+unsigned char* Image::data()
+{
+  return m_data.data();
+}
+
+/*****************************************************************************/
+const unsigned char* Image::data() const
+{
+  return m_data.data();
+}
+
+/*****************************************************************************/
+size_t Image::byte_size() const
+{
+  return m_data.size();
+}
+
+/*****************************************************************************/
+void Image::blit(
+  const Image& source,
+  Vector2i source_min,
+  Vector2i size,
+  Vector2i destination_min
+)
+{
+  assert((source_min + size).x() <= source.m_size.x());
+  assert((source_min + size).y() <= source.m_size.y());
+  assert((destination_min + size).x() <= m_size.x());
+  assert((destination_min + size).y() <= m_size.y());
+
+  for (int row = 0; row < size[1]; ++row) {
+    const unsigned char* from = source.data() +
+      ((source_min[1] + row) * source.m_size[0] + source_min[0]) * 4;
+    unsigned char* to = data() +
+      ((destination_min[1] + row) * m_size[0] + destination_min[0]) * 4;
+    std::memcpy(to, from, size[0] * 4);
+  }
+}
+
+/*****************************************************************************/
+Image Image::half_size() const
+{
+  Image ret(Vector2i(std::max(m_size[0] / 2, 1), std::max(m_size[1] / 2, 1)));
+
+  for (int y = 0; y < ret.m_size[1]; ++y) {
+    for (int x = 0; x < ret.m_size[0]; ++x) {
+      // Odd edges just repeat the last row or column.
+      int xs[2] = { std::min(x * 2, m_size[0] - 1), std::min(x * 2 + 1, m_size[0] - 1) };
+      int ys[2] = { std::min(y * 2, m_size[1] - 1), std::min(y * 2 + 1, m_size[1] - 1) };
+
+      unsigned rgb[3] = { 0, 0, 0 };
+      unsigned alpha = 0;
+      for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+          const unsigned char* p = data() + (ys[j] * m_size[0] + xs[i]) * 4;
+          for (int c = 0; c < 3; ++c) rgb[c] += p[c] * p[3];
+          alpha += p[3];
+        }
+      }
+
+      unsigned char* out = ret.data() + (y * ret.m_size[0] + x) * 4;
+      for (int c = 0; c < 3; ++c) {
+        out[c] = alpha ? (rgb[c] + alpha / 2) / alpha : 0;
+      }
+      out[3] = (alpha + 2) / 4;
+    }
+  }
+  return ret;
+}
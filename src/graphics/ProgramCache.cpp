@@ -0,0 +1,287 @@
+/**
+ * Implementation of the shader program cache.
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <filesystem/FileData.hpp>
+
+#include <graphics/ProgramCache.hpp>
+#include <graphics/GraphicsSystem.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+
+//----- Helpers
+
+//*****************************************************************************
+static std::string read_source(const FileSystem& files, const Path& path)
+{
+  try {
+    return FileData(files, path).string();
+  } catch (std::runtime_error&) {
+    throw std::runtime_error("Can't read shader " + path.path());
+  }
+}
+
+//*****************************************************************************
+static std::string add_definitions(
+  const std::string& source,
+  const std::vector<std::string>& definitions
+)
+{
+  if (definitions.empty()) return source;
+
+  std::string lines;
+  for (const std::string& definition : definitions) {
+    lines += "#define " + definition + "\n";
+  }
+
+  // #version has to come first, so the definitions go straight after it.
+  size_t insert_at = 0;
+  size_t version = source.find("#version");
+  if (version != std::string::npos) {
+    size_t end_of_line = source.find('\n', version);
+    insert_at = end_of_line == std::string::npos ? source.size() : end_of_line + 1;
+  }
+
+  std::string ret = source;
+  ret.insert(insert_at, lines);
+  return ret;
+}
+
+//*****************************************************************************
+static uint64_t hash(const std::string& data, uint64_t h = 14695981039346656037ull)
+{
+  // FNV-1a. Not cryptographic, but plenty to tell sources apart.
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+//*****************************************************************************
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+
+//----- ProgramSource
+
+//*****************************************************************************
+ProgramSource::ProgramSource(Path vertex_shader, Path fragment_shader)
+  : m_vertex_shader(vertex_shader),
+    m_fragment_shader(fragment_shader)
+{
+}
+
+//*****************************************************************************
+ProgramSource& ProgramSource::define(std::string definition)
+{
+  m_definitions.push_back(definition);
+  return *this;
+}
+
+//*****************************************************************************
+ProgramSource& ProgramSource::attribute(AttributeIndex index, std::string name)
+{
+  m_attributes.push_back(std::make_pair(index.idx(), name));
+  return *this;
+}
+
+//*****************************************************************************
+const Path& ProgramSource::vertex_shader() const
+{
+  return m_vertex_shader;
+}
+
+//*****************************************************************************
+const Path& ProgramSource::fragment_shader() const
+{
+  return m_fragment_shader;
+}
+
+//*****************************************************************************
+const std::vector<std::string>& ProgramSource::definitions() const
+{
+  return m_definitions;
+}
+
+//*****************************************************************************
+const std::vector<std::pair<int, std::string>>& ProgramSource::attributes() const
+{
+  return m_attributes;
+}
+
+//*****************************************************************************
+std::string ProgramSource::key() const
+{
+  // Newlines can't appear in any of the parts, so they make a safe separator.
+  std::ostringstream ss;
+  ss << m_vertex_shader.path() << '\n' << m_fragment_shader.path() << '\n';
+  for (const std::string& definition : m_definitions) {
+    ss << "D" << definition << '\n';
+  }
+  for (const auto& attribute : m_attributes) {
+    ss << "A" << attribute.first << " " << attribute.second << '\n';
+  }
+  return ss.str();
+}
+
+
+//----- ProgramCache
+
+//*****************************************************************************
+ProgramCache::ProgramCache(GraphicsSystem& system)
+  : GraphicsObject(system),
+    m_use_binaries(false),
+    m_hits(0),
+    m_misses(0),
+    m_compiled(0),
+    m_loaded(0),
+    m_compile_seconds(0),
+    m_load_seconds(0)
+{
+}
+
+//*****************************************************************************
+std::shared_ptr<ShaderProgram> ProgramCache::get(const ProgramSource& source)
+{
+  std::string key = source.key();
+
+  std::weak_ptr<ShaderProgram>& entry = m_programs[key];
+  if (std::shared_ptr<ShaderProgram> program = entry.lock()) {
+    ++m_hits;
+    return program;
+  }
+  ++m_misses;
+
+  const FileSystem& files = graphics_system().file_system();
+  std::shared_ptr<ShaderProgram> program = build(
+    source,
+    add_definitions(read_source(files, source.vertex_shader()), source.definitions()),
+    add_definitions(read_source(files, source.fragment_shader()), source.definitions())
+  );
+
+  entry = program;
+  return program;
+}
+
+//*****************************************************************************
+std::shared_ptr<ShaderProgram> ProgramCache::build(
+  const ProgramSource& source,
+  const std::string& vertex_source,
+  const std::string& fragment_source
+)
+{
+  profiling::Scope scope(graphics_system().profiler(), "ProgramCache::build");
+  auto start = std::chrono::steady_clock::now();
+  std::string name = 
+    source.vertex_shader().path() + " + " + source.fragment_shader().path();
+
+  std::string binary_path;
+  if (m_use_binaries) {
+    uint64_t h = hash(vertex_source);
+    h = hash(fragment_source, h);
+    for (const auto& attribute : source.attributes()) {
+      h = hash(std::to_string(attribute.first) + attribute.second, h);
+    }
+    h = hash(graphics_system().renderer(), h);
+    h = hash(graphics_system().gl_version(), h);
+
+    char file_name[32];
+    std::snprintf(file_name, sizeof(file_name), "%016llx.bin", 
+                  static_cast<unsigned long long>(h));
+    binary_path = m_binary_directory + "/" + file_name;
+
+    auto program = std::make_shared<ShaderProgram>(graphics_system());
+    if (program->load_binary(Path(binary_path))) {
+      double seconds = seconds_since(start);
+      ++m_loaded;
+      m_load_seconds += seconds;
+      return program;
+    }
+  }
+
+  VertexShader vertex_shader(graphics_system(), vertex_source);
+  FragmentShader fragment_shader(graphics_system(), fragment_source);
+
+  auto program = std::make_shared<ShaderProgram>(graphics_system());
+  program->attach(vertex_shader);
+  program->attach(fragment_shader);
+  for (const auto& attribute : source.attributes()) {
+    program->bind_attribute(AttributeIndex(attribute.first), attribute.second);
+  }
+  if (m_use_binaries) program->allow_binary_retrieval();
+  if (!program->link()) {
+    throw std::runtime_error(
+      "Failed to link " + name + ": " + program->info_log()
+    );
+  }
+
+  double seconds = seconds_since(start);
+  ++m_compiled;
+  m_compile_seconds += seconds;
+
+  // Failing to save just means compiling again next time.
+  if (m_use_binaries) program->save_binary(Path(binary_path));
+
+  return program;
+}
+
+//*****************************************************************************
+void ProgramCache::set_binary_directory(Path directory)
+{
+  m_use_binaries = ShaderProgram::binaries_supported();
+  m_binary_directory = directory.path();
+}
+
+//*****************************************************************************
+bool ProgramCache::caching_binaries() const
+{
+  return m_use_binaries;
+}
+
+//*****************************************************************************
+int ProgramCache::hits() const
+{
+  return m_hits;
+}
+
+//*****************************************************************************
+int ProgramCache::misses() const
+{
+  return m_misses;
+}
+
+//*****************************************************************************
+int ProgramCache::compiled() const
+{
+  return m_compiled;
+}
+
+//*****************************************************************************
+int ProgramCache::loaded() const
+{
+  return m_loaded;
+}
+
+//*****************************************************************************
+double ProgramCache::compile_seconds() const
+{
+  return m_compile_seconds;
+}
+
+//*****************************************************************************
+double ProgramCache::load_seconds() const
+{
+  return m_load_seconds;
+}
@@ -5,8 +5,14 @@
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+#include <filesystem/FileData.hpp>
 
 #include <graphics/ShaderProgram.hpp>
+#include <graphics/GraphicsSystem.hpp>
 
 using namespace graphics;
 using namespace filesystem;
@@ -18,34 +24,24 @@ using namespace Eigen;
 Shader::Shader(GraphicsSystem& tok, GLenum type, std::string source) 
   : GraphicsObject(tok)
 {
-  initialise(type, source);
+  initialise(type, source.c_str(), source.size());
 }
 
 //*****************************************************************************
 Shader::Shader(GraphicsSystem& tok, GLenum type, Path filename)
   : GraphicsObject(tok)
 {
-  std::ifstream ifs(filename.path());
-
-  std::string source;
-  while (ifs.good()) {
-    std::string line;
-    std::getline(ifs, line);
-    source.append(line);
-    source.append("\n");
-  }
-
-  initialise(type, source);
+  FileData source(graphics_system().file_system(), filename);
+  initialise(type, source.chars(), source.size());
 }
 
 //*****************************************************************************
-void Shader::initialise(GLenum type, std::string source)
+void Shader::initialise(GLenum type, const char* source, size_t length)
 {
-  std::cout << "Compiling shader source:" << std::endl
-	    << source << std::endl;
+  profiling::Scope scope(graphics_system().profiler(), "Shader::compile");
   m_id = glCreateShader(type);
-  const char* program_source = source.c_str();
-  glShaderSource (m_id, 1, &program_source, nullptr);
+  GLint source_length = GLint(length);
+  glShaderSource (m_id, 1, &source, &source_length);
   glCompileShader(m_id);
   
   if (invalid()) {
@@ -69,11 +65,12 @@ std::string Shader::info_log()
   GLint max_length;
   glGetShaderiv(m_id, GL_INFO_LOG_LENGTH, &max_length);
 
-  char* buf = new char[max_length];
+  if (max_length <= 0) return std::string();
+  std::vector<char> buf(max_length);
   GLsizei actual_length;
-  glGetShaderInfoLog(m_id, max_length, &actual_length, buf);
+  glGetShaderInfoLog(m_id, max_length, &actual_length, &buf[0]);
   
-  return std::string(buf, actual_length);
+  return std::string(&buf[0], actual_length);
 }
 
 //*****************************************************************************
@@ -122,52 +119,176 @@ void ShaderProgram::attach(const Shader& shader)
   glAttachShader(m_id, shader.m_id); 
 }
 
+//*****************************************************************************
+void ShaderProgram::bind_attribute(AttributeIndex index, std::string name)
+{
+  // Only takes effect at the next link().
+  glBindAttribLocation(m_id, index.idx(), name.c_str());
+}
+
 //*****************************************************************************
 bool ShaderProgram::link() 
 { 
   glLinkProgram(m_id); 
+
+  GLint ok;
+  glGetProgramiv(m_id, GL_LINK_STATUS, &ok);
+  if (!ok) return false;
+
+  query_uniforms();
+  return true;
+}
+
+//*****************************************************************************
+std::string ShaderProgram::info_log()
+{
+  GLint max_length;
+  glGetProgramiv(m_id, GL_INFO_LOG_LENGTH, &max_length);
+
+  if (max_length <= 0) return std::string();
+  std::vector<char> buf(max_length);
+  GLsizei actual_length;
+  glGetProgramInfoLog(m_id, max_length, &actual_length, &buf[0]);
+
+  return std::string(&buf[0], actual_length);
+}
+
+//*****************************************************************************
+bool ShaderProgram::binaries_supported()
+{
+  if (!GLEW_ARB_get_program_binary) return false;
+
+  GLint format_count = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+  return format_count > 0;
+}
+
+//*****************************************************************************
+void ShaderProgram::allow_binary_retrieval()
+{
+  glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+//*****************************************************************************
+bool ShaderProgram::save_binary(const Path& path)
+{
+  GLint length = 0;
+  glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return false;
+
+  std::vector<char> binary(length);
+  GLenum format;
+  glGetProgramBinary(m_id, length, &length, &format, &binary[0]);
+
+  // The file is just the format followed by the binary.
+  std::ofstream ofs(path.path().c_str(), std::ios::out | std::ios::binary);
+  ofs.write(reinterpret_cast<const char*>(&format), sizeof(format));
+  ofs.write(&binary[0], length);
+  return ofs.good();
+}
+
+//*****************************************************************************
+bool ShaderProgram::load_binary(const Path& path)
+{
+  std::unique_ptr<FileData> file;
+  try {
+    file.reset(new FileData(path));
+  } catch (std::runtime_error&) {
+    return false;
+  }
+
+  GLenum format;
+  if (file->size() <= sizeof(format)) return false;
+  std::memcpy(&format, file->data(), sizeof(format));
+
+  glProgramBinary(
+    m_id, format, 
+    file->data() + sizeof(format), 
+    GLsizei(file->size() - sizeof(format))
+  );
+
+  GLint ok;
+  glGetProgramiv(m_id, GL_LINK_STATUS, &ok);
+  if (!ok) return false;
+
+  query_uniforms();
+  return true;
+}
+
+//*****************************************************************************
+void ShaderProgram::query_uniforms()
+{
+  m_uniforms.clear();
+  m_uniform_slots.clear();
+
+  GLint count, max_length;
+  glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+  std::vector<char> buf(max_length + 1);
+  for (GLint i = 0; i < count; ++i) {
+    GLsizei length;
+    GLint size;
+    UniformSlot slot;
+    glGetActiveUniform(m_id, i, buf.size(), &length, &size, &slot.type, &buf[0]);
+    std::string name(&buf[0], length);
+
+    // Uniforms in blocks don't have a location; skip them.
+    slot.location = glGetUniformLocation(m_id, name.c_str());
+    if (slot.location < 0) continue;
+    slot.written = false;
+
+    // Arrays are reported as "name[0]". Make them findable as "name" too.
+    int index = m_uniforms.size();
+    m_uniforms.push_back(slot);
+    m_uniform_slots[name] = index;
+    size_t bracket = name.find('[');
+    if (bracket != std::string::npos) {
+      m_uniform_slots[name.substr(0, bracket)] = index;
+    }
+  }
+}
+
+//*****************************************************************************
+int ShaderProgram::find_uniform(const std::string& name) const
+{
+  auto it = m_uniform_slots.find(name);
+  return it == m_uniform_slots.end() ? -1 : it->second;
 }
 
 //*****************************************************************************
-void ShaderProgram::set_uniform(std::string name, float value)
+void ShaderProgram::set_uniform(const std::string& name, float value)
 {
-  bind();
-  int location = glGetUniformLocation(m_id, name.c_str());
-  glUniform1f(location, value);
+  uniform<float>(name).set(value);
 }
 
 //*****************************************************************************
-void ShaderProgram::set_uniform(std::string name, Vector2f value)
+void ShaderProgram::set_uniform(const std::string& name, Vector2f value)
 {
-  bind();
-  int location = glGetUniformLocation(m_id, name.c_str());
-  glUniform2f(location, value[0], value[1]);
+  uniform<Vector2f>(name).set(value);
 }
 
 //*****************************************************************************
-void ShaderProgram::set_uniform(std::string name, int value)
+void ShaderProgram::set_uniform(const std::string& name, int value)
 {
-  bind();
-  int location = glGetUniformLocation(m_id, name.c_str());
-  glUniform1i(location, value);
+  uniform<int>(name).set(value);
 }
 
 //*****************************************************************************
-void ShaderProgram::set_uniform(std::string name, Vector2i value)
+void ShaderProgram::set_uniform(const std::string& name, Vector2i value)
 {
-  bind();
-  int location = glGetUniformLocation(m_id, name.c_str());
-  glUniform2i(location, value[0], value[1]);
+  uniform<Vector2i>(name).set(value);
 }
 
 //*****************************************************************************
 void ShaderProgram::bind() 
 { 
-  glUseProgram(m_id); 
+  graphics_system().state().use_program(m_id);
 }
 
 //*****************************************************************************
 ShaderProgram::~ShaderProgram() 
 { 
+  graphics_system().state().forget_program(m_id);
   glDeleteProgram(m_id); 
 }
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+
+#include <graphics/SpatialGrid.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+//----- OrientedBox
+
+//*****************************************************************************
+OrientedBox::OrientedBox(Vector2f min, Vector2f size, float orientation_radians)
+  : m_centre(min + size * 0.5f),
+    m_half_size(size * 0.5f),
+    m_cos(std::cos(orientation_radians)),
+    m_sin(std::sin(orientation_radians))
+{
+}
+
+//*****************************************************************************
+bool OrientedBox::contains(Vector2f point) const
+{
+  // Rotate the point into the box's frame.
+  Vector2f rel = point - m_centre;
+  float x =  m_cos * rel[0] + m_sin * rel[1];
+  float y = -m_sin * rel[0] + m_cos * rel[1];
+  return std::abs(x) <= m_half_size[0] && std::abs(y) <= m_half_size[1];
+}
+
+//*****************************************************************************
+bool OrientedBox::overlaps(Vector2f rect_min, Vector2f rect_max) const
+//
+// Separating axis test. Two rectangles overlap unless one of their four edge
+// directions separates them. The rectangle's axes are just its bounds against
+// ours; for our own axes, project the rectangle onto them.
+//*****************************************************************************
+{
+  Vector2f lo = min();
+  Vector2f hi = max();
+  if (hi[0] < rect_min[0] || lo[0] > rect_max[0]) return false;
+  if (hi[1] < rect_min[1] || lo[1] > rect_max[1]) return false;
+
+  Vector2f rect_centre = (rect_min + rect_max) * 0.5f;
+  Vector2f rect_half = (rect_max - rect_min) * 0.5f;
+  Vector2f rel = rect_centre - m_centre;
+
+  const Vector2f axes[2] = {
+    Vector2f(m_cos, m_sin),
+    Vector2f(-m_sin, m_cos)
+  };
+  for (int i = 0; i < 2; ++i) {
+    float distance = std::abs(axes[i].dot(rel));
+    float rect_extent =
+      rect_half[0] * std::abs(axes[i][0]) + rect_half[1] * std::abs(axes[i][1]);
+    if (distance > m_half_size[i] + rect_extent) return false;
+  }
+  return true;
+}
+
+//*****************************************************************************
+Vector2f OrientedBox::min() const
+{
+  return m_centre - (max() - m_centre);
+}
+
+//*****************************************************************************
+Vector2f OrientedBox::max() const
+{
+  float c = std::abs(m_cos);
+  float s = std::abs(m_sin);
+  return m_centre + Vector2f(
+    c * m_half_size[0] + s * m_half_size[1],
+    s * m_half_size[0] + c * m_half_size[1]
+  );
+}
+
+
+//----- SpatialGrid
+
+//*****************************************************************************
+SpatialGrid::SpatialGrid(float cell_size)
+  : m_cell_size(cell_size),
+    m_query(0)
+{
+}
+
+//*****************************************************************************
+SpatialGrid::CellKey SpatialGrid::key(int x, int y) const
+{
+  return (static_cast<CellKey>(static_cast<uint32_t>(x)) << 32) |
+         static_cast<uint32_t>(y);
+}
+
+//*****************************************************************************
+int SpatialGrid::cell(float coordinate) const
+{
+  // Clamp so that silly coordinates can't overflow, or make key() collide.
+  float c = std::floor(coordinate / m_cell_size);
+  return static_cast<int>(std::max(-1e9f, std::min(c, 1e9f)));
+}
+
+//*****************************************************************************
+void SpatialGrid::add_to_cells(uint32_t id, const Entry& entry)
+{
+  for (int x = entry.cell_min[0]; x <= entry.cell_max[0]; ++x) {
+    for (int y = entry.cell_min[1]; y <= entry.cell_max[1]; ++y) {
+      m_cells[key(x, y)].push_back(id);
+    }
+  }
+}
+
+//*****************************************************************************
+void SpatialGrid::remove_from_cells(uint32_t id, const Entry& entry)
+{
+  for (int x = entry.cell_min[0]; x <= entry.cell_max[0]; ++x) {
+    for (int y = entry.cell_min[1]; y <= entry.cell_max[1]; ++y) {
+      auto it = m_cells.find(key(x, y));
+      if (it == m_cells.end()) continue;
+
+      std::vector<uint32_t>& ids = it->second;
+      auto found = std::find(ids.begin(), ids.end(), id);
+      if (found != ids.end()) {
+        *found = ids.back();
+        ids.pop_back();
+      }
+      if (ids.empty()) m_cells.erase(it);
+    }
+  }
+}
+
+//*****************************************************************************
+void SpatialGrid::update(uint32_t id, Vector2f min, Vector2f max)
+{
+  if (id >= m_entries.size()) {
+    Entry absent = { { 0, 0 }, { 0, 0 }, false };
+    m_entries.resize(id + 1, absent);
+    m_marks.resize(id + 1, 0);
+  }
+
+  Entry entry = {
+    { cell(min[0]), cell(min[1]) },
+    { cell(max[0]), cell(max[1]) },
+    true
+  };
+
+  Entry& old = m_entries[id];
+  if (old.present &&
+      old.cell_min[0] == entry.cell_min[0] &&
+      old.cell_min[1] == entry.cell_min[1] &&
+      old.cell_max[0] == entry.cell_max[0] &&
+      old.cell_max[1] == entry.cell_max[1]) {
+    return;
+  }
+
+  if (old.present) remove_from_cells(id, old);
+  add_to_cells(id, entry);
+  old = entry;
+}
+
+//*****************************************************************************
+void SpatialGrid::remove(uint32_t id)
+{
+  if (id >= m_entries.size() || !m_entries[id].present) return;
+  remove_from_cells(id, m_entries[id]);
+  m_entries[id].present = false;
+}
+
+//*****************************************************************************
+void SpatialGrid::query(Vector2f min, Vector2f max, std::vector<uint32_t>& ids) const
+{
+  if (++m_query == 0) {
+    // Wrapped around; old marks could now look current.
+    std::fill(m_marks.begin(), m_marks.end(), 0);
+    m_query = 1;
+  }
+
+  int min_x = cell(min[0]), max_x = cell(max[0]);
+  int min_y = cell(min[1]), max_y = cell(max[1]);
+
+  // A huge rectangle would visit a lot of empty cells; past a point it's
+  // cheaper to walk the cells that exist.
+  double area = double(max_x - min_x + 1) * double(max_y - min_y + 1);
+  if (area > double(m_cells.size())) {
+    for (const auto& occupied : m_cells) {
+      int x = static_cast<int32_t>(occupied.first >> 32);
+      int y = static_cast<int32_t>(occupied.first & 0xffffffff);
+      if (x < min_x || x > max_x || y < min_y || y > max_y) continue;
+      for (uint32_t id : occupied.second) {
+        if (m_marks[id] == m_query) continue;
+        m_marks[id] = m_query;
+        ids.push_back(id);
+      }
+    }
+    return;
+  }
+
+  for (int x = min_x; x <= max_x; ++x) {
+    for (int y = min_y; y <= max_y; ++y) {
+      auto it = m_cells.find(key(x, y));
+      if (it == m_cells.end()) continue;
+      for (uint32_t id : it->second) {
+        if (m_marks[id] == m_query) continue;
+        m_marks[id] = m_query;
+        ids.push_back(id);
+      }
+    }
+  }
+}
@@ -1,10 +1,16 @@
 #include <assert.h>
 
+#include <graphics/CommandList.hpp>
 #include <graphics/GraphicsSystem.hpp>
 #include <graphics/Sprite.hpp>
+#include <graphics/SpriteBatch.hpp>
+#include <graphics/SpatialGrid.hpp>
 
 #include <iostream>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdlib>
 
 using namespace graphics;
@@ -19,6 +25,18 @@ Animation::Animation(
   Vector2i frame_size,
   int frame_count,
   float period // Milliseconds per frame
+)
+  : Animation(gtok, load_sheet(gtok, texture_path), frame_size, frame_count, period)
+{
+}
+
+//*****************************************************************************
+Animation::Animation(
+  GraphicsSystem& gtok,
+  TextureRegion sheet,
+  Vector2i frame_size,
+  int frame_count,
+  float period // Milliseconds per frame
 )
 // Initialise everything. This is a behemoth of an object, but it's mostly just
 // OpenGL state wrangling. Conceptually, it's quite simple - a texture, a 
@@ -28,18 +46,32 @@ Animation::Animation(
     m_frame_size(frame_size),
     m_frame_count(frame_count),
     m_period(period),
+    m_sheet(sheet),
+    m_columns(frame_size[0] > 0 ? sheet.size[0] / frame_size[0] : 0),
     m_positions(gtok, BufferTarget::ARRAY_BUFFER, BufferUsage::STATIC_DRAW),
     m_positions_attribute(0),
-    m_vertex_attributes(gtok),
-    m_fragment_shader(gtok, Path("data/shaders/animation.glsl.f")),
-    m_vertex_shader(gtok, Path("data/shaders/animation.glsl.v")),
-    m_shader_program(gtok),
-    m_texture(gtok, TextureTarget::TEXTURE_2D, texture_path)
+    m_instance(gtok, BufferTarget::ARRAY_BUFFER, BufferUsage::DYNAMIC_DRAW),
+    m_origin_attribute(1),
+    m_orientation_attribute(2),
+    m_frame_attribute(3),
+    m_frame_size_attribute(4),
+    m_frame_uvs_attribute(5),
+    m_columns_attribute(6),
+    m_timing_attribute(7),
+    m_vertex_attributes(gtok)
 {
+  check_validity();
+
+  Vector2f texture_size = m_sheet.texture->size().cast<float>();
+  m_frame_uvs[0] = m_sheet.min[0] / texture_size[0];
+  m_frame_uvs[1] = m_sheet.min[1] / texture_size[1];
+  m_frame_uvs[2] = m_frame_size[0] / texture_size[0];
+  m_frame_uvs[3] = m_frame_size[1] / texture_size[1];
+
   m_positions_arr[0] = Vector2f(0, 0);
-  m_positions_arr[1] = Vector2f(0, frame_size[1]);
-  m_positions_arr[2] = Vector2f(frame_size[0], 0);
-  m_positions_arr[3] = Vector2f(frame_size[0], frame_size[1]);
+  m_positions_arr[1] = Vector2f(0, 1);
+  m_positions_arr[2] = Vector2f(1, 0);
+  m_positions_arr[3] = Vector2f(1, 1);
   
   m_positions.fill(sizeof(m_positions_arr), m_positions_arr);
   
@@ -52,32 +84,196 @@ Animation::Animation(
     false,
     0
   );
+
+  // The instance attributes advance once per instance rather than once per
+  // vertex. They get pointed at an actual buffer in draw_instances().
+  const AttributeIndex instance_attributes[] = {
+    m_origin_attribute,
+    m_orientation_attribute,
+    m_frame_attribute,
+    m_frame_size_attribute,
+    m_frame_uvs_attribute,
+    m_columns_attribute,
+    m_timing_attribute
+  };
+  for (AttributeIndex index : instance_attributes) {
+    m_vertex_attributes.enable_attribute(index);
+    m_vertex_attributes.attribute_divisor(index, 1);
+  }
   
-  m_shader_program.attach(m_vertex_shader);
-  m_shader_program.attach(m_fragment_shader);
-  m_shader_program.link();
-  
-  m_shader_program.set_uniform("texture_size", m_texture.size());
-  m_shader_program.set_uniform("frame_size", m_frame_size);
-  m_shader_program.set_uniform("window_size", graphics_system().window_size());
-  
-  check_validity();
+  ProgramSource source(
+    Path("data/shaders/animation.glsl.v"),
+    Path("data/shaders/animation.glsl.f")
+  );
+  source.attribute(m_positions_attribute, "position")
+        .attribute(m_origin_attribute, "origin")
+        .attribute(m_orientation_attribute, "orientation")
+        .attribute(m_frame_attribute, "frame")
+        .attribute(m_frame_size_attribute, "frame_size")
+        .attribute(m_frame_uvs_attribute, "frame_uvs")
+        .attribute(m_columns_attribute, "columns")
+        .attribute(m_timing_attribute, "timing");
+  m_shader_program = graphics_system().programs().get(source);
+  m_time_uniform = m_shader_program->uniform<float>("time");
+  m_window_size_uniform = m_shader_program->uniform<Vector2i>("window_size");
+  m_top_row_first_uniform = m_shader_program->uniform<int>("top_row_first");
+}
+
+//*****************************************************************************
+TextureRegion Animation::load_sheet(GraphicsSystem& gtok, Path path)
+{
+  TextureRegion ret;
+  ret.texture = make_shared<Texture>(gtok, TextureTarget::TEXTURE_2D, path);
+  ret.min = Vector2i(0, 0);
+  ret.size = ret.texture->size();
+  return ret;
 }
 
 //*****************************************************************************
 void Animation::draw(int frame, Vector2f position, float orientation_radians)
+{
+  draw_instance(instance(frame, position, orientation_radians));
+}
+
+//*****************************************************************************
+void Animation::draw_animated(
+  float start_time,
+  Vector2f position,
+  float orientation_radians
+)
+{
+  draw_instance(animated_instance(start_time, position, orientation_radians));
+}
+
+//*****************************************************************************
+void Animation::draw_instance(const AnimationInstance& data)
+{
+  // Don't bother if it's entirely off screen.
+  OrientedBox box(
+    Vector2f(data.origin[0], data.origin[1]), 
+    m_frame_size.cast<float>(), 
+    data.orientation
+  );
+  Vector2f min = box.min();
+  Vector2f max = box.max();
+  Vector2f window = graphics_system().window_size().cast<float>();
+  if (max[0] < 0 || max[1] < 0 || min[0] > window[0] || min[1] > window[1]) {
+    return;
+  }
+
+  m_instance.fill(sizeof(data), &data);
+  draw_instances(m_instance, 0, 1);
+}
+
+//*****************************************************************************
+AnimationInstance Animation::instance(
+  int frame, 
+  Vector2f position, 
+  float orientation_radians
+) const
 {
   assert(frame >= 0 && frame < m_frame_count);
 
-  m_texture.bind(TextureTarget::TEXTURE_2D);
-  m_shader_program.bind();
+  AnimationInstance ret;
+  ret.origin[0] = position[0];
+  ret.origin[1] = position[1];
+  ret.orientation = orientation_radians;
+  ret.frame = static_cast<float>(frame);
+  ret.frame_size[0] = static_cast<float>(m_frame_size[0]);
+  ret.frame_size[1] = static_cast<float>(m_frame_size[1]);
+  for (int i = 0; i < 4; ++i) ret.frame_uvs[i] = m_frame_uvs[i];
+  ret.columns = static_cast<float>(m_columns);
+  ret.start_time = 0;
+  ret.period = m_period;
+  ret.frame_count = static_cast<float>(m_frame_count);
+  return ret;
+}
+
+//*****************************************************************************
+AnimationInstance Animation::animated_instance(
+  float start_time,
+  Vector2f position,
+  float orientation_radians
+) const
+{
+  AnimationInstance ret = instance(0, position, orientation_radians);
+  ret.frame = -1;
+  ret.start_time = start_time;
+  return ret;
+}
+
+//*****************************************************************************
+float Animation::time() const
+{
+  return graphics_system().animation_time();
+}
+
+//*****************************************************************************
+int Animation::frame_at(float start_time) const
+{
+  // The little nudge stops rounding from leaving start_time_for()'s frame
+  // showing the one before. The shader does the same.
+  float elapsed = std::max(time() - start_time, 0.0f);
+  float steps = std::floor(elapsed / m_period + 0.001f);
+  return static_cast<int>(std::fmod(steps, float(m_frame_count)));
+}
+
+//*****************************************************************************
+float Animation::start_time_for(int frame) const
+{
+  return time() - frame * m_period;
+}
+
+//*****************************************************************************
+void Animation::instance_attribute(
+  AttributeIndex index,
+  VertexBufferObject& instances,
+  ComponentCount count,
+  size_t offset
+)
+{
+  m_vertex_attributes.attribute_pointer(
+    index, instances, count, DataType::FLOAT, 
+    false, sizeof(AnimationInstance), offset
+  );
+}
+
+//*****************************************************************************
+void Animation::draw_instances(
+  VertexBufferObject& instances, 
+  size_t offset, 
+  int count
+)
+{
+  if (count <= 0) return;
+
+  profiling::Scope scope(graphics_system().profiler(), "Animation::draw");
+  GpuScope gpu_scope(graphics_system().gpu_profiler(), "GPU Animation::draw");
+
+  instance_attribute(m_origin_attribute, instances, ComponentCount::TWO,
+    offset + offsetof(AnimationInstance, origin));
+  instance_attribute(m_orientation_attribute, instances, ComponentCount::ONE,
+    offset + offsetof(AnimationInstance, orientation));
+  instance_attribute(m_frame_attribute, instances, ComponentCount::ONE,
+    offset + offsetof(AnimationInstance, frame));
+  instance_attribute(m_frame_size_attribute, instances, ComponentCount::TWO,
+    offset + offsetof(AnimationInstance, frame_size));
+  instance_attribute(m_frame_uvs_attribute, instances, ComponentCount::FOUR,
+    offset + offsetof(AnimationInstance, frame_uvs));
+  instance_attribute(m_columns_attribute, instances, ComponentCount::ONE,
+    offset + offsetof(AnimationInstance, columns));
+  instance_attribute(m_timing_attribute, instances, ComponentCount::THREE,
+    offset + offsetof(AnimationInstance, start_time));
+
+  m_time_uniform.set(graphics_system().animation_time());
+  m_window_size_uniform.set(graphics_system().window_size());
+  m_top_row_first_uniform.set(graphics_system().render_target() != nullptr);
+
+  m_sheet.texture->bind(TextureTarget::TEXTURE_2D);
+  m_shader_program->bind();
   m_vertex_attributes.bind();
   
-  m_shader_program.set_uniform("frame", frame);
-  m_shader_program.set_uniform("origin", position);
-  m_shader_program.set_uniform("orientation", orientation_radians);
-  
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
 }
 
 //*****************************************************************************
@@ -86,17 +282,23 @@ void Animation::check_validity() const
   assert(m_frame_size[0] != 0);
   assert(m_frame_size[1] != 0);
   
-  int num_columns = m_texture.size()[0] / m_frame_size[0];
+  int num_columns = m_sheet.size[0] / m_frame_size[0];
   assert(num_columns > 0);
 
-  int num_rows = m_texture.size()[1] / m_frame_size[1];
+  int num_rows = m_sheet.size[1] / m_frame_size[1];
   assert(num_rows > 0);
 
-  int num_rows_needed = m_frame_count / num_columns;
+  int num_rows_needed = (m_frame_count + num_columns - 1) / num_columns;
   assert(num_rows_needed > 0);
   assert(num_rows_needed <= num_rows);
 }
 
+//*****************************************************************************
+const Texture& Animation::texture() const
+{
+  return *m_sheet.texture;
+}
+
 //*****************************************************************************
 Vector2i Animation::size() const
 {
@@ -115,6 +317,37 @@ float Animation::period() const
   return m_period;
 }
 
+//*****************************************************************************
+void graphics::advance_frame(
+  float& time_accumulated, 
+  int& frame, 
+  float period, 
+  int frame_count
+)
+//
+// Steps while more than a whole period has accumulated, as the old loop did:
+// an exact multiple of the period keeps one period back, so a frame is only
+// left once its time is strictly exceeded. SpriteWorld::update_range() does
+// exactly the same sums four at a time, so keep the two in step.
+//*****************************************************************************
+{
+  if (time_accumulated <= period) return;
+
+  float steps = std::floor(time_accumulated / period);
+  if (steps * period >= time_accumulated) steps -= 1;
+  time_accumulated = std::max(time_accumulated - steps * period, 0.0f);
+  frame = static_cast<int>((frame + std::fmod(steps, float(frame_count)))) 
+    % frame_count;
+}
+
+//*****************************************************************************
+float graphics::interpolate_angle(float from, float to, float alpha)
+{
+  const float two_pi = 6.28318531f;
+  float delta = std::remainder(to - from, two_pi);
+  return from + delta * alpha;
+}
+
 //*****************************************************************************
 Sprite::Sprite()
   : m_time_accumulated(0),
@@ -122,7 +355,11 @@ Sprite::Sprite()
     m_animation(0),
     m_position(0, 0),
     m_orientation(0),
-    m_animating(true)
+    m_previous_position(0, 0),
+    m_previous_orientation(0),
+    m_animating(true),
+    m_on_gpu(false),
+    m_start_time(0)
 {
 }
 
@@ -132,6 +369,7 @@ void Sprite::set_animation(shared_ptr<Animation> animation)
   m_animation = animation;
   m_time_accumulated = 0;
   m_frame = 0;
+  if (m_animation) m_start_time = m_animation->time();
 }
 
 //*****************************************************************************
@@ -161,41 +399,129 @@ void Sprite::set_orientation(float orientation)
 //*****************************************************************************
 void Sprite::update(float dt)
 {
-  if (m_animation && m_animating) {
+  if (m_animation && m_animating && !m_on_gpu) {
     m_time_accumulated += dt;
-    while (m_time_accumulated > m_animation->period()) {
-      m_time_accumulated -= m_animation->period();
-      m_frame = (m_frame + 1) % m_animation->frame_count();
-    }
+    advance_frame(
+      m_time_accumulated, 
+      m_frame, 
+      m_animation->period(), 
+      m_animation->frame_count()
+    );
   }
 }
 
+//*****************************************************************************
+void Sprite::animate_on_gpu()
+{
+  if (m_on_gpu) return;
+  m_on_gpu = true;
+  if (m_animation) m_start_time = m_animation->start_time_for(m_frame);
+}
+
 //*****************************************************************************
 void Sprite::draw()
 {
-  if (m_animation) {
-    m_animation->draw(m_frame, m_position, m_orientation);
+  draw_at(m_position, m_orientation);
+}
+
+//*****************************************************************************
+void Sprite::draw(SpriteBatch& batch)
+{
+  draw_at(batch, m_position, m_orientation);
+}
+
+//*****************************************************************************
+void Sprite::draw(CommandList& list)
+{
+  draw_at(list, m_position, m_orientation);
+}
+
+//*****************************************************************************
+void Sprite::save_state()
+{
+  m_previous_position = m_position;
+  m_previous_orientation = m_orientation;
+}
+
+//*****************************************************************************
+Vector2f Sprite::interpolated_position(float alpha) const
+{
+  return m_previous_position + (m_position - m_previous_position) * alpha;
+}
+
+//*****************************************************************************
+float Sprite::interpolated_orientation(float alpha) const
+{
+  return interpolate_angle(m_previous_orientation, m_orientation, alpha);
+}
+
+//*****************************************************************************
+void Sprite::draw(float alpha)
+{
+  draw_at(interpolated_position(alpha), interpolated_orientation(alpha));
+}
+
+//*****************************************************************************
+void Sprite::draw(SpriteBatch& batch, float alpha)
+{
+  draw_at(batch, interpolated_position(alpha), interpolated_orientation(alpha));
+}
+
+//*****************************************************************************
+void Sprite::draw(CommandList& list, float alpha)
+{
+  draw_at(list, interpolated_position(alpha), interpolated_orientation(alpha));
+}
+
+//*****************************************************************************
+void Sprite::draw_at(Vector2f position, float orientation)
+{
+  if (!m_animation) return;
+  if (m_on_gpu && m_animating) {
+    m_animation->draw_animated(m_start_time, position, orientation);
+  } else {
+    m_animation->draw(m_frame, position, orientation);
   }
 }
 
 //*****************************************************************************
-bool Sprite::contains(Vector2f point) const
+void Sprite::draw_at(SpriteBatch& batch, Vector2f position, float orientation)
 {
-  Vector2f rel = point - m_position;
-  Vector2i size = m_animation->size();
+  draw_at(batch.list(), position, orientation);
+}
 
-  return rel[0] >= 0 && rel[1] >= 0 && rel[0] <= size[0] && rel[1] <= size[1];
+//*****************************************************************************
+void Sprite::draw_at(CommandList& list, Vector2f position, float orientation)
+{
+  if (!m_animation) return;
+  if (m_on_gpu && m_animating) {
+    list.add_animated(*m_animation, m_start_time, position, orientation);
+  } else {
+    list.add(*m_animation, m_frame, position, orientation);
+  }
+}
+
+//*****************************************************************************
+bool Sprite::contains(Vector2f point) const
+{
+  if (!m_animation) return false;
+  OrientedBox box(m_position, m_animation->size().cast<float>(), m_orientation);
+  return box.contains(point);
 }
 
 //*****************************************************************************
 void Sprite::randomise_frame()
 {
-  m_frame = rand() % m_animation->frame_count();
+  set_frame(rand() % m_animation->frame_count());
 }
 
 //*****************************************************************************
 void Sprite::stop_animating()
 {
+  // Freeze a GPU animation on whatever frame it is showing.
+  if (m_on_gpu && m_animating && m_animation) {
+    m_frame = m_animation->frame_at(m_start_time);
+  }
   m_animating = false;
 }
 
@@ -203,4 +529,5 @@ void Sprite::stop_animating()
 void Sprite::set_frame(int frame)
 {
   m_frame = frame;
+  if (m_on_gpu && m_animation) m_start_time = m_animation->start_time_for(frame);
 }
@@ -0,0 +1,110 @@
+#include <graphics/SpriteBatch.hpp>
+#include <graphics/GraphicsSystem.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+//*****************************************************************************
+SpriteBatch::SpriteBatch(GraphicsSystem& gtok)
+  : GraphicsObject(gtok),
+    m_queue(gtok)
+{
+  m_queue.begin(1);
+}
+
+//*****************************************************************************
+void SpriteBatch::add(
+  Animation& animation,
+  int frame,
+  Vector2f position,
+  float orientation_radians
+)
+{
+  list().add(animation, frame, position, orientation_radians);
+}
+
+//*****************************************************************************
+void SpriteBatch::add_animated(
+  Animation& animation,
+  float start_time,
+  Vector2f position,
+  float orientation_radians
+)
+{
+  list().add_animated(animation, start_time, position, orientation_radians);
+}
+
+//*****************************************************************************
+void SpriteBatch::add(Animation& animation, const AnimationInstance& instance)
+{
+  list().add(animation, instance);
+}
+
+//*****************************************************************************
+CommandList& SpriteBatch::list()
+{
+  // Pick up the view once per batch, rather than per sprite, so that it
+  // follows the render target as it is when the batch starts being filled.
+  CommandList& list = m_queue.list(0);
+  if (list.size() == 0 && list.culled() == 0) {
+    list.set_view(m_queue.view_min(), m_queue.view_max());
+  }
+  return list;
+}
+
+//*****************************************************************************
+void SpriteBatch::set_view(Vector2f min, Vector2f max)
+{
+  m_queue.set_view(min, max);
+  m_queue.list(0).set_view(min, max);
+}
+
+//*****************************************************************************
+Vector2f SpriteBatch::view_min() const
+{
+  return m_queue.view_min();
+}
+
+//*****************************************************************************
+Vector2f SpriteBatch::view_max() const
+{
+  return m_queue.view_max();
+}
+
+//*****************************************************************************
+void SpriteBatch::count_culled(int count)
+{
+  list().count_culled(count);
+}
+
+//*****************************************************************************
+void SpriteBatch::draw()
+{
+  m_queue.submit();
+}
+
+//*****************************************************************************
+void SpriteBatch::clear()
+{
+  // Forget the groups entirely - the textures they are keyed on may not be
+  // around next time.
+  m_queue.clear();
+}
+
+//*****************************************************************************
+int SpriteBatch::size() const
+{
+  return static_cast<int>(m_queue.list(0).size());
+}
+
+//*****************************************************************************
+int SpriteBatch::draw_calls() const
+{
+  return m_queue.draw_calls();
+}
+
+//*****************************************************************************
+int SpriteBatch::culled() const
+{
+  return m_queue.culled();
+}
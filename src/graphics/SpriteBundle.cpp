@@ -0,0 +1,434 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <filesystem/FileData.hpp>
+
+#include <graphics/CompressedImage.hpp>
+#include <graphics/GraphicsSystem.hpp>
+#include <graphics/Image.hpp>
+#include <graphics/Sprite.hpp>
+#include <graphics/SpriteBundle.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+using namespace Eigen;
+
+//----- File layout
+
+namespace {
+
+  const char MAGIC[4] = { 'S', 'P', 'R', 'B' };
+  const uint32_t VERSION = 1;
+  const uint32_t MAX_LEVELS = 16;
+  const size_t ALIGNMENT = 64;
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t texture_count;
+    uint32_t animation_count;
+    uint64_t textures_offset;
+    uint64_t animations_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t file_size;
+  };
+
+  struct TextureRecord {
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    uint32_t level_count;
+    uint64_t level_offsets[MAX_LEVELS];
+    uint64_t level_sizes[MAX_LEVELS];
+  };
+
+  struct AnimationRecord {
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t texture;
+    int32_t min[2];
+    int32_t size[2];
+    int32_t frame_size[2];
+    int32_t frame_count;
+    float period;
+    uint32_t unused;
+  };
+
+  static_assert(sizeof(Header) == 56, "Header must be tightly packed");
+  static_assert(sizeof(TextureRecord) == 272, "TextureRecord must be tightly packed");
+  static_assert(sizeof(AnimationRecord) == 48, "AnimationRecord must be tightly packed");
+
+  //***************************************************************************
+  size_t align(size_t offset)
+  {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+
+  //***************************************************************************
+  bool valid_format(uint32_t format)
+  {
+    return format <= static_cast<uint32_t>(TextureFormat::BC7);
+  }
+
+  //***************************************************************************
+  bool valid_animation(const AnimationRecord& record, Vector2i texture_size)
+  {
+    // Everything Animation asserts, so that a bad record throws instead. The
+    // sums are done in 64 bits so that huge values can't wrap.
+    if (record.min[0] < 0 || record.min[1] < 0 ||
+        record.size[0] <= 0 || record.size[1] <= 0 ||
+        int64_t(record.min[0]) + record.size[0] > texture_size[0] ||
+        int64_t(record.min[1]) + record.size[1] > texture_size[1]) {
+      return false;
+    }
+    if (record.frame_size[0] <= 0 || record.frame_size[1] <= 0 ||
+        record.frame_count <= 0 || !(record.period > 0) ||
+        !std::isfinite(record.period)) {
+      return false;
+    }
+    int64_t columns = record.size[0] / record.frame_size[0];
+    int64_t rows = record.size[1] / record.frame_size[1];
+    return record.frame_count <= columns * rows;
+  }
+
+}
+
+
+//----- SpriteBundleWriter
+
+//*****************************************************************************
+SpriteBundleWriter::SpriteBundleWriter()
+{
+}
+
+//*****************************************************************************
+int SpriteBundleWriter::add_texture(
+  TextureFormat format,
+  Vector2i size,
+  std::vector<std::vector<unsigned char>> levels
+)
+{
+  if (levels.empty() || levels.size() > MAX_LEVELS) {
+    throw std::runtime_error("A bundled texture needs 1 to 16 levels");
+  }
+  for (size_t i = 0; i < levels.size(); ++i) {
+    Vector2i level_size = (size / (1 << i)).cwiseMax(1);
+    if (levels[i].size() != texture_byte_size(format, level_size)) {
+      throw std::runtime_error("Texture level is the wrong size for its format");
+    }
+  }
+
+  TextureEntry entry = { format, size, std::move(levels) };
+  m_textures.push_back(std::move(entry));
+  return int(m_textures.size()) - 1;
+}
+
+//*****************************************************************************
+int SpriteBundleWriter::add_texture(const CompressedImage& image)
+{
+  std::vector<std::vector<unsigned char>> levels;
+  for (int i = 0; i < image.level_count(); ++i) {
+    levels.push_back(image.level(i));
+  }
+  return add_texture(image.format(), image.size(), std::move(levels));
+}
+
+//*****************************************************************************
+int SpriteBundleWriter::add_texture(
+  const Image& image, 
+  TextureFormat format, 
+  bool mipmaps
+)
+{
+  if (is_compressed(format)) {
+    return add_texture(CompressedImage::encode(image, format, mipmaps));
+  }
+  std::vector<std::vector<unsigned char>> levels;
+  levels.push_back(pack_pixels(format, image.size(), image.data()));
+  if (mipmaps && image.size() != Vector2i(1, 1)) {
+    Image level = image.half_size();
+    while (true) {
+      levels.push_back(pack_pixels(format, level.size(), level.data()));
+      if (level.size() == Vector2i(1, 1)) break;
+      level = level.half_size();
+    }
+  }
+  return add_texture(format, image.size(), std::move(levels));
+}
+
+//*****************************************************************************
+void SpriteBundleWriter::add_animation(
+  const std::string& name,
+  int texture,
+  Vector2i min,
+  Vector2i size,
+  Vector2i frame_size,
+  int frame_count,
+  float period
+)
+{
+  if (texture < 0 || texture >= int(m_textures.size())) {
+    throw std::runtime_error("Animation " + name + " refers to a missing texture");
+  }
+  for (const AnimationEntry& existing : m_animations) {
+    if (existing.name == name) {
+      throw std::runtime_error("There is already an animation called " + name);
+    }
+  }
+
+  AnimationEntry entry = {
+    name, texture, min, size, frame_size, frame_count, period
+  };
+  m_animations.push_back(entry);
+}
+
+//*****************************************************************************
+void SpriteBundleWriter::save(Path filename) const
+//
+// Lay the file out in memory first, so the offsets are known when the
+// tables are written, then write it in one go.
+//*****************************************************************************
+{
+  std::string names;
+  for (const AnimationEntry& animation : m_animations) {
+    names += animation.name;
+  }
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.texture_count = uint32_t(m_textures.size());
+  header.animation_count = uint32_t(m_animations.size());
+  header.textures_offset = sizeof(Header);
+  header.animations_offset =
+    header.textures_offset + m_textures.size() * sizeof(TextureRecord);
+  header.names_offset =
+    header.animations_offset + m_animations.size() * sizeof(AnimationRecord);
+  header.names_size = names.size();
+
+  std::vector<TextureRecord> textures(m_textures.size());
+  size_t offset = align(header.names_offset + names.size());
+  for (size_t i = 0; i < m_textures.size(); ++i) {
+    const TextureEntry& entry = m_textures[i];
+    TextureRecord& record = textures[i];
+    std::memset(&record, 0, sizeof(record));
+    record.format = static_cast<uint32_t>(entry.format);
+    record.width = entry.size[0];
+    record.height = entry.size[1];
+    record.level_count = uint32_t(entry.levels.size());
+    for (size_t level = 0; level < entry.levels.size(); ++level) {
+      record.level_offsets[level] = offset;
+      record.level_sizes[level] = entry.levels[level].size();
+      offset = align(offset + entry.levels[level].size());
+    }
+  }
+  header.file_size = offset;
+
+  std::vector<AnimationRecord> animations(m_animations.size());
+  uint32_t name_offset = 0;
+  for (size_t i = 0; i < m_animations.size(); ++i) {
+    const AnimationEntry& entry = m_animations[i];
+    AnimationRecord& record = animations[i];
+    std::memset(&record, 0, sizeof(record));
+    record.name_offset = name_offset;
+    record.name_length = uint32_t(entry.name.size());
+    record.texture = uint32_t(entry.texture);
+    record.min[0] = entry.min[0];
+    record.min[1] = entry.min[1];
+    record.size[0] = entry.size[0];
+    record.size[1] = entry.size[1];
+    record.frame_size[0] = entry.frame_size[0];
+    record.frame_size[1] = entry.frame_size[1];
+    record.frame_count = entry.frame_count;
+    record.period = entry.period;
+    name_offset += record.name_length;
+  }
+
+  std::vector<unsigned char> file(header.file_size, 0);
+  std::memcpy(&file[0], &header, sizeof(header));
+  if (!textures.empty()) {
+    std::memcpy(&file[header.textures_offset], textures.data(),
+                textures.size() * sizeof(TextureRecord));
+  }
+  if (!animations.empty()) {
+    std::memcpy(&file[header.animations_offset], animations.data(),
+                animations.size() * sizeof(AnimationRecord));
+  }
+  if (!names.empty()) {
+    std::memcpy(&file[header.names_offset], names.data(), names.size());
+  }
+  for (size_t i = 0; i < m_textures.size(); ++i) {
+    const TextureEntry& entry = m_textures[i];
+    for (size_t level = 0; level < entry.levels.size(); ++level) {
+      std::memcpy(&file[textures[i].level_offsets[level]],
+                  entry.levels[level].data(), entry.levels[level].size());
+    }
+  }
+
+  std::ofstream out(filename.path().c_str(), std::ios::binary);
+  out.write(reinterpret_cast<const char*>(file.data()), file.size());
+  if (!out) {
+    throw std::runtime_error("Failed to write " + filename.path());
+  }
+}
+
+
+//----- SpriteBundle
+
+//*****************************************************************************
+SpriteBundle::SpriteBundle(GraphicsSystem& gtok, Path filename)
+//
+// Everything in the file is checked against its size before it's used, so a
+// truncated or corrupt bundle throws rather than reading off the end of the
+// mapping. OpenGL copies the pixels during glTexImage2D, so the mapping is
+// only needed until the textures are made. A bundle inside a pack is a view
+// into the pack's mapping; the blobs are still 64 byte aligned, as packs
+// align their files too.
+//*****************************************************************************
+  : GraphicsObject(gtok)
+{
+  FileData file(gtok.file_system(), filename, FileData::Mode::MAP);
+  const unsigned char* base = file.data();
+  std::string error = filename.path() + " is not a valid sprite bundle";
+
+  Header header;
+  if (file.size() < sizeof(header)) throw std::runtime_error(error);
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION ||
+      header.file_size != file.size()) {
+    throw std::runtime_error(error);
+  }
+
+  auto in_file = [&](uint64_t offset, uint64_t size) {
+    return offset <= file.size() && size <= file.size() - offset;
+  };
+  if (!in_file(header.textures_offset,
+               uint64_t(header.texture_count) * sizeof(TextureRecord)) ||
+      !in_file(header.animations_offset,
+               uint64_t(header.animation_count) * sizeof(AnimationRecord)) ||
+      !in_file(header.names_offset, header.names_size)) {
+    throw std::runtime_error(error);
+  }
+
+  for (uint32_t i = 0; i < header.texture_count; ++i) {
+    TextureRecord record;
+    std::memcpy(&record, 
+                base + header.textures_offset + i * sizeof(TextureRecord),
+                sizeof(record));
+    if (!valid_format(record.format) ||
+        record.level_count == 0 || record.level_count > MAX_LEVELS ||
+        record.width <= 0 || record.height <= 0) {
+      throw std::runtime_error(error);
+    }
+
+    TextureFormat format = static_cast<TextureFormat>(record.format);
+    Vector2i size(record.width, record.height);
+    std::vector<const void*> levels;
+    for (uint32_t level = 0; level < record.level_count; ++level) {
+      Vector2i level_size = (size / (1 << level)).cwiseMax(1);
+      if (record.level_sizes[level] != texture_byte_size(format, level_size) ||
+          !in_file(record.level_offsets[level], record.level_sizes[level])) {
+        throw std::runtime_error(error);
+      }
+      levels.push_back(base + record.level_offsets[level]);
+    }
+
+    // There's no BC7 decoder to fall back on, so let Texture throw.
+    if (Texture::supported(format) || format == TextureFormat::BC7) {
+      m_textures.push_back(std::make_shared<Texture>(
+        gtok, TextureTarget::TEXTURE_2D, format, size, levels
+      ));
+    } else {
+      // Rare enough that copying out of the mapping doesn't matter. Texture
+      // decompresses them, and format() then says RGBA8.
+      std::vector<std::vector<unsigned char>> copies;
+      for (uint32_t level = 0; level < record.level_count; ++level) {
+        const unsigned char* data = base + record.level_offsets[level];
+        copies.emplace_back(data, data + record.level_sizes[level]);
+      }
+      m_textures.push_back(std::make_shared<Texture>(
+        gtok, TextureTarget::TEXTURE_2D,
+        CompressedImage(format, size, std::move(copies))
+      ));
+    }
+  }
+
+  const char* names =
+    reinterpret_cast<const char*>(base + header.names_offset);
+  for (uint32_t i = 0; i < header.animation_count; ++i) {
+    AnimationRecord record;
+    std::memcpy(&record,
+                base + header.animations_offset + i * sizeof(AnimationRecord),
+                sizeof(record));
+    if (record.texture >= header.texture_count ||
+        record.name_offset > header.names_size ||
+        record.name_length > header.names_size - record.name_offset ||
+        !valid_animation(record, m_textures[record.texture]->size())) {
+      throw std::runtime_error(error);
+    }
+
+    std::string name(names + record.name_offset, record.name_length);
+    Entry entry;
+    entry.region.texture = m_textures[record.texture];
+    entry.region.min = Vector2i(record.min[0], record.min[1]);
+    entry.region.size = Vector2i(record.size[0], record.size[1]);
+    entry.animation = std::make_shared<Animation>(
+      gtok,
+      entry.region,
+      Vector2i(record.frame_size[0], record.frame_size[1]),
+      record.frame_count,
+      record.period
+    );
+    m_animations[name] = entry;
+  }
+}
+
+//*****************************************************************************
+SpriteBundle::~SpriteBundle()
+{
+}
+
+//*****************************************************************************
+const SpriteBundle::Entry& SpriteBundle::find(const std::string& name) const
+{
+  auto it = m_animations.find(name);
+  if (it == m_animations.end()) {
+    throw std::runtime_error("No animation called " + name + " in the bundle");
+  }
+  return it->second;
+}
+
+//*****************************************************************************
+bool SpriteBundle::has_animation(const std::string& name) const
+{
+  return m_animations.find(name) != m_animations.end();
+}
+
+//*****************************************************************************
+std::shared_ptr<Animation> SpriteBundle::animation(const std::string& name) const
+{
+  return find(name).animation;
+}
+
+//*****************************************************************************
+TextureRegion SpriteBundle::region(const std::string& name) const
+{
+  return find(name).region;
+}
+
+//*****************************************************************************
+int SpriteBundle::texture_count() const
+{
+  return int(m_textures.size());
+}
+
+//*****************************************************************************
+std::shared_ptr<Texture> SpriteBundle::texture(int index) const
+{
+  return m_textures[index];
+}
@@ -0,0 +1,862 @@
+#include <assert.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <graphics/SpriteWorld.hpp>
+#include <graphics/CommandList.hpp>
+#include <graphics/SpriteBatch.hpp>
+
+#include <jobs/JobSystem.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+// Sprites per job. Big enough that the overhead of a job is lost in the
+// noise, and a multiple of four so that only the last job has an SSE tail.
+static const size_t SPRITES_PER_JOB = 4096;
+
+//----- SpriteWorld
+
+//*****************************************************************************
+SpriteWorld::SpriteWorld(float grid_cell_size)
+  : m_cpu_count(0),
+    m_grid(grid_cell_size)
+{
+}
+
+//*****************************************************************************
+SpriteHandle SpriteWorld::create()
+{
+  uint32_t slot;
+  if (m_free_slots.empty()) {
+    slot = m_slot_dense.size();
+    m_slot_dense.push_back(0);
+    m_slot_generation.push_back(1);
+  } else {
+    slot = m_free_slots.back();
+    m_free_slots.pop_back();
+  }
+
+  m_slot_dense[slot] = m_dense_slot.size();
+  m_dense_slot.push_back(slot);
+  m_x.push_back(0);
+  m_y.push_back(0);
+  m_orientation.push_back(0);
+  m_previous_x.push_back(0);
+  m_previous_y.push_back(0);
+  m_previous_orientation.push_back(0);
+  m_time_accumulated.push_back(0);
+  m_frame.push_back(0);
+  m_animation.push_back(-1);
+  m_period.push_back(1);
+  m_frame_count.push_back(1);
+  m_rate.push_back(0);
+  m_animating.push_back(1);
+  m_half_width.push_back(0);
+  m_half_height.push_back(0);
+  m_extent_x.push_back(0);
+  m_extent_y.push_back(0);
+  m_start_time.push_back(0);
+
+  // New sprites animate on the CPU, so they go at the end of that range.
+  swap_sprites(m_dense_slot.size() - 1, m_cpu_count++);
+
+  return SpriteHandle(slot, m_slot_generation[slot]);
+}
+
+//*****************************************************************************
+void SpriteWorld::destroy(SpriteHandle sprite)
+{
+  uint32_t index = dense(sprite);
+  release_animation(m_animation[index]);
+  m_grid.remove(sprite.index);
+
+  // Move the sprite to the end of its range, and then to the end of the
+  // arrays, keeping the ranges contiguous.
+  if (index < m_cpu_count) {
+    swap_sprites(index, --m_cpu_count);
+    index = m_cpu_count;
+  }
+  swap_sprites(index, m_dense_slot.size() - 1);
+
+  m_dense_slot.pop_back();
+  m_x.pop_back();
+  m_y.pop_back();
+  m_orientation.pop_back();
+  m_previous_x.pop_back();
+  m_previous_y.pop_back();
+  m_previous_orientation.pop_back();
+  m_time_accumulated.pop_back();
+  m_frame.pop_back();
+  m_animation.pop_back();
+  m_period.pop_back();
+  m_frame_count.pop_back();
+  m_rate.pop_back();
+  m_animating.pop_back();
+  m_half_width.pop_back();
+  m_half_height.pop_back();
+  m_extent_x.pop_back();
+  m_extent_y.pop_back();
+  m_start_time.pop_back();
+
+  // Skip 0 when wrapping around; it means "no sprite".
+  if (++m_slot_generation[sprite.index] == 0) m_slot_generation[sprite.index] = 1;
+  m_free_slots.push_back(sprite.index);
+}
+
+//*****************************************************************************
+void SpriteWorld::swap_sprites(uint32_t a, uint32_t b)
+{
+  if (a == b) return;
+
+  std::swap(m_dense_slot[a], m_dense_slot[b]);
+  std::swap(m_x[a], m_x[b]);
+  std::swap(m_y[a], m_y[b]);
+  std::swap(m_orientation[a], m_orientation[b]);
+  std::swap(m_previous_x[a], m_previous_x[b]);
+  std::swap(m_previous_y[a], m_previous_y[b]);
+  std::swap(m_previous_orientation[a], m_previous_orientation[b]);
+  std::swap(m_time_accumulated[a], m_time_accumulated[b]);
+  std::swap(m_frame[a], m_frame[b]);
+  std::swap(m_animation[a], m_animation[b]);
+  std::swap(m_period[a], m_period[b]);
+  std::swap(m_frame_count[a], m_frame_count[b]);
+  std::swap(m_rate[a], m_rate[b]);
+  std::swap(m_animating[a], m_animating[b]);
+  std::swap(m_half_width[a], m_half_width[b]);
+  std::swap(m_half_height[a], m_half_height[b]);
+  std::swap(m_extent_x[a], m_extent_x[b]);
+  std::swap(m_extent_y[a], m_extent_y[b]);
+  std::swap(m_start_time[a], m_start_time[b]);
+
+  m_slot_dense[m_dense_slot[a]] = a;
+  m_slot_dense[m_dense_slot[b]] = b;
+}
+
+//*****************************************************************************
+bool SpriteWorld::on_gpu(uint32_t index) const
+{
+  return index >= m_cpu_count;
+}
+
+//*****************************************************************************
+bool SpriteWorld::alive(SpriteHandle sprite) const
+{
+  return sprite.index < m_slot_generation.size() &&
+         sprite.generation == m_slot_generation[sprite.index];
+}
+
+//*****************************************************************************
+uint32_t SpriteWorld::dense(SpriteHandle sprite) const
+{
+  assert(alive(sprite));
+  return m_slot_dense[sprite.index];
+}
+
+//*****************************************************************************
+int SpriteWorld::size() const
+{
+  return m_dense_slot.size();
+}
+
+//*****************************************************************************
+SpriteView SpriteWorld::view(SpriteHandle sprite)
+{
+  return SpriteView(*this, sprite);
+}
+
+//*****************************************************************************
+int SpriteWorld::acquire_animation(std::shared_ptr<Animation> animation)
+{
+  if (!animation) return -1;
+
+  auto it = m_animation_ids.find(animation.get());
+  if (it != m_animation_ids.end()) {
+    ++m_animation_users[it->second];
+    return it->second;
+  }
+
+  int id;
+  if (m_free_animations.empty()) {
+    id = m_animations.size();
+    m_animations.push_back(animation);
+    m_animation_users.push_back(1);
+  } else {
+    id = m_free_animations.back();
+    m_free_animations.pop_back();
+    m_animations[id] = animation;
+    m_animation_users[id] = 1;
+  }
+  m_animation_ids[animation.get()] = id;
+  return id;
+}
+
+//*****************************************************************************
+void SpriteWorld::release_animation(int id)
+{
+  if (id < 0 || --m_animation_users[id] > 0) return;
+
+  m_animation_ids.erase(m_animations[id].get());
+  m_animations[id].reset();
+  m_free_animations.push_back(id);
+}
+
+//*****************************************************************************
+void SpriteWorld::set_animation(
+  SpriteHandle sprite,
+  std::shared_ptr<Animation> animation
+)
+{
+  uint32_t index = dense(sprite);
+
+  // Acquire first in case it's the same animation again.
+  int id = acquire_animation(animation);
+  release_animation(m_animation[index]);
+  m_animation[index] = id;
+
+  m_time_accumulated[index] = 0;
+  m_frame[index] = 0;
+  m_start_time[index] = animation ? animation->time() : 0;
+  m_period[index] = animation ? animation->period() : 1;
+  m_frame_count[index] = animation ? animation->frame_count() : 1;
+  // A sprite that has stopped animating stays stopped, as with Sprite.
+  m_rate[index] = animation && m_animating[index] ? 1.0f : 0.0f;
+
+  Vector2f half_size = animation 
+    ? Vector2f(animation->size().cast<float>() * 0.5f) 
+    : Vector2f(0, 0);
+  m_half_width[index] = half_size[0];
+  m_half_height[index] = half_size[1];
+  set_extents(index);
+  reindex(index);
+}
+
+//*****************************************************************************
+Vector2f SpriteWorld::position(SpriteHandle sprite) const
+{
+  uint32_t index = dense(sprite);
+  return Vector2f(m_x[index], m_y[index]);
+}
+
+//*****************************************************************************
+void SpriteWorld::set_position(SpriteHandle sprite, Vector2f position)
+{
+  uint32_t index = dense(sprite);
+  m_x[index] = position[0];
+  m_y[index] = position[1];
+  reindex(index);
+}
+
+//*****************************************************************************
+float SpriteWorld::orientation(SpriteHandle sprite) const
+{
+  return m_orientation[dense(sprite)];
+}
+
+//*****************************************************************************
+void SpriteWorld::set_orientation(SpriteHandle sprite, float orientation)
+{
+  uint32_t index = dense(sprite);
+  m_orientation[index] = orientation;
+  set_extents(index);
+  reindex(index);
+}
+
+//*****************************************************************************
+void SpriteWorld::set_extents(uint32_t index)
+{
+  float c = std::abs(std::cos(m_orientation[index]));
+  float s = std::abs(std::sin(m_orientation[index]));
+  m_extent_x[index] = c * m_half_width[index] + s * m_half_height[index];
+  m_extent_y[index] = s * m_half_width[index] + c * m_half_height[index];
+}
+
+//*****************************************************************************
+int SpriteWorld::frame(SpriteHandle sprite) const
+{
+  uint32_t index = dense(sprite);
+  if (on_gpu(index) && m_animating[index] && m_animation[index] >= 0) {
+    return m_animations[m_animation[index]]->frame_at(m_start_time[index]);
+  }
+  return m_frame[index];
+}
+
+//*****************************************************************************
+void SpriteWorld::set_frame(SpriteHandle sprite, int frame)
+{
+  uint32_t index = dense(sprite);
+  m_frame[index] = frame;
+  if (on_gpu(index) && m_animation[index] >= 0) {
+    m_start_time[index] = m_animations[m_animation[index]]->start_time_for(frame);
+  }
+}
+
+//*****************************************************************************
+void SpriteWorld::randomise_frame(SpriteHandle sprite)
+{
+  set_frame(sprite, rand() % m_frame_count[dense(sprite)]);
+}
+
+//*****************************************************************************
+void SpriteWorld::stop_animating(SpriteHandle sprite)
+{
+  // Freeze a GPU animation on whatever frame it is showing.
+  int current = frame(sprite);
+  uint32_t index = dense(sprite);
+  m_frame[index] = current;
+  m_animating[index] = 0;
+  m_rate[index] = 0;
+}
+
+//*****************************************************************************
+void SpriteWorld::animate_on_gpu(SpriteHandle sprite, bool gpu)
+{
+  uint32_t index = dense(sprite);
+  if (on_gpu(index) == gpu) return;
+
+  if (gpu) {
+    // Carry on from the current frame.
+    if (m_animation[index] >= 0) {
+      m_start_time[index] = 
+        m_animations[m_animation[index]]->start_time_for(m_frame[index]);
+    }
+    swap_sprites(index, --m_cpu_count);
+  } else {
+    m_frame[index] = frame(sprite);
+    m_time_accumulated[index] = 0;
+    swap_sprites(index, m_cpu_count++);
+  }
+}
+
+//*****************************************************************************
+bool SpriteWorld::animated_on_gpu(SpriteHandle sprite) const
+{
+  return on_gpu(dense(sprite));
+}
+
+//*****************************************************************************
+bool SpriteWorld::contains(SpriteHandle sprite, Vector2f point) const
+{
+  uint32_t index = dense(sprite);
+  if (m_animation[index] < 0) return false;
+  return box(index).contains(point);
+}
+
+//*****************************************************************************
+OrientedBox SpriteWorld::box(uint32_t index) const
+{
+  return OrientedBox(
+    Vector2f(m_x[index], m_y[index]),
+    m_animations[m_animation[index]]->size().cast<float>(),
+    m_orientation[index]
+  );
+}
+
+//*****************************************************************************
+void SpriteWorld::reindex(uint32_t index)
+{
+  uint32_t slot = m_dense_slot[index];
+  if (m_animation[index] < 0) {
+    m_grid.remove(slot);
+    return;
+  }
+
+  OrientedBox bounds = box(index);
+  m_grid.update(slot, bounds.min(), bounds.max());
+}
+
+//*****************************************************************************
+std::vector<SpriteHandle> SpriteWorld::pick(Vector2f point) const
+{
+  m_candidates.clear();
+  m_grid.query(point, point, m_candidates);
+
+  // Swap the candidates' slots for dense indices, keeping the real hits.
+  size_t hits = 0;
+  for (uint32_t slot : m_candidates) {
+    uint32_t index = m_slot_dense[slot];
+    if (box(index).contains(point)) m_candidates[hits++] = index;
+  }
+  m_candidates.resize(hits);
+  return sorted_hits(m_candidates);
+}
+
+//*****************************************************************************
+std::vector<SpriteHandle> SpriteWorld::query(Vector2f min, Vector2f max) const
+{
+  m_candidates.clear();
+  m_grid.query(min, max, m_candidates);
+
+  size_t hits = 0;
+  for (uint32_t slot : m_candidates) {
+    uint32_t index = m_slot_dense[slot];
+    if (box(index).overlaps(min, max)) m_candidates[hits++] = index;
+  }
+  m_candidates.resize(hits);
+  return sorted_hits(m_candidates);
+}
+
+//*****************************************************************************
+std::vector<SpriteHandle> SpriteWorld::sorted_hits(
+  std::vector<uint32_t>& indices
+) const
+//
+// draw() goes through the arrays in order, and a batch draws each texture's
+// sprites in that order, starting the texture at the first sprite of it that
+// was drawn. So rank the textures that were hit by the first sprite of each
+// that the last draw() drew - which can't come after the first one hit, so
+// only the arrays up to there need looking at - and list the hits a texture
+// at a time. Sprites added since the last draw() count as drawn.
+//*****************************************************************************
+{
+  std::sort(indices.begin(), indices.end());
+
+  std::vector<std::pair<uint32_t, const Texture*>> textures;
+  for (uint32_t index : indices) {
+    const Texture* texture = &m_animations[m_animation[index]]->texture();
+    bool seen = false;
+    for (const auto& t : textures) seen = seen || t.second == texture;
+    if (!seen) textures.push_back(std::make_pair(index, texture));
+  }
+
+  if (textures.size() > 1) {
+    for (uint32_t i = 0; i < textures.back().first; ++i) {
+      if (m_animation[i] < 0) continue;
+      if (i < m_visible.size() && !m_visible[i]) continue;
+      const Texture* texture = &m_animations[m_animation[i]]->texture();
+      for (auto& t : textures) {
+        if (t.second == texture && i < t.first) t.first = i;
+      }
+    }
+    std::sort(textures.begin(), textures.end());
+  }
+
+  std::vector<SpriteHandle> ret;
+  ret.reserve(indices.size());
+  for (const auto& t : textures) {
+    for (uint32_t index : indices) {
+      if (&m_animations[m_animation[index]]->texture() != t.second) continue;
+      uint32_t slot = m_dense_slot[index];
+      ret.push_back(SpriteHandle(slot, m_slot_generation[slot]));
+    }
+  }
+  return ret;
+}
+
+//*****************************************************************************
+void SpriteWorld::update(float dt)
+{
+  update_range(0, m_cpu_count, dt);
+}
+
+//*****************************************************************************
+void SpriteWorld::update(float dt, jobs::JobSystem& jobs)
+{
+  // Sprites are independent, so any split will do.
+  jobs.parallel_for(0, m_cpu_count, SPRITES_PER_JOB,
+    [this, dt](size_t begin, size_t end) { update_range(begin, end, dt); }
+  );
+}
+
+//*****************************************************************************
+void SpriteWorld::update_range(size_t begin, size_t end, float dt)
+//
+// The same sums as advance_frame(), but without any branches so that they can
+// be done on several sprites at once. Time is only accumulated while the
+// rate is 1, and the frame wraps with a floating point modulo - exact, since
+// frame numbers are nowhere near big enough to lose precision.
+//*****************************************************************************
+{
+  float* accumulated = m_time_accumulated.data();
+  int32_t* frames = m_frame.data();
+  const float* periods = m_period.data();
+  const int32_t* frame_counts = m_frame_count.data();
+  const float* rates = m_rate.data();
+
+  size_t i = begin;
+
+#if defined(__SSE2__)
+  const __m128 dt4 = _mm_set1_ps(dt);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  for (; i + 4 <= end; i += 4) {
+    __m128 period = _mm_loadu_ps(periods + i);
+    __m128 acc = _mm_add_ps(
+      _mm_loadu_ps(accumulated + i),
+      _mm_mul_ps(dt4, _mm_loadu_ps(rates + i))
+    );
+
+    // Whole periods elapsed. Everything is non-negative, so truncating is
+    // the same as flooring. As in advance_frame(), an exact multiple keeps a
+    // period back, and nothing moves unless more than a period is left.
+    __m128 steps = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_div_ps(acc, period)));
+    steps = _mm_sub_ps(
+      steps, _mm_and_ps(_mm_cmpge_ps(_mm_mul_ps(steps, period), acc), one)
+    );
+    steps = _mm_and_ps(steps, _mm_cmpgt_ps(acc, period));
+    acc = _mm_max_ps(_mm_sub_ps(acc, _mm_mul_ps(steps, period)), zero);
+
+    __m128 frame_count = _mm_cvtepi32_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame_counts + i))
+    );
+    __m128 frame = _mm_add_ps(
+      _mm_cvtepi32_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(frames + i))
+      ),
+      steps
+    );
+    __m128 wraps = _mm_cvtepi32_ps(
+      _mm_cvttps_epi32(_mm_div_ps(frame, frame_count))
+    );
+    frame = _mm_sub_ps(frame, _mm_mul_ps(wraps, frame_count));
+
+    // Fix up any rounding that left the frame just out of range.
+    frame = _mm_add_ps(frame, _mm_and_ps(_mm_cmplt_ps(frame, zero), frame_count));
+    frame = _mm_sub_ps(frame, _mm_and_ps(_mm_cmpge_ps(frame, frame_count), frame_count));
+
+    _mm_storeu_ps(accumulated + i, acc);
+    _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(frames + i),
+      _mm_cvttps_epi32(frame)
+    );
+  }
+#endif
+
+  for (; i < end; ++i) {
+    accumulated[i] += dt * rates[i];
+    int frame = frames[i];
+    advance_frame(accumulated[i], frame, periods[i], frame_counts[i]);
+    frames[i] = frame;
+  }
+}
+
+//*****************************************************************************
+void SpriteWorld::cull(
+  Vector2f view_min,
+  Vector2f view_max,
+  const float* x,
+  const float* y,
+  size_t begin,
+  size_t end
+) const
+//
+// A sprite is visible if its bounds overlap the view. Its bounds are centred
+// on (x + half width, y + half height) and extend by the rotated extents, so
+// this is a comparison of centres against the sum of half sizes. Kept free of
+// branches so that it can be done on several sprites at once.
+//*****************************************************************************
+{
+  const float view_centre_x = (view_min[0] + view_max[0]) * 0.5f;
+  const float view_centre_y = (view_min[1] + view_max[1]) * 0.5f;
+  const float view_half_x = (view_max[0] - view_min[0]) * 0.5f;
+  const float view_half_y = (view_max[1] - view_min[1]) * 0.5f;
+
+  size_t i = begin;
+
+#if defined(__SSE2__)
+  const __m128 centre_x = _mm_set1_ps(view_centre_x);
+  const __m128 centre_y = _mm_set1_ps(view_centre_y);
+  const __m128 half_x = _mm_set1_ps(view_half_x);
+  const __m128 half_y = _mm_set1_ps(view_half_y);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  for (; i + 4 <= end; i += 4) {
+    __m128 dx = _mm_sub_ps(
+      _mm_add_ps(_mm_loadu_ps(&x[i]), _mm_loadu_ps(&m_half_width[i])),
+      centre_x
+    );
+    __m128 dy = _mm_sub_ps(
+      _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_loadu_ps(&m_half_height[i])),
+      centre_y
+    );
+    __m128 visible = _mm_and_ps(
+      _mm_cmple_ps(
+        _mm_andnot_ps(sign, dx),
+        _mm_add_ps(_mm_loadu_ps(&m_extent_x[i]), half_x)
+      ),
+      _mm_cmple_ps(
+        _mm_andnot_ps(sign, dy),
+        _mm_add_ps(_mm_loadu_ps(&m_extent_y[i]), half_y)
+      )
+    );
+
+    int mask = _mm_movemask_ps(visible);
+    m_visible[i] = mask & 1;
+    m_visible[i + 1] = (mask >> 1) & 1;
+    m_visible[i + 2] = (mask >> 2) & 1;
+    m_visible[i + 3] = (mask >> 3) & 1;
+  }
+#endif
+
+  for (; i < end; ++i) {
+    float dx = std::abs(x[i] + m_half_width[i] - view_centre_x);
+    float dy = std::abs(y[i] + m_half_height[i] - view_centre_y);
+    m_visible[i] = dx <= m_extent_x[i] + view_half_x && 
+                   dy <= m_extent_y[i] + view_half_y;
+  }
+}
+
+//*****************************************************************************
+AnimationInstance SpriteWorld::instance(
+  uint32_t index,
+  float x,
+  float y,
+  float orientation
+) const
+{
+  const Animation& animation = *m_animations[m_animation[index]];
+  Vector2f position(x, y);
+  if (on_gpu(index) && m_animating[index]) {
+    return animation.animated_instance(m_start_time[index], position, orientation);
+  }
+  return animation.instance(m_frame[index], position, orientation);
+}
+
+//*****************************************************************************
+void SpriteWorld::save_state()
+{
+  m_previous_x = m_x;
+  m_previous_y = m_y;
+  m_previous_orientation = m_orientation;
+}
+
+//*****************************************************************************
+void SpriteWorld::interpolate(float alpha, size_t begin, size_t end) const
+{
+  // Straight down the arrays, so the compiler can vectorise the positions.
+  for (size_t i = begin; i < end; ++i) {
+    m_draw_x[i] = m_previous_x[i] + (m_x[i] - m_previous_x[i]) * alpha;
+    m_draw_y[i] = m_previous_y[i] + (m_y[i] - m_previous_y[i]) * alpha;
+  }
+  for (size_t i = begin; i < end; ++i) {
+    m_draw_orientation[i] = 
+      interpolate_angle(m_previous_orientation[i], m_orientation[i], alpha);
+  }
+}
+
+//*****************************************************************************
+void SpriteWorld::draw(SpriteBatch& batch) const
+{
+  draw(batch, 1.0f);
+}
+
+//*****************************************************************************
+void SpriteWorld::draw(SpriteBatch& batch, float alpha) const
+{
+  const size_t count = m_dense_slot.size();
+  m_visible.resize(count);
+
+  // At the current state there's nothing to work out.
+  const bool current = alpha >= 1;
+  if (!current) {
+    m_draw_x.resize(count);
+    m_draw_y.resize(count);
+    m_draw_orientation.resize(count);
+    interpolate(alpha, 0, count);
+  }
+  const float* x = current ? m_x.data() : m_draw_x.data();
+  const float* y = current ? m_y.data() : m_draw_y.data();
+  const float* orientation = current ? m_orientation.data() : m_draw_orientation.data();
+
+  cull(batch.view_min(), batch.view_max(), x, y, 0, count);
+
+  int culled = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (m_animation[i] < 0) continue;
+    if (!m_visible[i]) {
+      ++culled;
+      continue;
+    }
+    batch.add(*m_animations[m_animation[i]], instance(i, x[i], y[i], orientation[i]));
+  }
+  batch.count_culled(culled);
+}
+
+//*****************************************************************************
+void SpriteWorld::draw(SpriteBatch& batch, jobs::JobSystem& jobs) const
+{
+  draw(batch, 1.0f, jobs);
+}
+
+//*****************************************************************************
+void SpriteWorld::draw(
+  SpriteBatch& batch,
+  float alpha,
+  jobs::JobSystem& jobs
+) const
+{
+  // Culling and working out the instances are the expensive bits, so do
+  // those in parallel, with a slot for every sprite so that the jobs never
+  // have to agree on where to write. Sprites that aren't drawn leave their
+  // slot unused.
+  const size_t count = m_dense_slot.size();
+  const Vector2f view_min = batch.view_min();
+  const Vector2f view_max = batch.view_max();
+  m_visible.resize(count);
+  m_instances.resize(count);
+
+  const bool current = alpha >= 1;
+  if (!current) {
+    m_draw_x.resize(count);
+    m_draw_y.resize(count);
+    m_draw_orientation.resize(count);
+  }
+  const float* x = current ? m_x.data() : m_draw_x.data();
+  const float* y = current ? m_y.data() : m_draw_y.data();
+  const float* orientation = current ? m_orientation.data() : m_draw_orientation.data();
+
+  std::atomic<int> culled(0);
+  jobs.parallel_for(0, count, SPRITES_PER_JOB,
+    [&](size_t begin, size_t end) {
+      if (!current) interpolate(alpha, begin, end);
+      cull(view_min, view_max, x, y, begin, end);
+
+      int culled_here = 0;
+      for (size_t i = begin; i < end; ++i) {
+        if (m_animation[i] < 0) continue;
+        if (!m_visible[i]) {
+          ++culled_here;
+          continue;
+        }
+        m_instances[i] = instance(i, x[i], y[i], orientation[i]);
+      }
+      culled += culled_here;
+    }
+  );
+
+  // Adding them to the batch isn't thread safe, but it is just a copy.
+  for (size_t i = 0; i < count; ++i) {
+    if (m_animation[i] < 0 || !m_visible[i]) continue;
+    batch.add(*m_animations[m_animation[i]], m_instances[i]);
+  }
+  batch.count_culled(culled);
+}
+
+//*****************************************************************************
+void SpriteWorld::draw(
+  CommandQueue& queue,
+  float alpha,
+  jobs::JobSystem& jobs
+) const
+{
+  // parallel_for() splits the range every SPRITES_PER_JOB sprites, so each
+  // piece knows which list is its own.
+  const size_t count = m_dense_slot.size();
+  queue.begin((count + SPRITES_PER_JOB - 1) / SPRITES_PER_JOB);
+  const Vector2f view_min = queue.view_min();
+  const Vector2f view_max = queue.view_max();
+  m_visible.resize(count);
+
+  const bool current = alpha >= 1;
+  if (!current) {
+    m_draw_x.resize(count);
+    m_draw_y.resize(count);
+    m_draw_orientation.resize(count);
+  }
+  const float* x = current ? m_x.data() : m_draw_x.data();
+  const float* y = current ? m_y.data() : m_draw_y.data();
+  const float* orientation = current ? m_orientation.data() : m_draw_orientation.data();
+
+  jobs.parallel_for(0, count, SPRITES_PER_JOB,
+    [&](size_t begin, size_t end) {
+      if (!current) interpolate(alpha, begin, end);
+      cull(view_min, view_max, x, y, begin, end);
+
+      CommandList& list = queue.list(begin / SPRITES_PER_JOB);
+      int culled = 0;
+      for (size_t i = begin; i < end; ++i) {
+        if (m_animation[i] < 0) continue;
+        if (!m_visible[i]) {
+          ++culled;
+          continue;
+        }
+        list.add(
+          *m_animations[m_animation[i]],
+          instance(i, x[i], y[i], orientation[i])
+        );
+      }
+      list.count_culled(culled);
+    }
+  );
+}
+
+//----- SpriteView
+
+//*****************************************************************************
+SpriteView::SpriteView(SpriteWorld& world, SpriteHandle sprite)
+  : m_world(&world),
+    m_sprite(sprite)
+{
+}
+
+//*****************************************************************************
+SpriteHandle SpriteView::handle() const
+{
+  return m_sprite;
+}
+
+//*****************************************************************************
+void SpriteView::stop_animating()
+{
+  m_world->stop_animating(m_sprite);
+}
+
+//*****************************************************************************
+void SpriteView::set_animation(std::shared_ptr<Animation> animation)
+{
+  m_world->set_animation(m_sprite, animation);
+}
+
+//*****************************************************************************
+Vector2f SpriteView::position() const
+{
+  return m_world->position(m_sprite);
+}
+
+//*****************************************************************************
+void SpriteView::set_position(Vector2f position)
+{
+  m_world->set_position(m_sprite, position);
+}
+
+//*****************************************************************************
+float SpriteView::orientation() const
+{
+  return m_world->orientation(m_sprite);
+}
+
+//*****************************************************************************
+void SpriteView::set_orientation(float orientation)
+{
+  m_world->set_orientation(m_sprite, orientation);
+}
+
+//*****************************************************************************
+bool SpriteView::contains(Vector2f point) const
+{
+  return m_world->contains(m_sprite, point);
+}
+
+//*****************************************************************************
+void SpriteView::randomise_frame()
+{
+  m_world->randomise_frame(m_sprite);
+}
+
+//*****************************************************************************
+void SpriteView::set_frame(int frame)
+{
+  m_world->set_frame(m_sprite, frame);
+}
+
+//*****************************************************************************
+void SpriteView::animate_on_gpu()
+{
+  m_world->animate_on_gpu(m_sprite);
+}
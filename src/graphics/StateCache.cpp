@@ -0,0 +1,160 @@
+#include <graphics/StateCache.hpp>
+
+using namespace graphics;
+
+//*****************************************************************************
+StateCache::StateCache()
+  : m_program(0),
+    m_vertex_array(0),
+    m_framebuffer(0),
+    m_active_unit(0),
+    m_skipped(0),
+    m_issued(0),
+    m_skipped_last_frame(0),
+    m_issued_last_frame(0)
+{
+  // A fresh context has nothing bound, which is exactly what the defaults
+  // above say.
+}
+
+//*****************************************************************************
+bool StateCache::skip(bool redundant)
+{
+  if (redundant) ++m_skipped;
+  else           ++m_issued;
+  return redundant;
+}
+
+//*****************************************************************************
+void StateCache::use_program(GLuint id)
+{
+  if (skip(m_program == id)) return;
+  glUseProgram(id);
+  m_program = id;
+}
+
+//*****************************************************************************
+void StateCache::bind_vertex_array(GLuint id)
+{
+  if (skip(m_vertex_array == id)) return;
+  glBindVertexArray(id);
+  m_vertex_array = id;
+}
+
+//*****************************************************************************
+void StateCache::bind_buffer(GLenum target, GLuint id)
+{
+  // Note that the element array binding belongs to the vertex array, so it
+  // must not be tracked here.
+  auto it = m_buffers.find(target);
+  if (skip(it != m_buffers.end() && it->second == id)) return;
+  glBindBuffer(target, id);
+  m_buffers[target] = id;
+}
+
+//*****************************************************************************
+void StateCache::bind_texture(GLenum target, GLuint id, int unit)
+{
+  if (unit >= static_cast<int>(m_textures.size())) m_textures.resize(unit + 1);
+
+  auto& bindings = m_textures[unit];
+  auto it = bindings.find(target);
+  if (skip(it != bindings.end() && it->second == id)) return;
+
+  if (m_active_unit != unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    m_active_unit = unit;
+  }
+  glBindTexture(target, id);
+  bindings[target] = id;
+}
+
+//*****************************************************************************
+void StateCache::bind_framebuffer(GLuint id)
+{
+  // Binds both the draw and read framebuffers; nothing here uses them
+  // separately.
+  if (skip(m_framebuffer == id)) return;
+  glBindFramebuffer(GL_FRAMEBUFFER, id);
+  m_framebuffer = id;
+}
+
+//*****************************************************************************
+void StateCache::forget_program(GLuint id)
+{
+  if (m_program == id) m_program = UNKNOWN;
+}
+
+//*****************************************************************************
+void StateCache::forget_vertex_array(GLuint id)
+{
+  if (m_vertex_array == id) m_vertex_array = UNKNOWN;
+}
+
+//*****************************************************************************
+void StateCache::forget_buffer(GLuint id)
+{
+  for (auto& binding : m_buffers) {
+    if (binding.second == id) binding.second = UNKNOWN;
+  }
+}
+
+//*****************************************************************************
+void StateCache::forget_texture(GLuint id)
+{
+  for (auto& bindings : m_textures) {
+    for (auto& binding : bindings) {
+      if (binding.second == id) binding.second = UNKNOWN;
+    }
+  }
+}
+
+//*****************************************************************************
+void StateCache::forget_framebuffer(GLuint id)
+{
+  if (m_framebuffer == id) m_framebuffer = UNKNOWN;
+}
+
+//*****************************************************************************
+void StateCache::invalidate()
+{
+  m_program = UNKNOWN;
+  m_vertex_array = UNKNOWN;
+  m_framebuffer = UNKNOWN;
+  m_buffers.clear();
+  m_textures.clear();
+  m_active_unit = -1;
+}
+
+//*****************************************************************************
+void StateCache::end_frame()
+{
+  m_skipped_last_frame = m_skipped;
+  m_issued_last_frame = m_issued;
+  m_skipped = 0;
+  m_issued = 0;
+}
+
+//*****************************************************************************
+int StateCache::skipped_binds() const
+{
+  return m_skipped;
+}
+
+//*****************************************************************************
+int StateCache::issued_binds() const
+{
+  return m_issued;
+}
+
+//*****************************************************************************
+int StateCache::skipped_binds_last_frame() const
+{
+  return m_skipped_last_frame;
+}
+
+//*****************************************************************************
+int StateCache::issued_binds_last_frame() const
+{
+  return m_issued_last_frame;
+}
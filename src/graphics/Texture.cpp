@@ -2,54 +2,565 @@
  * Implementation of Texture class and helpers.
  */
 
+#include <assert.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <mutex>
 #include <stdexcept>
-#include <stbimage/stb_image.h>
+#include <vector>
 
 #include <graphics/Texture.hpp>
+#include <graphics/Image.hpp>
+#include <graphics/CompressedImage.hpp>
+#include <graphics/GraphicsSystem.hpp>
 
 using namespace graphics;
 using namespace filesystem;
 using namespace Eigen;
 
+//----- Helpers
+
+/*****************************************************************************/
+static bool has_extension(const Path& path, const std::string& extension)
+{
+  const std::string& name = path.path();
+  if (name.size() < extension.size()) return false;
+  std::string end = name.substr(name.size() - extension.size());
+  std::transform(end.begin(), end.end(), end.begin(), ::tolower);
+  return end == extension;
+}
+
+/*****************************************************************************/
+static GLenum internal_format(TextureFormat format)
+{
+  switch (format) {
+    case TextureFormat::RGBA8:   return GL_RGBA8;
+    case TextureFormat::RGBA4:   return GL_RGBA4;
+    case TextureFormat::RGB5_A1: return GL_RGB5_A1;
+    case TextureFormat::R8:      return GL_R8;
+    case TextureFormat::BC1:     return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case TextureFormat::BC3:     return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureFormat::BC7:     return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  }
+  return GL_RGBA8;
+}
+
+/*****************************************************************************/
+static void upload_format(TextureFormat format, GLenum& gl_format, GLenum& gl_type)
+{
+  // How pack_pixels() lays the pixels out.
+  switch (format) {
+    case TextureFormat::RGBA4:
+      gl_format = GL_RGBA;
+      gl_type = GL_UNSIGNED_SHORT_4_4_4_4;
+      break;
+    case TextureFormat::RGB5_A1:
+      gl_format = GL_RGBA;
+      gl_type = GL_UNSIGNED_SHORT_5_5_5_1;
+      break;
+    case TextureFormat::R8:
+      gl_format = GL_RED;
+      gl_type = GL_UNSIGNED_BYTE;
+      break;
+    default:
+      gl_format = GL_RGBA;
+      gl_type = GL_UNSIGNED_BYTE;
+      break;
+  }
+}
+
+
+//----- Texture::PendingLoad
+
+/*****************************************************************************/
+struct Texture::PendingLoad {
+  int dropped_levels;
+  std::unique_ptr<Image> image;
+  std::unique_ptr<CompressedImage> compressed;
+  std::string error;
+  bool done;
+  std::mutex mutex;
+
+  explicit PendingLoad(int dropped_levels)
+    : dropped_levels(dropped_levels), done(false) {}
+
+  void decode(const FileSystem& files, const Path& path);
+  // Read and decode the file; runs as a job.
+};
+
+/*****************************************************************************/
+void Texture::PendingLoad::decode(const FileSystem& files, const Path& path)
+{
+  try {
+    if (has_extension(path, ".dds") || has_extension(path, ".ktx")) {
+      compressed.reset(new CompressedImage(files, path));
+    } else {
+      image.reset(new Image(files, path));
+    }
+  } catch (std::exception& e) {
+    error = e.what();
+  } catch (...) {
+    error = path.path() + ": failed to load";
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  done = true;
+}
+
+
+//----- Texture
+
+/*****************************************************************************/
+Texture::Texture(GraphicsSystem& tok, TextureTarget bind_to, TextureFormat format)
+  : GraphicsObject(tok),
+    m_id(0),
+    m_target(bind_to),
+    m_size(0, 0),
+    m_format(format),
+    m_byte_size(0),
+    m_level_count(0),
+    m_source_format(format),
+    m_mipmaps(Mipmaps::NONE),
+    m_dropped_levels(0),
+    m_last_used(0),
+    m_resident(false)
+{
+}
+
 /*****************************************************************************/
 Texture::Texture(
   GraphicsSystem& tok, 
   TextureTarget bind_to, 
-  Path filename
+  Path filename,
+  TextureFormat format,
+  Mipmaps mipmaps
 ) 
-  : GraphicsObject(tok)
+  : Texture(tok, bind_to, format)
 { 
+  m_source = filename.path();
+  m_mipmaps = mipmaps;
+  load(0);
+  graphics_system().residency().add(this);
+}
+
+/*****************************************************************************/
+Texture::Texture(
+  GraphicsSystem& tok, 
+  TextureTarget bind_to, 
+  const Image& image,
+  TextureFormat format,
+  Mipmaps mipmaps
+) 
+  : Texture(tok, bind_to, format)
+{ 
+  initialise(bind_to, image, format, mipmaps, 0);
+  graphics_system().residency().add(this);
+}
+
+/*****************************************************************************/
+Texture::Texture(
+  GraphicsSystem& tok, 
+  TextureTarget bind_to, 
+  const CompressedImage& image
+) 
+  : Texture(tok, bind_to, image.format())
+{ 
+  initialise(bind_to, image, 0);
+  graphics_system().residency().add(this);
+}
+
+/*****************************************************************************/
+Texture::Texture(
+  GraphicsSystem& tok, 
+  TextureTarget bind_to, 
+  TextureFormat format,
+  Vector2i size,
+  const std::vector<const void*>& levels
+) 
+  : Texture(tok, bind_to, format)
+{ 
+  assert(!levels.empty());
+  require_support(format);
+
+  create(bind_to, format);
+  m_size = size;
+
+  for (size_t level = 0; level < levels.size(); ++level) {
+    Vector2i level_size = (size / (1 << level)).cwiseMax(1);
+    upload_level(int(level), level_size, levels[level]);
+    m_byte_size += texture_byte_size(format, level_size);
+  }
+
+  set_parameters(int(levels.size()));
+  graphics_system().residency().add(this);
+}
+
+/*****************************************************************************/
+Texture::Texture(
+  GraphicsSystem& tok, 
+  TextureTarget bind_to, 
+  Vector2i size,
+  TextureFormat format
+) 
+  : Texture(tok, bind_to, format)
+{ 
+  assert(!is_compressed(format));
+  initialise(bind_to, size, format, nullptr);
+  graphics_system().residency().add(this);
+}
+
+/*****************************************************************************/
+bool Texture::supported(TextureFormat format)
+{
+  switch (format) {
+    case TextureFormat::BC1:
+    case TextureFormat::BC3:
+      return !!GLEW_EXT_texture_compression_s3tc;
+    case TextureFormat::BC7:
+      return !!GLEW_ARB_texture_compression_bptc;
+    default:
+      return true;
+  }
+}
+
+/*****************************************************************************/
+void Texture::load(int dropped_levels)
+{
+  profiling::Scope scope(graphics_system().profiler(), "Texture::load");
+  Path path(m_source);
+  const FileSystem& files = graphics_system().file_system();
+  if (has_extension(path, ".dds") || has_extension(path, ".ktx")) {
+    initialise(m_target, CompressedImage(files, path), dropped_levels);
+  } else {
+    initialise(m_target, Image(files, path), m_source_format, m_mipmaps, dropped_levels);
+  }
+}
+
+/*****************************************************************************/
+void Texture::create(TextureTarget bind_to, TextureFormat format)
+{
+  release();
+
+  m_target = bind_to;
+  m_format = format;
+
   glGenTextures(1, &m_id); 
-  bind(bind_to);
+  graphics_system().state().bind_texture(get_gl_enum(bind_to), m_id);
+  m_resident = true;
+
+  // The data is in main memory, so make sure it isn't read from a pixel
+  // buffer instead.
+  graphics_system().state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
 
-  int n;
-  stbi_uc* data = stbi_load(filename.path().c_str(), &m_size[0], &m_size[1], &n, 4);
-  if (data == 0) {
-    glDeleteTextures(1, &m_id);
-    throw std::runtime_error(stbi_failure_reason());
+/*****************************************************************************/
+void Texture::release()
+{
+  if (!m_id) return;
+  graphics_system().state().forget_texture(m_id);
+  glDeleteTextures(1, &m_id);
+  m_id = 0;
+  m_byte_size = 0;
+  m_level_count = 0;
+  m_resident = false;
+}
+
+/*****************************************************************************/
+void Texture::make_placeholder()
+{
+  // A texture of its own rather than a shared one, so that binding it is
+  // exactly the same as binding the real thing.
+  release();
+  glGenTextures(1, &m_id);
+  graphics_system().state().bind_texture(get_gl_enum(m_target), m_id);
+  graphics_system().state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  const unsigned char transparent[4] = { 0, 0, 0, 0 };
+  glTexImage2D(
+    get_gl_enum(m_target), 0, GL_RGBA8, 1, 1, 0,
+    GL_RGBA, GL_UNSIGNED_BYTE, transparent
+  );
+  set_parameters(1);
+}
+
+/*****************************************************************************/
+void Texture::start_load(int dropped_levels)
+{
+  if (m_pending || !reloadable()) return;
+
+  // The job gets copies of everything it needs, and its own reference to
+  // the pending load, so it doesn't touch the texture at all.
+  std::shared_ptr<PendingLoad> pending = std::make_shared<PendingLoad>(dropped_levels);
+  m_pending = pending;
+  Path path(m_source);
+  const FileSystem* files = &graphics_system().file_system();
+  graphics_system().jobs().submit(
+    [pending, path, files] { pending->decode(*files, path); },
+    m_load_job
+  );
+}
+
+/*****************************************************************************/
+bool Texture::finish_load()
+{
+  if (!m_pending) return false;
+  {
+    std::lock_guard<std::mutex> lock(m_pending->mutex);
+    if (!m_pending->done) return false;
+  }
+  std::shared_ptr<PendingLoad> pending;
+  pending.swap(m_pending);
+
+  profiling::Scope scope(graphics_system().profiler(), "Texture::finish_load");
+  std::string error = pending->error;
+  if (error.empty()) {
+    try {
+      if (pending->compressed) {
+        initialise(m_target, *pending->compressed, pending->dropped_levels);
+      } else {
+        initialise(
+          m_target, *pending->image, m_source_format, m_mipmaps, 
+          pending->dropped_levels
+        );
+      }
+      return true;
+    } catch (std::exception& e) {
+      error = e.what();
+    }
   }
 
+  // Don't keep on trying; leave the texture as it is, or as a placeholder
+  // if it lost its contents.
+  m_load_error = error;
+  m_source.clear();
+  if (!m_resident) make_placeholder();
+  return true;
+}
+
+/*****************************************************************************/
+void Texture::initialise(
+  TextureTarget bind_to, 
+  Vector2i size, 
+  TextureFormat format,
+  const unsigned char* data
+)
+{
+  create(bind_to, format);
+  m_size = size;
+  m_byte_size = texture_byte_size(format, size);
+
+  std::vector<unsigned char> packed;
+  if (data && format != TextureFormat::RGBA8) {
+    packed = pack_pixels(format, size, data);
+    data = packed.data();
+  }
+
+  upload_level(0, size, data);
+  set_parameters(1);
+}
+
+/*****************************************************************************/
+void Texture::initialise(
+  TextureTarget bind_to,
+  const Image& image,
+  TextureFormat format,
+  Mipmaps mipmaps,
+  int dropped_levels
+)
+{
+  // Dropped levels are never uploaded, so shrink the image first.
+  const Image* base = &image;
+  Image reduced(Vector2i(0, 0));
+  for (int i = 0; i < dropped_levels; ++i) {
+    reduced = base->half_size();
+    base = &reduced;
+  }
+
+  if (is_compressed(format)) {
+    initialise(
+      bind_to, 
+      CompressedImage::encode(*base, format, mipmaps != Mipmaps::NONE), 
+      0
+    );
+    m_size = image.size();
+    m_dropped_levels = dropped_levels;
+    return;
+  }
+
+  create(bind_to, format);
+  m_size = image.size();
+  m_dropped_levels = dropped_levels;
+
+  upload_image(0, *base);
+  int level_count = 1;
+
+  if (mipmaps == Mipmaps::CPU && base->size() != Vector2i(1, 1)) {
+    Image level = base->half_size();
+    while (true) {
+      upload_image(level_count++, level);
+      if (level.size() == Vector2i(1, 1)) break;
+      level = level.half_size();
+    }
+  } else if (mipmaps == Mipmaps::GPU) {
+    glGenerateMipmap(get_gl_enum(bind_to));
+    for (Vector2i size = base->size(); size != Vector2i(1, 1); ++level_count) {
+      size = (size / 2).cwiseMax(1);
+      m_byte_size += texture_byte_size(format, size);
+    }
+  }
+
+  set_parameters(level_count);
+}
+
+/*****************************************************************************/
+void Texture::upload_image(int level, const Image& image)
+{
+  std::vector<unsigned char> packed;
+  const unsigned char* data = image.data();
+  if (m_format != TextureFormat::RGBA8) {
+    packed = pack_pixels(m_format, image.size(), data);
+    data = packed.data();
+  }
+  upload_level(level, image.size(), data);
+  m_byte_size += texture_byte_size(m_format, image.size());
+}
+
+/*****************************************************************************/
+void Texture::upload_level(int level, Vector2i size, const void* data)
+{
+  if (is_compressed(m_format)) {
+    GLsizei bytes = texture_byte_size(m_format, size);
+    glCompressedTexImage2D(
+      get_gl_enum(m_target),
+      level,
+      internal_format(m_format),
+      size[0], size[1],
+      0,
+      bytes,
+      data
+    );
+    return;
+  }
+
+  GLenum gl_format;
+  GLenum gl_type;
+  upload_format(m_format, gl_format, gl_type);
+
+  // Packed rows needn't be a multiple of 4 bytes long.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   glTexImage2D(
-    get_gl_enum(bind_to), // Target
-    0,                    // Level
-    GL_RGBA,              // Internal format 
-    m_size[0], m_size[1], // W, H
-    0,                    // Border (must always == 0)
-    GL_RGBA,              // Format
-    GL_UNSIGNED_BYTE,     // Data type
-    data                  // Data
+    get_gl_enum(m_target),      // Target
+    level,                      // Level
+    internal_format(m_format),  // Internal format 
+    size[0], size[1],           // W, H
+    0,                          // Border (must always == 0)
+    gl_format,                  // Format
+    gl_type,                    // Data type
+    data                        // Data
   );
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
 
+/*****************************************************************************/
+void Texture::initialise(
+  TextureTarget bind_to, 
+  const CompressedImage& image,
+  int dropped_levels
+)
+{
+  // Drop as many levels as asked, so long as one is left.
+  int first = std::min(dropped_levels, image.level_count() - 1);
+
+  // BC1 and BC3 can be decompressed if need be; format() then says RGBA8.
+  // There's no BC7 decoder, so that gets the same error as anything else
+  // the GPU can't do.
+  if (!supported(image.format())) {
+    if (image.format() == TextureFormat::BC7) require_support(image.format());
+    Mipmaps mipmaps = 
+      image.level_count() - first > 1 ? Mipmaps::CPU : Mipmaps::NONE;
+    initialise(bind_to, image.decode(first), TextureFormat::RGBA8, mipmaps, 0);
+    m_size = image.size();
+    m_dropped_levels = first;
+    return;
+  }
+
+  create(bind_to, image.format());
+  m_size = image.size();
+  m_dropped_levels = first;
+
+  for (int level = first; level < image.level_count(); ++level) {
+    upload_level(
+      level - first, image.level_size(level), image.level(level).data()
+    );
+    m_byte_size += image.level(level).size();
+  }
+
+  set_parameters(image.level_count() - first);
+}
+
+/*****************************************************************************/
+void Texture::require_support(TextureFormat format)
+{
+  if (!supported(format)) {
+    throw std::runtime_error(
+      std::string(texture_format_name(format)) + 
+      " textures aren't supported by this GPU"
+    );
+  }
+}
+
+/*****************************************************************************/
+void Texture::set_parameters(int level_count)
+{
+  m_level_count = level_count;
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+  glTexParameteri(
+    GL_TEXTURE_2D, 
+    GL_TEXTURE_MIN_FILTER, 
+    level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR
+  );
 }
 
 /*****************************************************************************/
-void Texture::bind(TextureTarget to)
+void Texture::bind(TextureTarget to, int unit)
 { 
-  glBindTexture(get_gl_enum(to), m_id); 
+  m_last_used = graphics_system().residency().frame();
+  graphics_system().state().bind_texture(get_gl_enum(to), m_id, unit);
+}
+
+/*****************************************************************************/
+void Texture::sub_image(Vector2i min, Vector2i size, const void* pixels)
+{
+  assert(!is_compressed(m_format));
+  bind(m_target);
+  glTexSubImage2D(
+    get_gl_enum(m_target),
+    0,
+    min[0], min[1],
+    size[0], size[1],
+    GL_RGBA,
+    GL_UNSIGNED_BYTE,
+    pixels
+  );
+}
+
+/*****************************************************************************/
+void Texture::generate_mipmaps()
+{
+  assert(!is_compressed(m_format));
+  bind(m_target);
+  glGenerateMipmap(get_gl_enum(m_target));
+
+  int level_count = 1;
+  m_byte_size = texture_byte_size(m_format, m_size);
+  for (Vector2i size = m_size; size != Vector2i(1, 1); ++level_count) {
+    size = (size / 2).cwiseMax(1);
+    m_byte_size += texture_byte_size(m_format, size);
+  }
+  set_parameters(level_count);
 }
 
 /*****************************************************************************/
@@ -58,9 +569,102 @@ Vector2i Texture::size() const
   return m_size;
 }
 
+/*****************************************************************************/
+TextureFormat Texture::format() const
+{
+  return m_format;
+}
+
+/*****************************************************************************/
+size_t Texture::byte_size() const
+{
+  return m_byte_size;
+}
+
+/*****************************************************************************/
+int Texture::level_count() const
+{
+  return m_level_count;
+}
+
+/*****************************************************************************/
+bool Texture::reloadable() const
+{
+  return !m_source.empty();
+}
+
+/*****************************************************************************/
+bool Texture::resident() const
+{
+  return m_resident;
+}
+
+/*****************************************************************************/
+bool Texture::loading() const
+{
+  return !!m_pending;
+}
+
+/*****************************************************************************/
+int Texture::loading_levels() const
+{
+  return m_pending ? m_pending->dropped_levels : m_dropped_levels;
+}
+
+/*****************************************************************************/
+std::string Texture::load_error() const
+{
+  return m_load_error;
+}
+
+/*****************************************************************************/
+int Texture::dropped_levels() const
+{
+  return m_dropped_levels;
+}
+
+/*****************************************************************************/
+unsigned Texture::last_used() const
+{
+  return m_last_used;
+}
+
+/*****************************************************************************/
+void Texture::evict()
+{
+  assert(reloadable());
+  // A reload still under way would bring the texture straight back, so drop
+  // it; the job finishes on its own and its result goes nowhere.
+  m_pending.reset();
+  make_placeholder();
+}
+
+/*****************************************************************************/
+void Texture::reload()
+{
+  start_load(m_dropped_levels);
+}
+
+/*****************************************************************************/
+void Texture::drop_level()
+{
+  assert(reloadable() && m_level_count > 1);
+  start_load(m_dropped_levels + 1);
+}
+
+/*****************************************************************************/
+void Texture::restore()
+{
+  if (m_dropped_levels != 0 || !m_resident) start_load(0);
+}
+
 /*****************************************************************************/
 Texture::~Texture() 
 { 
-  glDeleteTextures(1, &m_id);
+  graphics_system().residency().remove(this);
+  // The job can't touch the texture, but it does read through the file
+  // system, so make sure it's finished - even one for a reload evict()
+  // dropped. It catches its own errors.
+  graphics_system().jobs().wait(m_load_job);
+  release();
 }
-
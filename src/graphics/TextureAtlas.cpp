@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include <graphics/TextureAtlas.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+//----- SkylinePacker
+
+//*****************************************************************************
+SkylinePacker::SkylinePacker(Vector2i size)
+  : m_size(size),
+    m_used(0, 0)
+{
+  Segment ground = { 0, 0, size[0] };
+  m_skyline.push_back(ground);
+}
+
+//*****************************************************************************
+bool SkylinePacker::fits(size_t index, Vector2i size, int& y) const
+{
+  int x = m_skyline[index].x;
+  if (x + size[0] > m_size[0]) return false;
+
+  // The rectangle rests on the highest segment underneath it.
+  y = 0;
+  int width_left = size[0];
+  while (width_left > 0) {
+    y = std::max(y, m_skyline[index].y);
+    if (y + size[1] > m_size[1]) return false;
+    width_left -= m_skyline[index].width;
+    ++index;
+  }
+  return true;
+}
+
+//*****************************************************************************
+bool SkylinePacker::insert(Vector2i size, Vector2i& position)
+{
+  int best_index = -1;
+  int best_top = 0;
+  int best_x = 0;
+  for (size_t i = 0; i < m_skyline.size(); ++i) {
+    int y;
+    if (!fits(i, size, y)) continue;
+    int top = y + size[1];
+    if (best_index < 0 || top < best_top ||
+        (top == best_top && m_skyline[i].x < best_x)) {
+      best_index = i;
+      best_top = top;
+      best_x = m_skyline[i].x;
+    }
+  }
+  if (best_index < 0) return false;
+
+  position = Vector2i(best_x, best_top - size[1]);
+
+  // Raise the skyline over the new rectangle, then cut away whatever it
+  // covers of the segments to its right.
+  Segment raised = { best_x, best_top, size[0] };
+  m_skyline.insert(m_skyline.begin() + best_index, raised);
+  for (size_t i = best_index + 1; i < m_skyline.size(); ) {
+    const Segment& previous = m_skyline[i - 1];
+    Segment& current = m_skyline[i];
+    int overlap = previous.x + previous.width - current.x;
+    if (overlap <= 0) break;
+    current.x += overlap;
+    current.width -= overlap;
+    if (current.width > 0) break;
+    m_skyline.erase(m_skyline.begin() + i);
+  }
+
+  // Merge neighbours at the same height.
+  for (size_t i = 1; i < m_skyline.size(); ) {
+    if (m_skyline[i - 1].y == m_skyline[i].y) {
+      m_skyline[i - 1].width += m_skyline[i].width;
+      m_skyline.erase(m_skyline.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+
+  m_used = m_used.cwiseMax(position + size);
+  return true;
+}
+
+//*****************************************************************************
+Vector2i SkylinePacker::used() const
+{
+  return m_used;
+}
+
+
+//----- AtlasBuilder
+
+//*****************************************************************************
+AtlasBuilder::AtlasBuilder(Vector2i page_size, int padding)
+  : m_page_size(page_size),
+    m_padding(padding)
+{
+}
+
+//*****************************************************************************
+int AtlasBuilder::add(const Image& sheet, Vector2i frame_size, int frame_count)
+{
+  if (frame_size[0] <= 0 || frame_size[1] <= 0 || frame_count <= 0) {
+    throw std::runtime_error("Bad frame size or count for atlas.");
+  }
+
+  int columns = std::min(sheet.size()[0] / frame_size[0], frame_count);
+  if (columns == 0) {
+    throw std::runtime_error("Frames are wider than the sprite sheet.");
+  }
+  int rows = (frame_count + columns - 1) / columns;
+  if (rows * frame_size[1] > sheet.size()[1]) {
+    throw std::runtime_error("Frames don't fit in the sprite sheet.");
+  }
+
+  Vector2i used(columns * frame_size[0], rows * frame_size[1]);
+  Entry entry = { Image(used), -1, Vector2i(0, 0) };
+  entry.pixels.blit(sheet, Vector2i(0, 0), used, Vector2i(0, 0));
+  m_entries.push_back(entry);
+
+  return m_entries.size() - 1;
+}
+
+//*****************************************************************************
+void AtlasBuilder::pack()
+{
+  // Tall things first tends to give the skyline fewer gaps.
+  std::vector<size_t> order(m_entries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return m_entries[a].pixels.size()[1] > m_entries[b].pixels.size()[1];
+  });
+
+  std::vector<SkylinePacker> packers;
+  for (size_t index : order) {
+    Entry& entry = m_entries[index];
+    Vector2i padded = entry.pixels.size() + Vector2i(m_padding, m_padding);
+    if (entry.pixels.size()[0] > m_page_size[0] ||
+        entry.pixels.size()[1] > m_page_size[1]) {
+      throw std::runtime_error("Sprite sheet is too big for an atlas page.");
+    }
+    // The padding isn't needed at the edges of the page.
+    padded = padded.cwiseMin(m_page_size);
+
+    entry.page = -1;
+    for (size_t page = 0; page < packers.size(); ++page) {
+      if (packers[page].insert(padded, entry.min)) {
+        entry.page = page;
+        break;
+      }
+    }
+    if (entry.page < 0) {
+      packers.push_back(SkylinePacker(m_page_size));
+      packers.back().insert(padded, entry.min);
+      entry.page = packers.size() - 1;
+    }
+  }
+
+  // Pages are only as big as they need to be.
+  m_pages.clear();
+  for (const SkylinePacker& packer : packers) {
+    m_pages.push_back(Image(packer.used().cwiseMin(m_page_size)));
+  }
+  for (const Entry& entry : m_entries) {
+    m_pages[entry.page].blit(
+      entry.pixels, Vector2i(0, 0), entry.pixels.size(), entry.min
+    );
+  }
+}
+
+//*****************************************************************************
+const std::vector<Image>& AtlasBuilder::pages() const
+{
+  return m_pages;
+}
+
+//*****************************************************************************
+int AtlasBuilder::count() const
+{
+  return m_entries.size();
+}
+
+//*****************************************************************************
+int AtlasBuilder::page(int id) const
+{
+  return m_entries[id].page;
+}
+
+//*****************************************************************************
+Vector2i AtlasBuilder::min(int id) const
+{
+  return m_entries[id].min;
+}
+
+//*****************************************************************************
+Vector2i AtlasBuilder::size(int id) const
+{
+  return m_entries[id].pixels.size();
+}
+
+
+//----- TextureAtlas
+
+//*****************************************************************************
+TextureAtlas::TextureAtlas(GraphicsSystem& gtok, const AtlasBuilder& builder)
+  : GraphicsObject(gtok)
+{
+  GLint max_size;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+  for (const Image& page : builder.pages()) {
+    if (page.size().maxCoeff() > max_size) {
+      throw std::runtime_error("Atlas page is bigger than GL_MAX_TEXTURE_SIZE.");
+    }
+    m_pages.push_back(
+      std::make_shared<Texture>(gtok, TextureTarget::TEXTURE_2D, page)
+    );
+  }
+
+  for (int id = 0; id < builder.count(); ++id) {
+    TextureRegion region;
+    region.texture = m_pages[builder.page(id)];
+    region.min = builder.min(id);
+    region.size = builder.size(id);
+    m_regions.push_back(region);
+  }
+}
+
+//*****************************************************************************
+TextureRegion TextureAtlas::region(int id) const
+{
+  return m_regions[id];
+}
+
+//*****************************************************************************
+int TextureAtlas::page_count() const
+{
+  return m_pages.size();
+}
+
+//*****************************************************************************
+std::shared_ptr<Texture> TextureAtlas::page(int index) const
+{
+  return m_pages[index];
+}
@@ -0,0 +1,100 @@
+#include <cstdint>
+
+#include <graphics/TextureFormat.hpp>
+
+using namespace graphics;
+using namespace Eigen;
+
+//*****************************************************************************
+bool graphics::is_compressed(TextureFormat format)
+{
+  switch (format) {
+    case TextureFormat::BC1:
+    case TextureFormat::BC3:
+    case TextureFormat::BC7:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//*****************************************************************************
+size_t graphics::texture_byte_size(TextureFormat format, Vector2i size)
+{
+  size_t pixels = size_t(size[0]) * size[1];
+  size_t blocks = size_t((size[0] + 3) / 4) * ((size[1] + 3) / 4);
+  switch (format) {
+    case TextureFormat::RGBA8:   return pixels * 4;
+    case TextureFormat::RGBA4:   return pixels * 2;
+    case TextureFormat::RGB5_A1: return pixels * 2;
+    case TextureFormat::R8:      return pixels;
+    case TextureFormat::BC1:     return blocks * 8;
+    case TextureFormat::BC3:     return blocks * 16;
+    case TextureFormat::BC7:     return blocks * 16;
+  }
+  return 0;
+}
+
+//*****************************************************************************
+std::vector<unsigned char> graphics::pack_pixels(
+  TextureFormat format,
+  Vector2i size,
+  const unsigned char* rgba
+)
+{
+  size_t count = size_t(size[0]) * size[1];
+  std::vector<unsigned char> ret;
+
+  switch (format) {
+    case TextureFormat::RGBA4: {
+      ret.resize(count * 2);
+      uint16_t* out = reinterpret_cast<uint16_t*>(ret.data());
+      for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = rgba + i * 4;
+        out[i] = uint16_t((p[0] * 15 + 127) / 255 << 12 |
+                          (p[1] * 15 + 127) / 255 << 8 |
+                          (p[2] * 15 + 127) / 255 << 4 |
+                          (p[3] * 15 + 127) / 255);
+      }
+      break;
+    }
+
+    case TextureFormat::RGB5_A1: {
+      ret.resize(count * 2);
+      uint16_t* out = reinterpret_cast<uint16_t*>(ret.data());
+      for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = rgba + i * 4;
+        out[i] = uint16_t((p[0] * 31 + 127) / 255 << 11 |
+                          (p[1] * 31 + 127) / 255 << 6 |
+                          (p[2] * 31 + 127) / 255 << 1 |
+                          (p[3] >= 128 ? 1 : 0));
+      }
+      break;
+    }
+
+    case TextureFormat::R8:
+      ret.resize(count);
+      for (size_t i = 0; i < count; ++i) ret[i] = rgba[i * 4];
+      break;
+
+    default:
+      ret.assign(rgba, rgba + count * 4);
+      break;
+  }
+  return ret;
+}
+
+//*****************************************************************************
+const char* graphics::texture_format_name(TextureFormat format)
+{
+  switch (format) {
+    case TextureFormat::RGBA8:   return "RGBA8";
+    case TextureFormat::RGBA4:   return "RGBA4";
+    case TextureFormat::RGB5_A1: return "RGB5_A1";
+    case TextureFormat::R8:      return "R8";
+    case TextureFormat::BC1:     return "BC1";
+    case TextureFormat::BC3:     return "BC3";
+    case TextureFormat::BC7:     return "BC7";
+  }
+  return "unknown";
+}
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cstring>
+
+#include <graphics/TextureLoader.hpp>
+#include <graphics/GraphicsSystem.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+using namespace Eigen;
+
+const int TextureLoader::UPLOAD_ATTEMPTS;
+
+//----- TextureHandle
+
+//*****************************************************************************
+TextureHandle::TextureHandle()
+{
+}
+
+//*****************************************************************************
+TextureHandle::TextureHandle(std::shared_ptr<Request> request)
+  : m_request(request)
+{
+}
+
+//*****************************************************************************
+bool TextureHandle::ready() const
+{
+  if (!m_request) return false;
+  std::lock_guard<std::mutex> lock(m_request->mutex);
+  return m_request->state == State::READY;
+}
+
+//*****************************************************************************
+bool TextureHandle::failed() const
+{
+  if (!m_request) return false;
+  std::lock_guard<std::mutex> lock(m_request->mutex);
+  return m_request->state == State::FAILED;
+}
+
+//*****************************************************************************
+std::string TextureHandle::error() const
+{
+  if (!m_request) return std::string();
+  std::lock_guard<std::mutex> lock(m_request->mutex);
+  return m_request->error;
+}
+
+//*****************************************************************************
+std::shared_ptr<Texture> TextureHandle::texture() const
+{
+  if (!m_request) return nullptr;
+  std::lock_guard<std::mutex> lock(m_request->mutex);
+  if (m_request->state == State::READY) return m_request->texture;
+  return m_request->placeholder;
+}
+
+//*****************************************************************************
+Vector2i TextureHandle::size() const
+{
+  if (!m_request) return Vector2i(0, 0);
+  std::lock_guard<std::mutex> lock(m_request->mutex);
+  if (m_request->texture) return m_request->texture->size();
+  if (m_request->image) return m_request->image->size();
+  return Vector2i(0, 0);
+}
+
+
+//----- TextureLoader
+
+//*****************************************************************************
+TextureLoader::TextureLoader(
+  GraphicsSystem& gtok,
+  int thread_count,
+  size_t upload_bytes_per_update
+)
+  : GraphicsObject(gtok),
+    m_upload_bytes_per_update(upload_bytes_per_update),
+    m_placeholder(std::make_shared<Texture>(
+      gtok, TextureTarget::TEXTURE_2D, Image(Vector2i(1, 1))
+    )),
+    m_pixel_buffer(
+      gtok, BufferTarget::PIXEL_UNPACK_BUFFER, BufferUsage::STREAM_DRAW
+    ),
+    m_decoding(0),
+    m_stopping(false),
+    m_jobs(thread_count > 0 ? nullptr : &gtok.jobs())
+{
+  for (int i = 0; i < thread_count; ++i) {
+    m_threads.push_back(std::thread(&TextureLoader::decode_loop, this));
+  }
+}
+
+//*****************************************************************************
+TextureHandle TextureLoader::load(Path path)
+{
+  RequestPtr request = std::make_shared<TextureHandle::Request>(path);
+  request->placeholder = m_placeholder;
+
+  if (m_jobs) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_decoding;
+    }
+    m_jobs->submit([this, request] { decode(request); }, m_decode_jobs);
+    return TextureHandle(request);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_to_decode.push_back(request);
+  }
+  m_wake.notify_one();
+  return TextureHandle(request);
+}
+
+//*****************************************************************************
+void TextureLoader::decode_loop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_wake.wait(lock, [this] { return m_stopping || !m_to_decode.empty(); });
+    if (m_stopping) return;
+
+    RequestPtr request = m_to_decode.front();
+    m_to_decode.pop_front();
+    ++m_decoding;
+    lock.unlock();
+
+    decode(request);
+
+    lock.lock();
+  }
+}
+
+//*****************************************************************************
+void TextureLoader::decode(const RequestPtr& request)
+{
+  typedef TextureHandle::State State;
+
+  profiling::Scope scope(graphics_system().profiler(), "TextureLoader::decode");
+  std::unique_ptr<Image> image;
+  std::string error;
+  try {
+    image.reset(new Image(graphics_system().file_system(), request->path));
+  } catch (std::exception& e) {
+    error = e.what();
+  }
+
+  bool decoded = !!image;
+  {
+    std::lock_guard<std::mutex> request_lock(request->mutex);
+    if (decoded) {
+      request->image = std::move(image);
+      request->state = State::DECODED;
+    } else {
+      request->error = error;
+      request->state = State::FAILED;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  --m_decoding;
+  if (decoded) m_to_upload.push_back(request);
+}
+
+//*****************************************************************************
+void TextureLoader::update()
+{
+  size_t budget = m_upload_bytes_per_update;
+  while (budget > 0) {
+    RequestPtr request;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_to_upload.empty()) break;
+      request = m_to_upload.front();
+    }
+
+    if (!upload_some(request, budget)) break;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_to_upload.pop_front();
+  }
+  m_pixel_buffer.unbind();
+}
+
+//*****************************************************************************
+bool TextureLoader::upload_some(const RequestPtr& request, size_t& budget)
+{
+  typedef TextureHandle::State State;
+
+  // Only this thread touches the image once it has been decoded, so there's
+  // no need to hold the request's lock while copying.
+  const Image& image = *request->image;
+  if (!request->texture) {
+    auto texture = std::make_shared<Texture>(
+      graphics_system(), TextureTarget::TEXTURE_2D, image.size()
+    );
+    std::lock_guard<std::mutex> lock(request->mutex);
+    request->texture = texture;
+    request->state = State::UPLOADING;
+  }
+
+  // Always upload at least one row, otherwise a tiny budget would never
+  // make any progress.
+  size_t row_bytes = image.size()[0] * 4;
+  int rows_left = image.size()[1] - request->rows_uploaded;
+  int rows = std::max<int>(1, std::min<size_t>(rows_left, budget / row_bytes));
+  size_t bytes = rows * row_bytes;
+
+  // Orphan the buffer each time so that mapping it never waits for the
+  // previous upload to finish.
+  m_pixel_buffer.allocate(bytes);
+  void* mapped = m_pixel_buffer.map_range(
+    0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+  );
+  bool uploaded = false;
+  if (mapped) {
+    std::memcpy(mapped, image.data() + request->rows_uploaded * row_bytes, bytes);
+    uploaded = m_pixel_buffer.unmap();
+  }
+  budget -= std::min(budget, bytes);
+
+  // The same rows are tried again next update. A buffer that keeps on
+  // failing (e.g. after a lost context) fails the texture, rather than
+  // leaving rows of it uninitialised.
+  if (!uploaded) {
+    if (++request->upload_failures < UPLOAD_ATTEMPTS) return false;
+    std::lock_guard<std::mutex> lock(request->mutex);
+    request->image.reset();
+    request->texture.reset();
+    request->error = "Failed to map the pixel buffer to upload " +
+      request->path.path();
+    request->state = State::FAILED;
+    return true;
+  }
+
+  request->texture->sub_image(
+    Vector2i(0, request->rows_uploaded), Vector2i(image.size()[0], rows), 0
+  );
+  request->upload_failures = 0;
+  request->rows_uploaded += rows;
+
+  if (request->rows_uploaded < image.size()[1]) return false;
+
+  std::lock_guard<std::mutex> lock(request->mutex);
+  request->image.reset();
+  request->state = State::READY;
+  return true;
+}
+
+//*****************************************************************************
+bool TextureLoader::idle() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_to_decode.empty() && m_decoding == 0 && m_to_upload.empty();
+}
+
+//*****************************************************************************
+TextureLoader::~TextureLoader()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  for (std::thread& thread : m_threads) thread.join();
+
+  // Jobs can't be abandoned, but they do at least help each other finish.
+  // decode() reports its own errors, so anything that gets this far has
+  // nowhere left to go.
+  if (m_jobs) {
+    try {
+      m_jobs->wait(m_decode_jobs);
+    } catch (...) {
+    }
+  }
+}
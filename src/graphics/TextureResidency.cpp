@@ -0,0 +1,193 @@
+#include <algorithm>
+
+#include <graphics/Texture.hpp>
+#include <graphics/TextureFormat.hpp>
+#include <graphics/TextureResidency.hpp>
+
+using namespace graphics;
+
+//*****************************************************************************
+TextureResidency::TextureResidency()
+  : m_budget(0),
+    m_frame(1),
+    m_drops(0),
+    m_evictions(0),
+    m_restores(0)
+{
+  // Frames start at 1 so that textures which have never been bound (whose
+  // stamp is 0) count as the least recently used.
+}
+
+//*****************************************************************************
+void TextureResidency::set_budget(size_t bytes)
+{
+  m_budget = bytes;
+}
+
+//*****************************************************************************
+size_t TextureResidency::budget() const
+{
+  return m_budget;
+}
+
+//*****************************************************************************
+size_t TextureResidency::resident_bytes() const
+{
+  size_t total = 0;
+  for (const Texture* texture : m_textures) total += texture->byte_size();
+  return total;
+}
+
+//*****************************************************************************
+unsigned TextureResidency::frame() const
+{
+  return m_frame;
+}
+
+//*****************************************************************************
+int TextureResidency::drops() const
+{
+  return m_drops;
+}
+
+//*****************************************************************************
+int TextureResidency::evictions() const
+{
+  return m_evictions;
+}
+
+//*****************************************************************************
+int TextureResidency::restores() const
+{
+  return m_restores;
+}
+
+//*****************************************************************************
+void TextureResidency::add(Texture* texture)
+{
+  m_textures.push_back(texture);
+}
+
+//*****************************************************************************
+void TextureResidency::remove(Texture* texture)
+{
+  auto it = std::find(m_textures.begin(), m_textures.end(), texture);
+  if (it == m_textures.end()) return;
+  *it = m_textures.back();
+  m_textures.pop_back();
+}
+
+//*****************************************************************************
+void TextureResidency::end_frame()
+//
+// Reloads finished since the last frame are uploaded first, and evicted
+// textures that were bound during this one start to come back. Both happen
+// here, between frames, so that binding never does more than bind.
+//*****************************************************************************
+{
+  for (Texture* texture : m_textures) {
+    texture->finish_load();
+    if (!texture->resident() && texture->reloadable() &&
+        !texture->loading() && texture->last_used() == m_frame) {
+      texture->reload();
+    }
+  }
+
+  if (m_budget != 0) {
+    size_t total = 0;
+    for (const Texture* texture : m_textures) total += expected_bytes(*texture);
+    if (total > m_budget) {
+      shrink(total);
+    } else {
+      grow(total);
+    }
+  }
+  ++m_frame;
+}
+
+//*****************************************************************************
+size_t TextureResidency::expected_bytes(const Texture& texture)
+{
+  // A texture that's being reloaded will have its new size once the reload
+  // is uploaded; each dropped level is a quarter the size of the one above.
+  // An evicted one has nothing to go on but its top level.
+  if (!texture.loading()) return texture.byte_size();
+  int from = texture.dropped_levels();
+  int to = texture.loading_levels();
+  if (!texture.resident()) {
+    Eigen::Vector2i size = texture.size();
+    return texture_byte_size(
+      texture.format(), Eigen::Vector2i(std::max(size.x() >> to, 1), std::max(size.y() >> to, 1))
+    );
+  }
+  size_t bytes = texture.byte_size();
+  return to > from ? bytes >> (2 * (to - from)) : bytes << (2 * (from - to));
+}
+
+//*****************************************************************************
+void TextureResidency::shrink(size_t& total)
+//
+// Two passes over the textures, least recently used first: drop a level from
+// each that has one to spare, then evict. Dropping a level starts a reload,
+// and textures with one under way aren't dropped again, so each is only
+// dropped once at a time; if that's not enough later frames drop more.
+// Eviction frees the memory straight away and abandons any reload, so it can
+// take textures the first pass has just started reloading; each is counted
+// at the size it was about to be.
+//*****************************************************************************
+{
+  m_candidates.clear();
+  for (Texture* texture : m_textures) {
+    if (texture->reloadable() && texture->resident() &&
+        texture->last_used() != m_frame) {
+      m_candidates.push_back(texture);
+    }
+  }
+  std::sort(m_candidates.begin(), m_candidates.end(),
+    [](const Texture* a, const Texture* b) {
+      return a->last_used() < b->last_used();
+    }
+  );
+
+  for (Texture* texture : m_candidates) {
+    if (total <= m_budget) return;
+    if (texture->level_count() < 2 || texture->loading()) continue;
+    texture->drop_level();
+    if (!texture->loading()) continue;
+    total = total - texture->byte_size() + expected_bytes(*texture);
+    ++m_drops;
+  }
+
+  for (Texture* texture : m_candidates) {
+    if (total <= m_budget) return;
+    total -= expected_bytes(*texture);
+    texture->evict();
+    ++m_evictions;
+  }
+}
+
+//*****************************************************************************
+void TextureResidency::grow(size_t total)
+{
+  // The smallest shrunk texture used this frame that would fit at full
+  // detail. Each dropped level is a quarter the size of the one above it.
+  Texture* best = nullptr;
+  size_t best_bytes = 0;
+  for (Texture* texture : m_textures) {
+    if (texture->dropped_levels() == 0 || !texture->resident() ||
+        texture->loading() || texture->last_used() != m_frame) {
+      continue;
+    }
+    size_t full = texture->byte_size() << (2 * texture->dropped_levels());
+    if (total - texture->byte_size() + full > m_budget) continue;
+    if (!best || full < best_bytes) {
+      best = texture;
+      best_bytes = full;
+    }
+  }
+
+  if (best) {
+    best->restore();
+    if (best->loading()) ++m_restores;
+  }
+}
@@ -0,0 +1,194 @@
+#include <algorithm>
+
+#include <jobs/JobSystem.hpp>
+
+using namespace jobs;
+
+namespace {
+  // Which pool (if any) the current thread is a worker in, and which queue
+  // is its own.
+  thread_local const JobSystem* t_pool = nullptr;
+  thread_local int t_queue = 0;
+}
+
+//*****************************************************************************
+JobSystem::JobSystem(int thread_count)
+  : m_pending(0),
+    m_stopping(false)
+{
+  if (thread_count < 0) {
+    thread_count = std::max<int>(std::thread::hardware_concurrency(), 2) - 1;
+  }
+
+  for (int i = 0; i < thread_count + 1; ++i) {
+    m_queues.push_back(std::unique_ptr<Queue>(new Queue));
+  }
+  for (int i = 0; i < thread_count; ++i) {
+    m_threads.push_back(std::thread(&JobSystem::worker_loop, this, i + 1));
+  }
+}
+
+//*****************************************************************************
+int JobSystem::thread_count() const
+{
+  return m_threads.size();
+}
+
+//*****************************************************************************
+int JobSystem::current_queue() const
+{
+  return t_pool == this ? t_queue : 0;
+}
+
+//*****************************************************************************
+void JobSystem::submit(std::function<void()> job, JobCounter& counter)
+{
+  ++counter.m_count;
+
+  Queue& queue = *m_queues[current_queue()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    Job entry = { std::move(job), &counter };
+    queue.jobs.push_back(std::move(entry));
+  }
+
+  // Take the sleep lock so that a worker can't check m_pending and then miss
+  // the notification.
+  {
+    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+    ++m_pending;
+  }
+  m_wake.notify_one();
+}
+
+//*****************************************************************************
+bool JobSystem::pop(int index, Job& job)
+{
+  Queue& queue = *m_queues[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty()) return false;
+  job = std::move(queue.jobs.back());
+  queue.jobs.pop_back();
+  return true;
+}
+
+//*****************************************************************************
+bool JobSystem::steal(int thief, Job& job)
+{
+  // Start looking just after ourselves so that thieves spread out.
+  const int count = m_queues.size();
+  for (int i = 1; i <= count; ++i) {
+    int victim = (thief + i) % count;
+    if (victim == thief) continue;
+
+    Queue& queue = *m_queues[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) continue;
+    job = std::move(queue.jobs.front());
+    queue.jobs.pop_front();
+    return true;
+  }
+  return false;
+}
+
+//*****************************************************************************
+bool JobSystem::find_job(Job& job)
+{
+  int index = current_queue();
+  if (pop(index, job) || steal(index, job)) {
+    --m_pending;
+    return true;
+  }
+  return false;
+}
+
+//*****************************************************************************
+void JobSystem::run(Job& job)
+{
+  // An exception mustn't escape: it would kill a worker thread, and the
+  // counter would never reach zero. Keep it for wait() instead, recorded
+  // before the count drops so that the waiter is sure to see it.
+  try {
+    job.run();
+  } catch (...) {
+    JobCounter& counter = *job.counter;
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+    if (!counter.m_exception) counter.m_exception = std::current_exception();
+  }
+  --job.counter->m_count;
+}
+
+//*****************************************************************************
+void JobSystem::worker_loop(int index)
+{
+  t_pool = this;
+  t_queue = index;
+
+  while (!m_stopping) {
+    Job job;
+    if (find_job(job)) {
+      run(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+    m_wake.wait(lock, [this] { return m_stopping || m_pending > 0; });
+  }
+}
+
+//*****************************************************************************
+void JobSystem::wait(JobCounter& counter)
+{
+  while (!counter.done()) {
+    Job job;
+    if (find_job(job)) {
+      run(job);
+    } else {
+      // Whatever we're waiting for is running on another thread.
+      std::this_thread::yield();
+    }
+  }
+
+  std::exception_ptr exception;
+  {
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+    std::swap(exception, counter.m_exception);
+  }
+  if (exception) std::rethrow_exception(exception);
+}
+
+//*****************************************************************************
+void JobSystem::parallel_for(
+  size_t begin,
+  size_t end,
+  size_t grain,
+  const std::function<void(size_t, size_t)>& body
+)
+{
+  if (begin >= end) return;
+  grain = std::max<size_t>(grain, 1);
+
+  // Not worth the overhead for a single piece.
+  if (end - begin <= grain) {
+    body(begin, end);
+    return;
+  }
+
+  JobCounter counter;
+  for (size_t first = begin; first < end; first += grain) {
+    size_t last = std::min(first + grain, end);
+    submit([&body, first, last] { body(first, last); }, counter);
+  }
+  wait(counter);
+}
+
+//*****************************************************************************
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  for (std::thread& thread : m_threads) thread.join();
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <iomanip>
+
+#include <profiling/Histogram.hpp>
+
+using namespace profiling;
+
+//*****************************************************************************
+Histogram::Histogram(double bucket_ms, size_t bucket_count)
+  : m_bucket_ms(bucket_ms),
+    m_buckets(bucket_count > 0 ? bucket_count : 1, 0),
+    m_count(0),
+    m_total(0),
+    m_max(0)
+{
+}
+
+//*****************************************************************************
+void Histogram::add(double ms)
+{
+  ms = std::max(ms, 0.0);
+  size_t bucket = static_cast<size_t>(
+    std::min(ms / m_bucket_ms, double(m_buckets.size() - 1))
+  );
+  ++m_buckets[bucket];
+  ++m_count;
+  m_total += ms;
+  m_max = std::max(m_max, ms);
+}
+
+//*****************************************************************************
+void Histogram::clear()
+{
+  std::fill(m_buckets.begin(), m_buckets.end(), 0);
+  m_count = 0;
+  m_total = 0;
+  m_max = 0;
+}
+
+//*****************************************************************************
+size_t Histogram::count() const
+{
+  return m_count;
+}
+
+//*****************************************************************************
+double Histogram::mean() const
+{
+  return m_count ? m_total / m_count : 0;
+}
+
+//*****************************************************************************
+double Histogram::max() const
+{
+  return m_max;
+}
+
+//*****************************************************************************
+double Histogram::percentile(double fraction) const
+{
+  if (m_count == 0) return 0;
+
+  // The rank of the timing we want, counting from 1.
+  double rank = std::max(1.0, fraction * m_count);
+  size_t seen = 0;
+  for (size_t i = 0; i < m_buckets.size(); ++i) {
+    seen += m_buckets[i];
+    if (seen >= rank) return std::min((i + 1) * m_bucket_ms, m_max);
+  }
+  return m_max;
+}
+
+//*****************************************************************************
+void Histogram::print(std::ostream& out) const
+{
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3)
+      << "n " << m_count
+      << "  mean " << mean()
+      << "  p50 " << percentile(0.5)
+      << "  p99 " << percentile(0.99)
+      << "  max " << max() << " ms";
+  out.flags(flags);
+  out.precision(precision);
+}
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include <profiling/Profiler.hpp>
+
+using namespace profiling;
+
+const int Profiler::WINDOW;
+const int Profiler::GPU_TRACK;
+
+//*****************************************************************************
+void profiling::write_json_string(std::ostream& out, const char* s)
+{
+  out << '"';
+  for (; *s; ++s) {
+    char c = *s;
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+//*****************************************************************************
+void profiling::write_json_string(std::ostream& out, const std::string& s)
+{
+  write_json_string(out, s.c_str());
+}
+
+//*****************************************************************************
+Profiler::Profiler()
+  : m_enabled(true),
+    m_epoch(std::chrono::steady_clock::now()),
+    m_frame(0),
+    m_tracing(false),
+    m_max_events(0)
+{
+  // The thread that makes the profiler is taken to be the main one.
+  m_tracks[std::this_thread::get_id()] = 0;
+}
+
+//*****************************************************************************
+void Profiler::set_enabled(bool enabled)
+{
+  m_enabled = enabled;
+}
+
+//*****************************************************************************
+bool Profiler::enabled() const
+{
+  return m_enabled;
+}
+
+//*****************************************************************************
+double Profiler::now() const
+{
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - m_epoch
+  ).count();
+}
+
+//*****************************************************************************
+int Profiler::track()
+{
+  // Called with the lock held. Threads are numbered in order of appearance,
+  // which reads better in a trace than the OS's ids.
+  std::thread::id id = std::this_thread::get_id();
+  auto it = m_tracks.find(id);
+  if (it != m_tracks.end()) return it->second;
+  int track = int(m_tracks.size());
+  m_tracks[id] = track;
+  return track;
+}
+
+//*****************************************************************************
+void Profiler::record(
+  const char* name, 
+  double start_us, 
+  double duration_us, 
+  int track
+)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Event event = { 
+    name, start_us, duration_us, track == GPU_TRACK ? GPU_TRACK : this->track()
+  };
+  m_events.push_back(event);
+}
+
+//*****************************************************************************
+void Profiler::end_frame()
+{
+  std::vector<Event> events;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    events.swap(m_events);
+    m_events.reserve(events.size());
+  }
+
+  for (const Event& event : events) {
+    Scope& scope = m_scopes[event.name];
+    if (scope.frame_ms.empty()) {
+      scope.frame_ms.assign(WINDOW, 0);
+      scope.frame_calls.assign(WINDOW, 0);
+      scope.current_ms = 0;
+      scope.current_calls = 0;
+    }
+    scope.current_ms += event.duration / 1000;
+    ++scope.current_calls;
+  }
+
+  // Scopes that didn't happen this frame still move on, with a zero.
+  int slot = m_frame % WINDOW;
+  for (auto& entry : m_scopes) {
+    Scope& scope = entry.second;
+    scope.frame_ms[slot] = scope.current_ms;
+    scope.frame_calls[slot] = scope.current_calls;
+    scope.current_ms = 0;
+    scope.current_calls = 0;
+  }
+  ++m_frame;
+
+  if (m_tracing) {
+    size_t room = m_max_events - std::min(m_max_events, m_trace.size());
+    size_t count = std::min(room, events.size());
+    m_trace.insert(m_trace.end(), events.begin(), events.begin() + count);
+  }
+}
+
+//*****************************************************************************
+ScopeSummary Profiler::summarise(const std::string& name, const Scope& scope) const
+{
+  int frames = std::min(m_frame, int(WINDOW));
+  ScopeSummary ret = { name, 0, 0, 0, 0 };
+  for (int i = 0; i < frames; ++i) {
+    ret.average_ms += scope.frame_ms[i];
+    ret.max_ms = std::max(ret.max_ms, scope.frame_ms[i]);
+    ret.calls += scope.frame_calls[i];
+  }
+  if (frames > 0) {
+    ret.average_ms /= frames;
+    ret.calls /= frames;
+    ret.last_ms = scope.frame_ms[(m_frame - 1) % WINDOW];
+  }
+  return ret;
+}
+
+//*****************************************************************************
+bool Profiler::summary(const std::string& name, ScopeSummary& summary) const
+{
+  auto it = m_scopes.find(name);
+  if (it == m_scopes.end()) return false;
+  summary = summarise(it->first, it->second);
+  return true;
+}
+
+//*****************************************************************************
+std::vector<ScopeSummary> Profiler::summary() const
+{
+  std::vector<ScopeSummary> ret;
+  for (const auto& entry : m_scopes) {
+    ScopeSummary summary = summarise(entry.first, entry.second);
+    if (summary.calls > 0) ret.push_back(summary);
+  }
+  std::sort(ret.begin(), ret.end(), 
+    [](const ScopeSummary& a, const ScopeSummary& b) {
+      return a.average_ms > b.average_ms;
+    }
+  );
+  return ret;
+}
+
+//*****************************************************************************
+void Profiler::print_summary(std::ostream& out) const
+{
+  std::ios::fmtflags flags = out.flags();
+  out << std::left << std::setw(32) << "Scope" << std::right
+      << std::setw(10) << "avg ms" 
+      << std::setw(10) << "max ms" 
+      << std::setw(10) << "last ms" 
+      << std::setw(10) << "calls" << '\n';
+  out << std::fixed << std::setprecision(3);
+  for (const ScopeSummary& summary : this->summary()) {
+    out << std::left << std::setw(32) << summary.name << std::right
+        << std::setw(10) << summary.average_ms
+        << std::setw(10) << summary.max_ms
+        << std::setw(10) << summary.last_ms
+        << std::setw(10) << std::setprecision(1) << summary.calls 
+        << std::setprecision(3) << '\n';
+  }
+  out.flags(flags);
+}
+
+//*****************************************************************************
+void Profiler::start_trace(size_t max_events)
+{
+  m_trace.clear();
+  m_max_events = max_events;
+  m_tracing = true;
+}
+
+//*****************************************************************************
+void Profiler::stop_trace()
+{
+  m_tracing = false;
+}
+
+//*****************************************************************************
+bool Profiler::tracing() const
+{
+  return m_tracing;
+}
+
+//*****************************************************************************
+void Profiler::write_trace(const filesystem::Path& path) const
+//
+// Complete ("X") events on one process, a thread per track, plus metadata
+// events naming the tracks. The GPU track is numbered after the threads.
+//*****************************************************************************
+{
+  std::ofstream out(path.path().c_str(), std::ios::out | std::ios::binary);
+  if (!out) throw std::runtime_error("Can't write " + path.path());
+
+  int gpu_tid = 0;
+  for (const Event& event : m_trace) gpu_tid = std::max(gpu_tid, event.track + 1);
+
+  out << std::fixed << std::setprecision(3);
+  out << "{\"traceEvents\":[\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpu_tid
+      << ",\"args\":{\"name\":\"GPU\"}}";
+  for (int tid = 0; tid < gpu_tid; ++tid) {
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+        << ",\"args\":{\"name\":\"" << (tid == 0 ? "Main" : "Thread ") ;
+    if (tid != 0) out << tid;
+    out << "\"}}";
+  }
+  for (const Event& event : m_trace) {
+    out << ",\n{\"name\":";
+    write_json_string(out, event.name);
+    out << ",\"cat\":\"" << (event.track == GPU_TRACK ? "gpu" : "cpu")
+        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" 
+        << (event.track == GPU_TRACK ? gpu_tid : event.track)
+        << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+  }
+  out << "\n]}\n";
+
+  if (!out) throw std::runtime_error("Can't write " + path.path());
+}
@@ -0,0 +1,263 @@
+//*****************************************************************************
+// Round trip tests for CompressedImage: the BC1 and BC3 encoders against
+// the decoder, and DDS and KTX files written and read back, including
+// truncated and corrupt ones.
+//
+// Usage:
+//
+//   compressed_image_test
+//
+// Build it with the rest of the sources, as for the tools. It needs no GPU.
+// Each failure is printed, and the exit status is non-zero if there were
+// any.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <graphics/CompressedImage.hpp>
+#include <graphics/Image.hpp>
+
+#include "test_utils.hpp"
+
+using namespace graphics;
+using namespace filesystem;
+using namespace tests;
+using namespace Eigen;
+
+//*****************************************************************************
+static void fill_block(Image& image, Vector2i min, const unsigned char* rgba)
+{
+  for (int y = min[1]; y < min[1] + 4; ++y) {
+    for (int x = min[0]; x < min[0] + 4; ++x) {
+      unsigned char* pixel = image.data() + (size_t(y) * image.size()[0] + x) * 4;
+      for (int c = 0; c < 4; ++c) pixel[c] = rgba[c];
+    }
+  }
+}
+
+//*****************************************************************************
+static Image solid_blocks(bool alpha)
+{
+  // Colours that 5:6:5 holds exactly, so that a solid block comes back as
+  // it went in.
+  const unsigned char colours[4][4] = {
+    { 255, 0, 0, 255 },
+    { 0, 255, 0, 255 },
+    { 0, 0, 255, 128 },
+    { 255, 255, 255, 0 }
+  };
+  Image image(Vector2i(8, 8));
+  for (int i = 0; i < 4; ++i) {
+    unsigned char rgba[4] = { 
+      colours[i][0], colours[i][1], colours[i][2], 
+      alpha ? colours[i][3] : (unsigned char)255 
+    };
+    fill_block(image, Vector2i(i % 2 * 4, i / 2 * 4), rgba);
+  }
+  return image;
+}
+
+//*****************************************************************************
+static Image gradient(Vector2i size, bool alpha)
+{
+  // The colour only changes across and the alpha only down, so each block's
+  // colours lie on a line - which is what block compression does well - and
+  // the error is just the quantisation.
+  Image image(size);
+  unsigned char* pixel = image.data();
+  for (int y = 0; y < size[1]; ++y) {
+    for (int x = 0; x < size[0]; ++x) {
+      int t = x * 255 / (size[0] - 1);
+      *pixel++ = static_cast<unsigned char>(t);
+      *pixel++ = static_cast<unsigned char>(255 - t);
+      *pixel++ = 64;
+      *pixel++ = alpha ? static_cast<unsigned char>(y * 255 / (size[1] - 1)) : 255;
+    }
+  }
+  return image;
+}
+
+//*****************************************************************************
+static int max_error(const Image& a, const Image& b, int channels)
+{
+  if (a.size() != b.size()) return 256;
+  int worst = 0;
+  for (size_t i = 0; i < a.byte_size(); ++i) {
+    if (int(i % 4) >= channels) continue;
+    worst = std::max(worst, std::abs(int(a.data()[i]) - int(b.data()[i])));
+  }
+  return worst;
+}
+
+//*****************************************************************************
+static bool same_levels(const CompressedImage& a, const CompressedImage& b)
+{
+  if (a.format() != b.format() || a.size() != b.size() ||
+      a.level_count() != b.level_count()) {
+    return false;
+  }
+  for (int i = 0; i < a.level_count(); ++i) {
+    if (a.level(i) != b.level(i)) return false;
+  }
+  return true;
+}
+
+//*****************************************************************************
+static std::vector<unsigned char> make_ktx(const CompressedImage& image)
+//
+// There's no KTX writer, so lay the file out here: the identifier, a 13 word
+// header, no key/value data, and each level preceded by its size.
+//*****************************************************************************
+{
+  const unsigned char identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+  };
+  std::vector<unsigned char> data(identifier, identifier + 12);
+  put_u32(data, 12, 0x04030201);
+  put_u32(data, 16, 0);   // glType
+  put_u32(data, 20, 1);   // glTypeSize
+  put_u32(data, 24, 0);   // glFormat
+  put_u32(data, 28, image.format() == TextureFormat::BC1 ? 0x83F1 : 0x83F3);
+  put_u32(data, 32, 0x1908);
+  put_u32(data, 36, image.size()[0]);
+  put_u32(data, 40, image.size()[1]);
+  put_u32(data, 44, 0);   // Depth
+  put_u32(data, 48, 0);   // Array elements
+  put_u32(data, 52, 1);   // Faces
+  put_u32(data, 56, image.level_count());
+  put_u32(data, 60, 0);   // Key/value bytes
+  for (int i = 0; i < image.level_count(); ++i) {
+    const std::vector<unsigned char>& level = image.level(i);
+    put_u32(data, data.size(), static_cast<uint32_t>(level.size()));
+    data.insert(data.end(), level.begin(), level.end());
+    data.resize((data.size() + 3) & ~size_t(3));
+  }
+  return data;
+}
+
+//*****************************************************************************
+static void test_encode()
+{
+  Image bc1_source = solid_blocks(false);
+  CompressedImage bc1 = CompressedImage::encode(bc1_source, TextureFormat::BC1);
+  check(bc1.format() == TextureFormat::BC1, "BC1 format");
+  check(bc1.level(0).size() == 4 * 8, "BC1 is 8 bytes a block");
+  check(max_error(bc1.decode(), bc1_source, 4) == 0, "BC1 solid blocks are exact");
+
+  Image bc3_source = solid_blocks(true);
+  CompressedImage bc3 = CompressedImage::encode(bc3_source, TextureFormat::BC3);
+  check(bc3.level(0).size() == 4 * 16, "BC3 is 16 bytes a block");
+  check(max_error(bc3.decode(), bc3_source, 4) == 0, "BC3 solid blocks are exact");
+
+  Image opaque = gradient(Vector2i(32, 16), false);
+  Image ramp = gradient(Vector2i(32, 16), true);
+  int bc1_error = max_error(CompressedImage::encode(opaque, TextureFormat::BC1).decode(), opaque, 4);
+  int bc3_error = max_error(CompressedImage::encode(ramp, TextureFormat::BC3).decode(), ramp, 4);
+  check(bc1_error <= 24, "BC1 ramp error " + std::to_string(bc1_error));
+  check(bc3_error <= 24, "BC3 ramp error " + std::to_string(bc3_error));
+
+  // A size that isn't a multiple of 4 still takes whole blocks.
+  Image odd = gradient(Vector2i(6, 5), true);
+  CompressedImage small = CompressedImage::encode(odd, TextureFormat::BC3, true);
+  check(small.level_count() == 3, "6x5 has 3 levels");
+  check(small.level_size(2) == Vector2i(1, 1), "last level is 1x1");
+  check(small.level(0).size() == 4 * 16, "6x5 is 2x2 blocks");
+  check(small.decode().size() == Vector2i(6, 5), "decode keeps the size");
+  int odd_error = max_error(small.decode(), odd, 4);
+  check(odd_error <= 24, "6x5 error " + std::to_string(odd_error));
+}
+
+//*****************************************************************************
+static void test_dds()
+{
+  const std::string path = "compressed_image_test.dds";
+  CompressedImage image = CompressedImage::encode(gradient(Vector2i(16, 8), false), TextureFormat::BC1, true);
+  image.save_dds(Path(path));
+  check(same_levels(CompressedImage(Path(path)), image), "DDS round trip");
+
+  CompressedImage bc3 = CompressedImage::encode(gradient(Vector2i(8, 8), true), TextureFormat::BC3);
+  bc3.save_dds(Path(path));
+  check(same_levels(CompressedImage(Path(path)), bc3), "DDS BC3 round trip");
+
+  std::vector<unsigned char> good = read_file(path);
+
+  std::vector<unsigned char> data = good;
+  data.pop_back();
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "truncated DDS");
+
+  data.resize(64);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "DDS with a short header");
+
+  data = good;
+  data[0] = 'X';
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "DDS with a bad magic number");
+
+  data = good;
+  put_u32(data, 28, 40);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "DDS with 40 levels");
+
+  data = good;
+  put_u32(data, 16, 0);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "DDS with no width");
+
+  std::remove(path.c_str());
+}
+
+//*****************************************************************************
+static void test_ktx()
+{
+  const std::string path = "compressed_image_test.ktx";
+  CompressedImage image = CompressedImage::encode(gradient(Vector2i(8, 16), true), TextureFormat::BC3, true);
+  std::vector<unsigned char> good = make_ktx(image);
+  write_file(path, good);
+  check(same_levels(CompressedImage(Path(path)), image), "KTX round trip");
+
+  std::vector<unsigned char> data = good;
+  data.resize(data.size() - 8);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "truncated KTX");
+
+  data.resize(40);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "KTX with a short header");
+
+  data = good;
+  put_u32(data, 56, 40);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "KTX with 40 levels");
+
+  data = good;
+  put_u32(data, 28, 0x8058);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "KTX in an uncompressed format");
+
+  data = good;
+  put_u32(data, 60, 0x10000000);
+  write_file(path, data);
+  check_throws([&] { CompressedImage x((Path(path))); }, "KTX with too much key/value data");
+
+  std::remove(path.c_str());
+}
+
+//*****************************************************************************
+int main()
+{
+  try {
+    test_encode();
+    test_dds();
+    test_ktx();
+  } catch (std::exception& e) {
+    check(false, std::string("unexpected exception: ") + e.what());
+  }
+  return finish();
+}
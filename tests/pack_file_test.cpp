@@ -0,0 +1,189 @@
+//*****************************************************************************
+// Round trip tests for pack archives: packs written with PackWriter and
+// mounted with PackFile, and packs with broken indices, which must be
+// rejected at mount time rather than trusted by find().
+//
+// Usage:
+//
+//   pack_file_test
+//
+// Build it with the rest of the sources, as for the tools. Each failure is
+// printed, and the exit status is non-zero if there were any.
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <filesystem/PackFile.hpp>
+
+#include "test_utils.hpp"
+
+using namespace filesystem;
+using namespace tests;
+
+//*****************************************************************************
+static std::vector<unsigned char> contents(const std::string& name, size_t size)
+{
+  std::vector<unsigned char> ret(size);
+  for (size_t i = 0; i < size; ++i) ret[i] = static_cast<unsigned char>(name[i % name.size()] + i);
+  return ret;
+}
+
+//*****************************************************************************
+static bool find(const PackFile& pack, const std::string& name, std::vector<unsigned char>& out)
+{
+  const unsigned char* data;
+  size_t size;
+  if (!pack.find(name, data, size)) return false;
+  out.assign(data, data + size);
+  return true;
+}
+
+//*****************************************************************************
+static void test_round_trip(const std::string& path)
+{
+  // Enough files that the hash table has collisions to probe past.
+  std::vector<std::string> names;
+  for (int i = 0; i < 200; ++i) {
+    names.push_back("data/textures/file" + std::to_string(i) + ".png");
+  }
+  names.push_back("data/empty");
+  names.push_back("a");
+
+  PackWriter writer;
+  for (size_t i = 0; i < names.size(); ++i) {
+    size_t size = names[i] == "data/empty" ? 0 : i * 37 % 1000 + 1;
+    writer.add(names[i], contents(names[i], size));
+  }
+  writer.add(".\\data\\\\shaders/sprite.glsl", contents("shader", 100));
+  check_throws(
+    [&] { writer.add("data/textures/file0.png", contents("again", 10)); },
+    "adding a name twice"
+  );
+  writer.save(Path(path));
+
+  PackFile pack((Path(path)));
+  check(pack.file_count() == names.size() + 1, "file count");
+  std::set<std::string> listed;
+  for (size_t i = 0; i < pack.file_count(); ++i) listed.insert(pack.file_name(i));
+  check(listed.size() == names.size() + 1, "file names are distinct");
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    size_t size = names[i] == "data/empty" ? 0 : i * 37 % 1000 + 1;
+    std::vector<unsigned char> data;
+    check(find(pack, names[i], data), "find " + names[i]);
+    check(data == contents(names[i], size), "contents of " + names[i]);
+    check(listed.count(names[i]) == 1, "listed " + names[i]);
+  }
+
+  std::vector<unsigned char> data;
+  check(find(pack, "data/shaders/sprite.glsl", data), "find a normalised name");
+  check(data == contents("shader", 100), "contents of a normalised name");
+  check(!find(pack, "data/textures/missing.png", data), "a missing name isn't found");
+  check(!find(pack, "", data), "the empty name isn't found");
+  check(!find(pack, "DATA/EMPTY", data), "names are case sensitive");
+}
+
+//*****************************************************************************
+static void test_empty(const std::string& path)
+{
+  PackWriter().save(Path(path));
+  PackFile pack((Path(path)));
+  std::vector<unsigned char> data;
+  check(pack.file_count() == 0, "empty pack has no files");
+  check(!find(pack, "anything", data), "empty pack finds nothing");
+}
+
+//*****************************************************************************
+static void test_corrupt(const std::string& path)
+//
+// The header is the magic number, version, entry count and slot count, and
+// then 64 bit offsets of the entries, the slots and the names.
+//*****************************************************************************
+{
+  PackWriter writer;
+  for (int i = 0; i < 5; ++i) {
+    std::string name = "file" + std::to_string(i);
+    writer.add(name, contents(name, 10));
+  }
+  writer.save(Path(path));
+  const std::vector<unsigned char> good = read_file(path);
+  const uint32_t entry_count = get_u32(good, 8);
+  const uint32_t slot_count = get_u32(good, 12);
+  const size_t slots = static_cast<size_t>(get_u64(good, 24));
+  check(entry_count == 5, "entry count");
+  check(slot_count > entry_count, "there are spare slots");
+
+  auto mount = [&](const std::vector<unsigned char>& data) {
+    write_file(path, data);
+    PackFile pack((Path(path)));
+  };
+
+  std::vector<unsigned char> data = good;
+  data.pop_back();
+  check_throws([&] { mount(data); }, "truncated pack");
+
+  data.resize(20);
+  check_throws([&] { mount(data); }, "pack with a short header");
+
+  data = good;
+  data[0] = 'X';
+  check_throws([&] { mount(data); }, "pack with a bad magic number");
+
+  data = good;
+  put_u32(data, 12, slot_count * 4);
+  check_throws([&] { mount(data); }, "pack with a slot table past the end");
+
+  // Fill every empty slot with an entry that's already there. Before the
+  // table was checked, looking up a missing name went round forever.
+  data = good;
+  for (uint32_t i = 0; i < slot_count; ++i) {
+    if (get_u32(data, slots + 4 * i) == 0) put_u32(data, slots + 4 * i, 1);
+  }
+  check_throws([&] { mount(data); }, "pack with no empty slot");
+
+  data = good;
+  for (uint32_t i = 0; i < slot_count; ++i) {
+    if (get_u32(data, slots + 4 * i) == 0) {
+      put_u32(data, slots + 4 * i, 2);
+      break;
+    }
+  }
+  check_throws([&] { mount(data); }, "pack with an entry in two slots");
+
+  data = good;
+  for (uint32_t i = 0; i < slot_count; ++i) {
+    if (get_u32(data, slots + 4 * i) == 3) put_u32(data, slots + 4 * i, 0);
+  }
+  check_throws([&] { mount(data); }, "pack with an entry missing from the table");
+
+  data = good;
+  for (uint32_t i = 0; i < slot_count; ++i) {
+    if (get_u32(data, slots + 4 * i) == 0) {
+      put_u32(data, slots + 4 * i, entry_count + 1);
+      break;
+    }
+  }
+  check_throws([&] { mount(data); }, "pack with a slot past the last entry");
+
+  mount(good);
+}
+
+//*****************************************************************************
+int main()
+{
+  const std::string path = "pack_file_test.pack";
+  try {
+    test_round_trip(path);
+    test_empty(path);
+    test_corrupt(path);
+  } catch (std::exception& e) {
+    check(false, std::string("unexpected exception: ") + e.what());
+  }
+  std::remove(path.c_str());
+  return finish();
+}
@@ -0,0 +1,59 @@
+#!/bin/sh
+#******************************************************************************
+# Build and run every test in this directory.
+#
+# Usage, from the repository root:
+#
+#   tests/run_tests.sh [test name...]
+#
+# The library sources are compiled once into $BUILD_DIR (default
+# _test_build), and each tests/*_test.cpp is linked against them and run
+# there, from the repository root so that data/ can be found. The tests that
+# need OpenGL use a HeadlessContext; on Mesa, software rendering works with
+#
+#   EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1 tests/run_tests.sh
+#
+# Set CXX, CXXFLAGS and LIBS to match how the rest of the tree is built; the
+# defaults expect GLEW, GLFW, EGL and Eigen to be installed system-wide. The
+# exit status is non-zero if anything fails to build or any test fails.
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++11 -O2 -I/usr/include/eigen3"}
+LIBS=${LIBS:-"-lglfw -lGLEW -lEGL -lGL -lpthread"}
+BUILD_DIR=${BUILD_DIR:-_test_build}
+JOBS=${JOBS:-$(nproc 2>/dev/null || echo 4)}
+
+mkdir -p "$BUILD_DIR/obj" || exit 1
+
+# Only recompile sources newer than their objects.
+for source in src/*/*.cpp; do
+  object="$BUILD_DIR/obj/$(echo "$source" | sed 's|/|_|g; s|\.cpp$|.o|')"
+  if [ ! -f "$object" ] || [ "$source" -nt "$object" ] ||
+     [ -n "$(find include -newer "$object" -name '*.hpp' | head -n 1)" ]; then
+    echo "$source $object"
+  fi
+done | xargs -r -n 2 -P "$JOBS" sh -c \
+  "$CXX $CXXFLAGS -Iinclude -c \"\$0\" -o \"\$1\" || exit 255" || exit 1
+
+if [ $# -gt 0 ]; then
+  tests=$(for name in "$@"; do echo "tests/$name.cpp"; done)
+else
+  tests=$(ls tests/*_test.cpp)
+fi
+
+failed=""
+for test in $tests; do
+  name=$(basename "$test" .cpp)
+  echo "== $name"
+  if ! $CXX $CXXFLAGS -Iinclude "$test" "$BUILD_DIR"/obj/*.o $LIBS -o "$BUILD_DIR/$name"; then
+    failed="$failed $name"
+    continue
+  fi
+  "$BUILD_DIR/$name" || failed="$failed $name"
+done
+
+if [ -n "$failed" ]; then
+  echo "Failed:$failed"
+  exit 1
+fi
+echo "All tests passed"
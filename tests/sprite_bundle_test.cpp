@@ -0,0 +1,277 @@
+//*****************************************************************************
+// Round trip tests for sprite bundles: bundles baked with SpriteBundleWriter
+// and loaded with SpriteBundle, from disk and from inside a pack, and
+// bundles with broken tables, which must throw.
+//
+// Usage:
+//
+//   sprite_bundle_test
+//
+// Build it with the rest of the sources, as for the tools. It runs through
+// a HeadlessContext, so no display is needed; on Mesa,
+//
+//   EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1 sprite_bundle_test
+//
+// Run it from the repository root so that data/ can be found.
+// Each failure is printed, and the exit status is non-zero if there were
+// any.
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <filesystem/PackFile.hpp>
+
+#include <graphics/CompressedImage.hpp>
+#include <graphics/GraphicsSystem.hpp>
+#include <graphics/Image.hpp>
+#include <graphics/Sprite.hpp>
+#include <graphics/SpriteBundle.hpp>
+
+#include "test_utils.hpp"
+
+using namespace graphics;
+using namespace filesystem;
+using namespace tests;
+using namespace Eigen;
+
+//*****************************************************************************
+static Image pattern(Vector2i size, int seed)
+{
+  Image image(size);
+  unsigned char* pixel = image.data();
+  for (int y = 0; y < size[1]; ++y) {
+    for (int x = 0; x < size[0]; ++x) {
+      *pixel++ = static_cast<unsigned char>(x * 16 + seed);
+      *pixel++ = static_cast<unsigned char>(y * 16 + seed);
+      *pixel++ = static_cast<unsigned char>(seed * 40);
+      *pixel++ = 255;
+    }
+  }
+  return image;
+}
+
+//*****************************************************************************
+static std::vector<unsigned char> texture_level(Texture& texture, int level, bool compressed)
+{
+  // Read back whatever OpenGL holds, to compare with what was baked.
+  texture.bind(TextureTarget::TEXTURE_2D);
+  GLint bytes = 0;
+  if (compressed) {
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+  } else {
+    GLint width = 0;
+    GLint height = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+    bytes = width * height * 4;
+  }
+  std::vector<unsigned char> ret(bytes);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (compressed) {
+    glGetCompressedTexImage(GL_TEXTURE_2D, level, ret.data());
+  } else {
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, ret.data());
+  }
+  return ret;
+}
+
+//*****************************************************************************
+static void check_bundle(
+  SpriteBundle& bundle,
+  const CompressedImage& bc3,
+  const Image& rgba,
+  const std::string& where
+)
+{
+  check(bundle.texture_count() == 2, where + ": texture count");
+  if (bundle.texture_count() != 2) return;
+
+  Texture& first = *bundle.texture(0);
+  check(first.size() == bc3.size(), where + ": BC3 texture size");
+  check(first.level_count() == bc3.level_count(), where + ": BC3 level count");
+  if (first.format() == TextureFormat::BC3) {
+    for (int i = 0; i < bc3.level_count(); ++i) {
+      check(texture_level(first, i, true) == bc3.level(i), where + ": BC3 level " + std::to_string(i));
+    }
+  } else {
+    // Decompressed on a GPU without BC3.
+    check(texture_level(first, 0, false) == std::vector<unsigned char>(
+      bc3.decode().data(), bc3.decode().data() + bc3.decode().byte_size()
+    ), where + ": decompressed BC3");
+  }
+
+  Texture& second = *bundle.texture(1);
+  check(second.format() == TextureFormat::RGBA8, where + ": RGBA8 format");
+  check(second.size() == rgba.size(), where + ": RGBA8 size");
+  check(second.level_count() == 1, where + ": RGBA8 level count");
+  check(texture_level(second, 0, false) == std::vector<unsigned char>(
+    rgba.data(), rgba.data() + rgba.byte_size()
+  ), where + ": RGBA8 pixels");
+
+  check(bundle.has_animation("walk"), where + ": has walk");
+  check(bundle.has_animation("idle"), where + ": has idle");
+  check(!bundle.has_animation("run"), where + ": hasn't run");
+  check_throws([&] { bundle.animation("run"); }, where + ": missing animation");
+
+  TextureRegion walk = bundle.region("walk");
+  check(walk.texture == bundle.texture(0), where + ": walk texture");
+  check(walk.min == Vector2i(0, 0) && walk.size == Vector2i(32, 16), where + ": walk region");
+  std::shared_ptr<Animation> animation = bundle.animation("walk");
+  check(animation->size() == Vector2i(16, 16), where + ": walk frame size");
+  check(animation->frame_count() == 2, where + ": walk frame count");
+  check(animation->period() == 100, where + ": walk period");
+
+  TextureRegion idle = bundle.region("idle");
+  check(idle.texture == bundle.texture(1), where + ": idle texture");
+  check(idle.min == Vector2i(4, 0) && idle.size == Vector2i(4, 4), where + ": idle region");
+  check(bundle.animation("idle")->frame_count() == 1, where + ": idle frame count");
+
+  // And the animations can be drawn.
+  Sprite sprite;
+  sprite.set_animation(animation);
+  sprite.set_position(Vector2f(32, 32));
+  sprite.draw();
+  check(glGetError() == GL_NO_ERROR, where + ": drawing");
+}
+
+//*****************************************************************************
+static void test_round_trip(GraphicsSystem& graphics, const std::string& path)
+{
+  CompressedImage bc3 = CompressedImage::encode(pattern(Vector2i(32, 16), 1), TextureFormat::BC3, true);
+  Image rgba = pattern(Vector2i(8, 4), 2);
+
+  SpriteBundleWriter writer;
+  check(writer.add_texture(bc3) == 0, "first texture index");
+  check(writer.add_texture(rgba, TextureFormat::RGBA8) == 1, "second texture index");
+  writer.add_animation("walk", 0, Vector2i(0, 0), Vector2i(32, 16), Vector2i(16, 16), 2, 100);
+  writer.add_animation("idle", 1, Vector2i(4, 0), Vector2i(4, 4), Vector2i(4, 4), 1, 50);
+  writer.save(Path(path));
+
+  SpriteBundle bundle(graphics, Path(path));
+  check_bundle(bundle, bc3, rgba, "from disk");
+
+  // The same bundle, packed. Its blobs should still be aligned, so it loads
+  // straight out of the pack's mapping.
+  const std::string pack_path = path + ".pack";
+  PackWriter packer;
+  packer.add("padding", std::vector<unsigned char>(3, 0));
+  packer.add("sprites/test.bundle", read_file(path));
+  packer.save(Path(pack_path));
+  graphics.file_system().mount(Path(pack_path));
+  {
+    SpriteBundle packed(graphics, Path("sprites/test.bundle"));
+    check_bundle(packed, bc3, rgba, "from a pack");
+  }
+  std::remove(pack_path.c_str());
+}
+
+//*****************************************************************************
+static void test_corrupt(GraphicsSystem& graphics, const std::string& path)
+//
+// The header is the magic number, version, texture count and animation
+// count, and then 64 bit offsets of the textures, animations and names. A
+// texture record starts with its format, width, height and level count; an
+// animation record with its name's offset and length and its texture, which
+// are followed by what's described below.
+//*****************************************************************************
+{
+  SpriteBundleWriter writer;
+  writer.add_texture(pattern(Vector2i(8, 8), 3), TextureFormat::RGBA8, true);
+  writer.add_animation("a", 0, Vector2i(0, 0), Vector2i(8, 8), Vector2i(8, 8), 1, 100);
+  writer.save(Path(path));
+  const std::vector<unsigned char> good = read_file(path);
+  const size_t textures = static_cast<size_t>(get_u64(good, 16));
+  const size_t animations = static_cast<size_t>(get_u64(good, 24));
+
+  auto load = [&](const std::vector<unsigned char>& data) {
+    write_file(path, data);
+    SpriteBundle bundle(graphics, Path(path));
+  };
+
+  std::vector<unsigned char> data = good;
+  data.pop_back();
+  check_throws([&] { load(data); }, "truncated bundle");
+
+  data.resize(30);
+  check_throws([&] { load(data); }, "bundle with a short header");
+
+  data = good;
+  data[0] = 'X';
+  check_throws([&] { load(data); }, "bundle with a bad magic number");
+
+  data = good;
+  put_u32(data, 8, 1000);
+  check_throws([&] { load(data); }, "bundle with too many textures");
+
+  data = good;
+  put_u32(data, textures, 1000);
+  check_throws([&] { load(data); }, "texture in an unknown format");
+
+  data = good;
+  put_u32(data, textures + 4, 0);
+  check_throws([&] { load(data); }, "texture with no width");
+
+  data = good;
+  put_u32(data, textures + 8, 16);
+  check_throws([&] { load(data); }, "texture with levels of the wrong size");
+
+  data = good;
+  put_u32(data, textures + 12, 99);
+  check_throws([&] { load(data); }, "texture with too many levels");
+
+  data = good;
+  put_u32(data, animations + 8, 1);
+  check_throws([&] { load(data); }, "animation of a missing texture");
+
+  data = good;
+  put_u32(data, animations + 4, 1000);
+  check_throws([&] { load(data); }, "animation name past the end");
+
+  // The rest of an animation record is its region's min and size, its frame
+  // size, frame count and period. The texture is 8x8, and so is the one
+  // frame.
+  const struct {
+    size_t offset;
+    uint32_t value;
+    const char* what;
+  } bad_animations[] = {
+    { 12, uint32_t(-1), "animation region starting outside the texture" },
+    { 12, 4, "animation region running off the texture" },
+    { 24, 16, "animation region taller than the texture" },
+    { 20, 0, "animation region with no width" },
+    { 28, 0, "animation with no frame width" },
+    { 32, uint32_t(-8), "animation with a negative frame height" },
+    { 28, 16, "animation with frames wider than its region" },
+    { 36, 0, "animation with no frames" },
+    { 36, 2, "animation with more frames than fit" },
+    { 40, 0, "animation with a zero period" },
+    { 40, 0x7fc00000, "animation with a NaN period" },
+    { 40, 0x7f800000, "animation with an infinite period" }
+  };
+  for (const auto& bad : bad_animations) {
+    data = good;
+    put_u32(data, animations + bad.offset, bad.value);
+    check_throws([&] { load(data); }, bad.what);
+  }
+
+  load(good);
+}
+
+//*****************************************************************************
+int main()
+{
+  const std::string path = "sprite_bundle_test.bundle";
+  try {
+    GraphicsSystem graphics(Vector2i(64, 64));
+    test_round_trip(graphics, path);
+    test_corrupt(graphics, path);
+  } catch (std::exception& e) {
+    check(false, std::string("unexpected exception: ") + e.what());
+  }
+  std::remove(path.c_str());
+  return finish();
+}
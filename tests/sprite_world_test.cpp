@@ -0,0 +1,117 @@
+//*****************************************************************************
+// Tests for SpriteWorld::pick() and query(): hits come back in the order the
+// last draw() put them on screen, bottom first.
+//
+// Usage:
+//
+//   sprite_world_test
+//
+// Build and run it with tests/run_tests.sh. It runs through a
+// HeadlessContext, from the repository root so that data/ can be found.
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <graphics/GraphicsSystem.hpp>
+#include <graphics/Sprite.hpp>
+#include <graphics/SpriteBatch.hpp>
+#include <graphics/SpriteWorld.hpp>
+
+#include "test_utils.hpp"
+
+using namespace graphics;
+using namespace filesystem;
+using namespace tests;
+using namespace Eigen;
+
+//*****************************************************************************
+static bool same(
+  const std::vector<SpriteHandle>& hits,
+  const std::vector<SpriteHandle>& expected
+)
+{
+  if (hits.size() != expected.size()) return false;
+  for (size_t i = 0; i < hits.size(); ++i) {
+    if (hits[i].index != expected[i].index) return false;
+    if (hits[i].generation != expected[i].generation) return false;
+  }
+  return true;
+}
+
+//*****************************************************************************
+static void test_hit_order(GraphicsSystem& graphics)
+//
+// Two sprites with one texture either side of one with another. The batch
+// draws the first texture's sprites together, before the second texture,
+// so the one in the middle of the arrays is the one on top.
+//*****************************************************************************
+{
+  std::shared_ptr<Animation> a = std::make_shared<Animation>(
+    graphics, Path("data/textures/planet.png"), Vector2i(16, 16), 1, 100.0f
+  );
+  std::shared_ptr<Animation> b = std::make_shared<Animation>(
+    graphics, Path("data/textures/red_planet.png"), Vector2i(16, 16), 1, 100.0f
+  );
+
+  SpriteWorld world;
+  SpriteHandle first = world.create();
+  SpriteHandle middle = world.create();
+  SpriteHandle last = world.create();
+  world.set_animation(first, a);
+  world.set_animation(middle, b);
+  world.set_animation(last, a);
+  world.set_position(first, Vector2f(40, 40));
+  world.set_position(middle, Vector2f(10, 10));
+  world.set_position(last, Vector2f(10, 10));
+
+  // Before anything is drawn, everything counts as drawn.
+  std::vector<SpriteHandle> expected;
+  expected.push_back(last);
+  expected.push_back(middle);
+  check(same(world.pick(Vector2f(15, 15)), expected), "pick before drawing");
+
+  SpriteBatch batch(graphics);
+  world.draw(batch);
+  batch.draw();
+  batch.clear();
+  check(same(world.pick(Vector2f(15, 15)), expected), "pick after drawing");
+  check(
+    same(world.query(Vector2f(12, 12), Vector2f(20, 20)), expected),
+    "query after drawing"
+  );
+
+  // With the first sprite culled, the second texture is drawn first.
+  world.set_position(first, Vector2f(1000, 1000));
+  world.draw(batch);
+  batch.draw();
+  batch.clear();
+  expected.clear();
+  expected.push_back(middle);
+  expected.push_back(last);
+  check(same(world.pick(Vector2f(15, 15)), expected), "pick with first culled");
+
+  // Sprites with the same texture stay in the order they're drawn in.
+  SpriteHandle top = world.create();
+  world.set_animation(top, b);
+  world.set_position(top, Vector2f(10, 10));
+  expected.clear();
+  expected.push_back(middle);
+  expected.push_back(top);
+  expected.push_back(last);
+  check(same(world.pick(Vector2f(15, 15)), expected), "pick within a texture");
+}
+
+//*****************************************************************************
+int main()
+{
+  try {
+    GraphicsSystem graphics(Vector2i(64, 64));
+    test_hit_order(graphics);
+  } catch (std::exception& e) {
+    check(false, std::string("unexpected exception: ") + e.what());
+  }
+  return finish();
+}
@@ -0,0 +1,99 @@
+//*****************************************************************************
+// What the tests share: checks that count failures rather than stopping at
+// the first one, and reading, writing and patching files so that broken
+// ones can be made from good ones.
+//
+// e.g.
+//
+//   int main()
+//   {
+//     check(1 + 1 == 2, "addition");
+//     check_throws([] { PackFile pack(Path("missing.pack")); }, "missing pack");
+//     return finish();
+//   }
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tests {
+
+  inline int& failures()
+  {
+    static int count = 0;
+    return count;
+  }
+  // The number of checks that have failed so far.
+
+  inline void check(bool ok, const std::string& what)
+  {
+    if (ok) return;
+    std::cout << "FAILED: " << what << std::endl;
+    ++failures();
+  }
+  // Print a failure, and count it, unless ok.
+
+  inline void check_throws(std::function<void()> f, const std::string& what)
+  {
+    try {
+      f();
+    } catch (std::runtime_error&) {
+      return;
+    }
+    check(false, what + " should throw");
+  }
+  // Check that f throws a std::runtime_error.
+
+  inline int finish()
+  {
+    if (failures() == 0) std::cout << "All passed" << std::endl;
+    return failures() == 0 ? 0 : 1;
+  }
+  // Report and get the exit status for main().
+
+  inline std::vector<unsigned char> read_file(const std::string& path)
+  {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return std::vector<unsigned char>(
+      (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()
+    );
+  }
+
+  inline void write_file(const std::string& path, const std::vector<unsigned char>& data)
+  {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+  }
+
+  inline uint32_t get_u32(const std::vector<unsigned char>& data, size_t offset)
+  {
+    uint32_t value;
+    std::memcpy(&value, &data[offset], sizeof(value));
+    return value;
+  }
+
+  inline uint64_t get_u64(const std::vector<unsigned char>& data, size_t offset)
+  {
+    uint64_t value;
+    std::memcpy(&value, &data[offset], sizeof(value));
+    return value;
+  }
+
+  inline void put_u32(std::vector<unsigned char>& data, size_t offset, uint32_t value)
+  {
+    if (data.size() < offset + sizeof(value)) data.resize(offset + sizeof(value));
+    std::memcpy(&data[offset], &value, sizeof(value));
+  }
+  // Little-endian, like every format here - the tests assume a little-endian
+  // machine. put_u32() grows the data if need be.
+
+}
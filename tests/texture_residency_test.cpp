@@ -0,0 +1,153 @@
+//*****************************************************************************
+// Tests for TextureResidency: textures are shrunk and evicted to meet the
+// budget, and only come back when they're bound again.
+//
+// Usage:
+//
+//   texture_residency_test
+//
+// Build and run it with tests/run_tests.sh. It runs through a
+// HeadlessContext, from the repository root so that data/ can be found.
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <graphics/GraphicsSystem.hpp>
+#include <graphics/Texture.hpp>
+#include <graphics/TextureResidency.hpp>
+
+#include "test_utils.hpp"
+
+using namespace graphics;
+using namespace filesystem;
+using namespace tests;
+using namespace Eigen;
+
+//*****************************************************************************
+static bool run_frames(
+  TextureResidency& residency,
+  std::function<void()> draw,
+  std::function<bool()> done
+)
+{
+  // Reloads finish on the job system, so give them a while.
+  for (int i = 0; i < 200; ++i) {
+    draw();
+    residency.end_frame();
+    if (done()) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return false;
+}
+
+//*****************************************************************************
+static void test_evict_everything(GraphicsSystem& graphics)
+//
+// A budget nothing fits in. The drop pass starts reloads of the mipmapped
+// textures, and the evict pass then has to take them anyway; the abandoned
+// reloads mustn't bring them back.
+//*****************************************************************************
+{
+  // Textures that aren't reloadable, such as the headless render target,
+  // still count; nothing here can touch them.
+  TextureResidency& residency = graphics.residency();
+  const size_t fixed = residency.resident_bytes();
+  Texture a(graphics, TextureTarget::TEXTURE_2D, Path("data/textures/lucy.png"), TextureFormat::RGBA8, Mipmaps::CPU);
+  Texture b(graphics, TextureTarget::TEXTURE_2D, Path("data/textures/planet.png"), TextureFormat::RGBA8, Mipmaps::CPU);
+  Texture c(graphics, TextureTarget::TEXTURE_2D, Path("data/textures/planet.png"));
+  int evictions = residency.evictions();
+
+  residency.set_budget(1);
+  residency.end_frame();
+  check(residency.evictions() - evictions == 3, "everything is evicted at once");
+  check(residency.resident_bytes() == fixed, "nothing is left");
+  check(!a.resident() && !b.resident() && !c.resident(), "nothing is resident");
+  check(!a.loading() && !b.loading(), "abandoned reloads aren't loading");
+
+  run_frames(residency, [] {}, [] { return false; });
+  check(!a.resident() && !b.resident() && !c.resident(), "nothing comes back unbound");
+  check(residency.resident_bytes() == fixed, "still nothing");
+
+  // Bound every frame, a comes back and stays; the others stay out.
+  auto bind_a = [&] { a.bind(TextureTarget::TEXTURE_2D); };
+  check(run_frames(residency, bind_a, [&] { return a.resident(); }), "a comes back when bound");
+  run_frames(residency, bind_a, [] { return false; });
+  check(a.resident(), "a stays while it's bound");
+  check(!b.resident() && !c.resident(), "the others stay out");
+  check(residency.resident_bytes() == fixed + a.byte_size(), "only a is counted");
+  residency.set_budget(0);
+}
+
+//*****************************************************************************
+static void test_drop_then_evict(GraphicsSystem& graphics)
+//
+// Dropping a level from both isn't enough, so the larger one is evicted as
+// well - which, counted at its reduced size, is then enough. The evicted
+// texture's abandoned reload mustn't bring it back, and the other one must
+// be left to finish its drop.
+//*****************************************************************************
+{
+  TextureResidency& residency = graphics.residency();
+  const size_t fixed = residency.resident_bytes();
+  Texture large(graphics, TextureTarget::TEXTURE_2D, Path("data/textures/lucy.png"), TextureFormat::RGBA8, Mipmaps::CPU);
+  Texture small(graphics, TextureTarget::TEXTURE_2D, Path("data/textures/planet.png"), TextureFormat::RGBA8, Mipmaps::CPU);
+  const size_t small_bytes = small.byte_size();
+  int evictions = residency.evictions();
+
+  residency.set_budget(fixed + small_bytes * 9 / 10);
+  residency.end_frame();
+  check(residency.evictions() - evictions == 1, "only the large texture is evicted");
+  check(!large.resident() && !large.loading(), "the large texture is out");
+  check(small.loading(), "the small texture is dropping a level");
+
+  bool came_back = false;
+  run_frames(residency, [] {}, [&] {
+    came_back = came_back || large.resident();
+    return false;
+  });
+  check(!came_back, "the evicted texture doesn't come back unbound");
+  check(small.resident() && small.dropped_levels() == 1, "the small texture dropped a level");
+  check(residency.resident_bytes() <= residency.budget(), "under budget");
+  residency.set_budget(0);
+}
+
+//*****************************************************************************
+static void test_only_eviction_fits(GraphicsSystem& graphics)
+//
+// Neither texture has a level to drop, so the only way under budget is to
+// evict the one that isn't being used.
+//*****************************************************************************
+{
+  TextureResidency& residency = graphics.residency();
+  Texture used(graphics, TextureTarget::TEXTURE_2D, Path("data/textures/planet.png"));
+  Texture unused(graphics, TextureTarget::TEXTURE_2D, Path("data/textures/lucy.png"));
+  int drops = residency.drops();
+  int evictions = residency.evictions();
+
+  residency.set_budget(residency.resident_bytes() - unused.byte_size() / 2);
+  auto bind_used = [&] { used.bind(TextureTarget::TEXTURE_2D); };
+  run_frames(residency, bind_used, [] { return false; });
+  check(residency.drops() == drops, "nothing to drop");
+  check(residency.evictions() - evictions == 1, "one eviction");
+  check(used.resident() && !unused.resident(), "the unused texture is evicted");
+  check(residency.resident_bytes() <= residency.budget(), "under budget");
+  residency.set_budget(0);
+}
+
+//*****************************************************************************
+int main()
+{
+  try {
+    GraphicsSystem graphics(Vector2i(64, 64));
+    test_evict_everything(graphics);
+    test_drop_then_evict(graphics);
+    test_only_eviction_fits(graphics);
+  } catch (std::exception& e) {
+    check(false, std::string("unexpected exception: ") + e.what());
+  }
+  return finish();
+}
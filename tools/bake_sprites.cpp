@@ -0,0 +1,166 @@
+//*****************************************************************************
+// Bake-time sprite bundler.
+//
+// Usage:
+//
+//   bake_sprites <manifest> <output bundle>
+//
+// The manifest lists the animations to bake, one per line:
+//
+//   # Comments start with a hash.
+//   page_size 2048 2048
+//   format bc3
+//   mipmaps on
+//   animation lucy data/textures/lucy.png 64 64 8 100
+//
+// An animation line gives a name, a sprite sheet, the frame width and height,
+// the frame count and the milliseconds per frame. The sheets are packed into
+// atlas pages of at most page_size (default 2048 x 2048), which are stored in
+// the given format (default rgba8; also rgba4, rgb5_a1, r8, bc1 and bc3), with
+// a full mip chain if mipmaps is on (default off). Sheets are only padded by
+// a pixel, so the smallest levels blend neighbouring sheets together; that's
+// fine for sprites that shrink a little, less so for ones that vanish into
+// the distance. The result is a SpriteBundle, which loads without decoding
+// anything.
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <graphics/Image.hpp>
+#include <graphics/SpriteBundle.hpp>
+#include <graphics/TextureAtlas.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+using namespace Eigen;
+
+//*****************************************************************************
+struct AnimationLine {
+  std::string name;
+  int id;
+  Vector2i frame_size;
+  int frame_count;
+  float period;
+};
+
+//*****************************************************************************
+static TextureFormat parse_format(const std::string& name)
+{
+  if (name == "rgba8")   return TextureFormat::RGBA8;
+  if (name == "rgba4")   return TextureFormat::RGBA4;
+  if (name == "rgb5_a1") return TextureFormat::RGB5_A1;
+  if (name == "r8")      return TextureFormat::R8;
+  if (name == "bc1")     return TextureFormat::BC1;
+  if (name == "bc3")     return TextureFormat::BC3;
+  throw std::runtime_error("Unknown format " + name);
+}
+
+//*****************************************************************************
+static void bake(const std::string& manifest, const std::string& output)
+{
+  std::ifstream in(manifest.c_str());
+  if (!in) throw std::runtime_error("Failed to open " + manifest);
+
+  // Read the whole manifest first; the page size applies to every sheet.
+  Vector2i page_size(2048, 2048);
+  TextureFormat format = TextureFormat::RGBA8;
+  bool mipmaps = false;
+  std::vector<std::string> sheets;
+  std::vector<AnimationLine> animations;
+
+  std::string line;
+  int line_number = 0;
+  while (std::getline(in, line)) {
+    ++line_number;
+    std::istringstream words(line);
+    std::string command;
+    if (!(words >> command) || command[0] == '#') continue;
+
+    bool ok = false;
+    if (command == "page_size") {
+      ok = !!(words >> page_size[0] >> page_size[1]);
+    } else if (command == "format") {
+      std::string name;
+      if (words >> name) {
+        format = parse_format(name);
+        ok = true;
+      }
+    } else if (command == "mipmaps") {
+      std::string value;
+      if (words >> value && (value == "on" || value == "off")) {
+        mipmaps = value == "on";
+        ok = true;
+      }
+    } else if (command == "animation") {
+      AnimationLine animation;
+      std::string sheet;
+      ok = !!(words >> animation.name >> sheet
+                    >> animation.frame_size[0] >> animation.frame_size[1]
+                    >> animation.frame_count >> animation.period);
+      animation.id = int(sheets.size());
+      sheets.push_back(sheet);
+      animations.push_back(animation);
+    }
+
+    if (!ok) {
+      std::ostringstream message;
+      message << manifest << ":" << line_number << ": can't parse '" 
+              << line << "'";
+      throw std::runtime_error(message.str());
+    }
+  }
+
+  AtlasBuilder builder(page_size);
+  for (size_t i = 0; i < animations.size(); ++i) {
+    builder.add(
+      Image(Path(sheets[i])),
+      animations[i].frame_size,
+      animations[i].frame_count
+    );
+  }
+  builder.pack();
+
+  SpriteBundleWriter writer;
+  for (const Image& page : builder.pages()) {
+    writer.add_texture(page, format, mipmaps);
+  }
+  for (const AnimationLine& animation : animations) {
+    writer.add_animation(
+      animation.name,
+      builder.page(animation.id),
+      builder.min(animation.id),
+      builder.size(animation.id),
+      animation.frame_size,
+      animation.frame_count,
+      animation.period
+    );
+  }
+  writer.save(Path(output));
+
+  std::cout << manifest << " -> " << output << ": " 
+            << animations.size() << " animations on " 
+            << builder.pages().size() << " " << texture_format_name(format) 
+            << " pages" << std::endl;
+}
+
+//*****************************************************************************
+int main(int argc, char** argv)
+{
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <manifest> <output bundle>" 
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    bake(argv[1], argv[2]);
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,303 @@
+//*****************************************************************************
+// Headless benchmarks for the sprite pipeline.
+//
+// Usage:
+//
+//   benchmark <output.json> [seconds per benchmark]
+//
+// Runs without a window, through a HeadlessContext, so it works on a machine
+// with no display. On Mesa, this gets llvmpipe and a repeatable baseline:
+//
+//   export EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1
+//   export MESA_SHADER_CACHE_DISABLE=true
+//   benchmark results.json
+//
+// Run it from the repository root so that data/ can be found. The results go
+// to the given file as JSON (standard output gets the usual log chatter):
+//
+//   {
+//     "renderer": "llvmpipe (LLVM 15.0.7, 256 bits)",
+//     "gl_version": "4.5 (Core Profile) Mesa 23.0.4",
+//     "benchmarks": [
+//       { "name": "sprites_batched_1000", "value": 1234567.0,
+//         "unit": "sprites/s", "iterations": 42 },
+//       ...
+//     ]
+//   }
+//
+// Higher is better for everything apart from the "ms" results. Each
+// benchmark runs for about the given number of seconds (default 1), and at
+// least a few iterations however slow they are.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <filesystem/FileData.hpp>
+
+#include <graphics/GraphicsSystem.hpp>
+#include <graphics/Image.hpp>
+#include <graphics/ShaderProgram.hpp>
+#include <graphics/Sprite.hpp>
+#include <graphics/SpriteBatch.hpp>
+#include <graphics/Texture.hpp>
+
+#include <profiling/Profiler.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+using namespace profiling;
+using namespace Eigen;
+
+//*****************************************************************************
+struct Result {
+  std::string name;
+  double value;
+  std::string unit;
+  int iterations;
+};
+
+//*****************************************************************************
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//*****************************************************************************
+static const int MIN_ITERATIONS = 3;
+static double s_budget = 1.0;
+
+template <typename F>
+static Result measure(
+  const std::string& name,
+  const std::string& unit,
+  double work_per_iteration,
+  F iteration
+)
+// Run the iteration until the time budget is used up, and report the work
+// done per second. One iteration is run first, untimed, to warm up caches
+// and the driver.
+//*****************************************************************************
+{
+  iteration();
+
+  int iterations = 0;
+  Clock::time_point start = Clock::now();
+  double seconds = 0;
+  while (iterations < MIN_ITERATIONS || seconds < s_budget) {
+    iteration();
+    ++iterations;
+    seconds = seconds_since(start);
+  }
+
+  Result ret = { name, work_per_iteration * iterations / seconds, unit, iterations };
+  std::cerr << name << ": " << ret.value << " " << unit << std::endl;
+  return ret;
+}
+
+//*****************************************************************************
+static std::vector<Sprite> make_sprites(
+  GraphicsSystem& graphics,
+  std::shared_ptr<Animation> animation,
+  int count
+)
+{
+  // Spread over the whole view so that nothing gets culled. Use a fixed
+  // seed so that every run draws the same thing.
+  std::srand(1234);
+  Vector2f range = (graphics.window_size() - animation->size()).cast<float>();
+  std::vector<Sprite> sprites(count);
+  for (Sprite& sprite : sprites) {
+    sprite.set_animation(animation);
+    sprite.randomise_frame();
+    sprite.set_position(Vector2f(
+      range[0] * std::rand() / RAND_MAX, range[1] * std::rand() / RAND_MAX
+    ));
+    sprite.set_orientation(6.2831853f * std::rand() / RAND_MAX);
+  }
+  return sprites;
+}
+
+//*****************************************************************************
+static void draw_benchmarks(GraphicsSystem& graphics, std::vector<Result>& results)
+//
+// Sprites drawn per second, through a SpriteBatch and one at a time. Each
+// frame is finished before the next, so this is the time for the GPU to draw
+// them as well as the CPU to submit them.
+//*****************************************************************************
+{
+  auto animation = std::make_shared<Animation>(
+    graphics, Path("data/textures/test_animation.png"), Vector2i(64, 64), 16, 100
+  );
+  SpriteBatch batch(graphics);
+
+  const int counts[] = { 1000, 10000, 100000 };
+  for (int count : counts) {
+    std::vector<Sprite> sprites = make_sprites(graphics, animation, count);
+    std::string suffix = "_" + std::to_string(count);
+
+    results.push_back(measure("sprites_batched" + suffix, "sprites/s", count, [&]() {
+      glClear(GL_COLOR_BUFFER_BIT);
+      for (Sprite& sprite : sprites) sprite.draw(batch);
+      batch.draw();
+      glFinish();
+      graphics.swap_buffers();
+    }));
+
+    results.push_back(measure("sprites_immediate" + suffix, "sprites/s", count, [&]() {
+      glClear(GL_COLOR_BUFFER_BIT);
+      for (Sprite& sprite : sprites) sprite.draw();
+      glFinish();
+      graphics.swap_buffers();
+    }));
+  }
+}
+
+//*****************************************************************************
+static void update_benchmarks(GraphicsSystem& graphics, std::vector<Result>& results)
+{
+  auto animation = std::make_shared<Animation>(
+    graphics, Path("data/textures/test_animation.png"), Vector2i(64, 64), 16, 100
+  );
+  const int count = 100000;
+  std::vector<Sprite> sprites = make_sprites(graphics, animation, count);
+
+  // A 60Hz step, which moves the frame on every sixth update or so.
+  results.push_back(measure("sprite_update", "updates/s", count, [&]() {
+    for (Sprite& sprite : sprites) sprite.update(16.667f);
+  }));
+}
+
+//*****************************************************************************
+static void texture_benchmarks(GraphicsSystem& graphics, std::vector<Result>& results)
+{
+  const Path path("data/textures/lucy.png");
+  Image image(path);
+  double megabytes = image.byte_size() / (1024.0 * 1024.0);
+
+  // Decoded bytes per second, since that's what ends up on the GPU.
+  results.push_back(measure("texture_decode", "MB/s", megabytes, [&]() {
+    Image decoded(path);
+  }));
+
+  results.push_back(measure("texture_upload", "MB/s", megabytes, [&]() {
+    Texture texture(graphics, TextureTarget::TEXTURE_2D, image);
+    glFinish();
+  }));
+}
+
+//*****************************************************************************
+static void shader_benchmarks(GraphicsSystem& graphics, std::vector<Result>& results)
+//
+// Times building the sprite shader by hand, bypassing the program cache.
+// Drivers have their own caches too - turn Mesa's off with
+// MESA_SHADER_CACHE_DISABLE=true, or this measures how fast it can hash.
+//*****************************************************************************
+{
+  // Read the sources up front so that only the driver's work is timed.
+  const std::string vertex_source =
+    FileData(Path("data/shaders/animation.glsl.v")).string();
+  const std::string fragment_source =
+    FileData(Path("data/shaders/animation.glsl.f")).string();
+  const char* attributes[] = {
+    "position", "origin", "orientation", "frame",
+    "frame_size", "frame_uvs", "columns", "timing"
+  };
+
+  double compile_seconds = 0;
+  double link_seconds = 0;
+  int iterations = 0;
+  Clock::time_point start = Clock::now();
+  while (iterations < MIN_ITERATIONS || seconds_since(start) < s_budget) {
+    Clock::time_point compile_start = Clock::now();
+    VertexShader vertex_shader(graphics, vertex_source);
+    FragmentShader fragment_shader(graphics, fragment_source);
+    compile_seconds += seconds_since(compile_start);
+
+    Clock::time_point link_start = Clock::now();
+    ShaderProgram program(graphics);
+    program.attach(vertex_shader);
+    program.attach(fragment_shader);
+    for (int i = 0; i < 8; ++i) program.bind_attribute(AttributeIndex(i), attributes[i]);
+    if (!program.link()) {
+      throw std::runtime_error("Failed to link: " + program.info_log());
+    }
+    link_seconds += seconds_since(link_start);
+    ++iterations;
+  }
+
+  Result compile = { "shader_compile", compile_seconds * 1000 / iterations, "ms", iterations };
+  Result link = { "shader_link", link_seconds * 1000 / iterations, "ms", iterations };
+  std::cerr << compile.name << ": " << compile.value << " ms" << std::endl;
+  std::cerr << link.name << ": " << link.value << " ms" << std::endl;
+  results.push_back(compile);
+  results.push_back(link);
+}
+
+//*****************************************************************************
+static void write_json(
+  std::ostream& out,
+  GraphicsSystem& graphics,
+  const std::vector<Result>& results
+)
+{
+  out << "{\n";
+  out << "  \"renderer\": ";
+  write_json_string(out, graphics.renderer());
+  out << ",\n  \"gl_version\": ";
+  write_json_string(out, graphics.gl_version());
+  out << ",\n";
+  out << "  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    char value[32];
+    std::snprintf(value, sizeof(value), "%.6g", r.value);
+    out << "    { \"name\": ";
+    write_json_string(out, r.name);
+    out << ", \"value\": " << value << ", \"unit\": ";
+    write_json_string(out, r.unit);
+    out << ", \"iterations\": " << r.iterations << " }"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n";
+  out << "}\n";
+}
+
+//*****************************************************************************
+int main(int argc, char** argv)
+{
+  if (argc != 2 && argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <output.json> [seconds]"
+              << std::endl;
+    return 1;
+  }
+  if (argc == 3) s_budget = std::atof(argv[2]);
+
+  try {
+    GraphicsSystem graphics(Vector2i(1280, 720));
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    std::vector<Result> results;
+    draw_benchmarks(graphics, results);
+    update_benchmarks(graphics, results);
+    texture_benchmarks(graphics, results);
+    shader_benchmarks(graphics, results);
+
+    std::ofstream out(argv[1]);
+    if (!out) throw std::runtime_error(std::string("Failed to open ") + argv[1]);
+    write_json(out, graphics, results);
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+//*****************************************************************************
+// Bake-time texture compressor.
+//
+// Usage:
+//
+//   compress_texture <input image> <output.dds> [bc1|bc3]
+//
+// Decodes any image stb_image can read and writes it as a BC1 or BC3 DDS
+// file that Texture loads straight onto the GPU. BC3 (the default) keeps
+// smooth alpha; BC1 is half the size but alpha is all or nothing.
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <graphics/CompressedImage.hpp>
+#include <graphics/Image.hpp>
+
+using namespace graphics;
+using namespace filesystem;
+
+//*****************************************************************************
+int main(int argc, char** argv)
+{
+  if (argc < 3 || argc > 4) {
+    std::cerr << "Usage: " << argv[0] 
+              << " <input image> <output.dds> [bc1|bc3]" << std::endl;
+    return 1;
+  }
+
+  TextureFormat format = TextureFormat::BC3;
+  if (argc == 4) {
+    if (std::strcmp(argv[3], "bc1") == 0) {
+      format = TextureFormat::BC1;
+    } else if (std::strcmp(argv[3], "bc3") != 0) {
+      std::cerr << "Unknown format " << argv[3] << std::endl;
+      return 1;
+    }
+  }
+
+  try {
+    Image image{Path(argv[1])};
+    CompressedImage compressed = CompressedImage::encode(image, format);
+    compressed.save_dds(Path(argv[2]));
+
+    std::cout << argv[1] << " -> " << argv[2] << ": "
+              << image.byte_size() << " bytes RGBA8, "
+              << compressed.level(0).size() << " bytes "
+              << texture_format_name(format) << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
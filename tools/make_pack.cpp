@@ -0,0 +1,45 @@
+//*****************************************************************************
+// Bake-time pack builder.
+//
+// Usage:
+//
+//   find data -type f | make_pack <output.pack>
+//
+// Reads file names from standard input, one per line, and packs the files
+// under those names. Mount the pack on GraphicsSystem::file_system() and the
+// same paths load out of it instead of off disk.
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <filesystem/PackFile.hpp>
+
+using namespace filesystem;
+
+//*****************************************************************************
+int main(int argc, char** argv)
+{
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <output.pack> < file list" 
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    PackWriter writer;
+    int count = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      if (line.empty()) continue;
+      writer.add_file(Path(line));
+      ++count;
+    }
+    writer.save(Path(argv[1]));
+    std::cout << count << " files -> " << argv[1] << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}